@@ -0,0 +1,48 @@
+// @file allocstats.cpp
+// @brief Global operator new/delete that count every allocation.
+
+#include "allocstats.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+using namespace std;
+
+static atomic<uint64_t> allocationCount(0);
+
+
+uint64_t HeapAllocationCount() {
+    return allocationCount.load(memory_order_relaxed);
+}
+
+
+void *operator new(size_t size) {
+    allocationCount.fetch_add(1, memory_order_relaxed);
+    void *memory = malloc(size == 0 ? 1 : size);
+    if (memory == nullptr) throw bad_alloc();
+    return memory;
+}
+
+
+void *operator new[](size_t size) {
+    return operator new(size);
+}
+
+
+void *operator new(size_t size, const nothrow_t &) noexcept {
+    allocationCount.fetch_add(1, memory_order_relaxed);
+    return malloc(size == 0 ? 1 : size);
+}
+
+
+void *operator new[](size_t size, const nothrow_t &tag) noexcept {
+    return operator new(size, tag);
+}
+
+
+void operator delete(void *memory) noexcept { free(memory); }
+void operator delete[](void *memory) noexcept { free(memory); }
+void operator delete(void *memory, size_t) noexcept { free(memory); }
+void operator delete[](void *memory, size_t) noexcept { free(memory); }
+void operator delete(void *memory, const nothrow_t &) noexcept { free(memory); }
+void operator delete[](void *memory, const nothrow_t &) noexcept { free(memory); }
@@ -0,0 +1,14 @@
+// @file allocstats.h
+// @brief Counts heap allocations made through operator new, so frames can be checked for allocations.
+//
+// allocstats.cpp replaces the global operator new and delete. Memory that raylib allocates with malloc
+// itself is not counted.
+
+#ifndef ALLOCSTATS_H
+#define ALLOCSTATS_H
+
+#include <cstdint>
+
+uint64_t HeapAllocationCount(); // Number of operator new calls since the program started.
+
+#endif
@@ -0,0 +1,206 @@
+// @file animation.cpp
+// @brief Piece slide and capture fade animations on a fixed timestep.
+
+#include "animation.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+using namespace std;
+
+
+void ResetAnimations(AnimationSystem &system) {
+    system.count = 0;
+    system.accumulator = 0.0;
+    system.steps = 0;
+}
+
+
+static int SpriteOnSquare(const Bitboards &pos, int square) {
+    uint32_t bit = SquareBit(square);
+    bool isKing = (pos.kings & bit) != 0;
+    if (pos.pieces[0] & bit) return isKing ? SPRITE_PLAYER1_KING : SPRITE_PLAYER1_MAN;
+    return isKing ? SPRITE_PLAYER2_KING : SPRITE_PLAYER2_MAN;
+}
+
+
+// Diagonal distance in squares between two squares on the same diagonal.
+static int SquareDistance(int from, int to) {
+    return max(1, abs(SquareX(to) - SquareX(from)));
+}
+
+
+static float LegSeconds(int from, int to) {
+    return SquareDistance(from, to) * SLIDE_SECONDS_PER_SQUARE;
+}
+
+
+// Takes a free slot, finishing the oldest animation early if every slot is in use.
+static PieceAnimation &AddAnimation(AnimationSystem &system) {
+    if (system.count == MAX_ANIMATIONS) {
+        memmove(&system.animations[0], &system.animations[1], sizeof(PieceAnimation) * (MAX_ANIMATIONS - 1));
+        system.count--;
+    }
+    PieceAnimation &animation = system.animations[system.count++];
+    animation.elapsed = 0.0;
+    animation.delay = 0.0f;
+    return animation;
+}
+
+
+// A piece that starts sliding from a square another slide is still heading for takes over from that slide,
+// so the same piece is never drawn twice.
+static void FinishSlidesEndingAt(AnimationSystem &system, int square) {
+    int kept = 0;
+    for (int i = 0; i < system.count; i++) {
+        const PieceAnimation &animation = system.animations[i];
+        bool endsHere = animation.kind == ANIMATION_SLIDE && animation.points[animation.pointCount - 1] == square;
+        if (!endsHere) {
+            system.animations[kept++] = animation;
+        }
+    }
+    system.count = kept;
+}
+
+
+void StartMoveAnimation(AnimationSystem &system, const Bitboards &before, const Move &move) {
+    FinishSlidesEndingAt(system, move.from);
+
+    PieceAnimation &slide = AddAnimation(system);
+    slide.kind = ANIMATION_SLIDE;
+    slide.sprite = (uint8_t)SpriteOnSquare(before, move.from);
+    slide.points[0] = move.from;
+    slide.pointCount = (uint8_t)(move.length + 1);
+    slide.duration = 0.0f;
+    for (int i = 0; i < move.length; i++) {
+        slide.points[i + 1] = move.path[i];
+        slide.duration += LegSeconds(slide.points[i], slide.points[i + 1]);
+    }
+
+    // Each captured piece fades once the mover has passed over it
+    float legStart = 0.0f;
+    for (int leg = 0; leg < move.length; leg++) {
+        int from = slide.points[leg];
+        int to = slide.points[leg + 1];
+        float legEnd = legStart + LegSeconds(from, to);
+        int stepX = (SquareX(to) > SquareX(from)) ? 1 : -1;
+        int stepY = (SquareY(to) > SquareY(from)) ? 1 : -1;
+        for (int x = SquareX(from) + stepX, y = SquareY(from) + stepY; x != SquareX(to); x += stepX, y += stepY) {
+            int square = SquareIndex(x, y);
+            if (move.captured & SquareBit(square)) {
+                PieceAnimation &fade = AddAnimation(system);
+                fade.kind = ANIMATION_FADE;
+                fade.sprite = (uint8_t)SpriteOnSquare(before, square);
+                fade.points[0] = (uint8_t)square;
+                fade.pointCount = 1;
+                fade.delay = legStart + (legEnd - legStart) * SquareDistance(from, square) / SquareDistance(from, to);
+                fade.duration = FADE_SECONDS;
+            }
+        }
+        legStart = legEnd;
+    }
+}
+
+
+void AnimateTransition(AnimationSystem &system, const Bitboards &before, const Bitboards &after, const Move *lastTurn) {
+    // A whole turn (a redo, or a move played by the computer) slides along its full path
+    if (lastTurn != nullptr) {
+        Bitboards played = before;
+        MakeMove(played, *lastTurn);
+        if (memcmp(&played, &after, sizeof(Bitboards)) == 0) {
+            StartMoveAnimation(system, before, *lastTurn);
+            return;
+        }
+    }
+
+    // One step of a turn played by clicking: a single piece moved, and maybe took pieces of the other side
+    for (int side = 0; side < 2; side++) {
+        uint32_t left = before.pieces[side] & ~after.pieces[side];
+        uint32_t arrived = after.pieces[side] & ~before.pieces[side];
+        uint32_t captured = before.pieces[side ^ 1] & ~after.pieces[side ^ 1];
+        if (PopCount(left) != 1 || PopCount(arrived) != 1) continue;
+        if ((after.pieces[side ^ 1] & ~before.pieces[side ^ 1]) != 0) continue;
+
+        Move step;
+        memset(&step, 0, sizeof(step));
+        step.from = (uint8_t)__builtin_ctz(left);
+        step.to = (uint8_t)__builtin_ctz(arrived);
+        step.path[0] = step.to;
+        step.length = 1;
+        step.captured = captured;
+        step.capturedKings = captured & before.kings;
+        StartMoveAnimation(system, before, step);
+        return;
+    }
+
+    // Anything else, such as several turns arriving at once, shows at once. Undo, load and restart never get
+    // here: main() shows those at once even when they look like a single step back.
+}
+
+
+void UpdateAnimations(AnimationSystem &system, double frameSeconds) {
+    system.accumulator += min(max(frameSeconds, 0.0), MAX_ANIMATION_FRAME);
+    while (system.accumulator >= ANIMATION_STEP) {
+        system.accumulator -= ANIMATION_STEP;
+        system.steps++;
+
+        int kept = 0;
+        for (int i = 0; i < system.count; i++) {
+            PieceAnimation &animation = system.animations[i];
+            animation.elapsed += ANIMATION_STEP;
+            if (animation.elapsed < animation.delay + animation.duration) {
+                system.animations[kept++] = animation;
+            }
+        }
+        system.count = kept;
+    }
+}
+
+
+bool AnimationsActive(const AnimationSystem &system) {
+    return system.count > 0;
+}
+
+
+uint32_t AnimatedSquares(const AnimationSystem &system) {
+    uint32_t squares = 0;
+    for (int i = 0; i < system.count; i++) {
+        const PieceAnimation &animation = system.animations[i];
+        if (animation.kind == ANIMATION_SLIDE) {
+            squares |= SquareBit(animation.points[animation.pointCount - 1]);
+        }
+    }
+    return squares;
+}
+
+
+// Draws between fixed steps: the time not simulated yet is added, so motion stays smooth at any frame rate.
+void DrawAnimations(const RenderBackend &backend, const AnimationSystem &system) {
+    for (int i = 0; i < system.count; i++) {
+        const PieceAnimation &animation = system.animations[i];
+        float time = (float)(animation.elapsed + system.accumulator) - animation.delay;
+
+        if (animation.kind == ANIMATION_FADE) {
+            float fraction = min(1.0f, max(0.0f, time / animation.duration));
+            int x = SquareX(animation.points[0]) * CELL_SIZE;
+            int y = SquareY(animation.points[0]) * CELL_SIZE;
+            backend.drawSprite(backend.context, animation.sprite, x, y, (uint8_t)(255.0f * (1.0f - fraction) + 0.5f));
+            continue;
+        }
+
+        // Find the leg the piece is on, then how far along it
+        int leg = 0;
+        float legSeconds = LegSeconds(animation.points[0], animation.points[1]);
+        while (time > legSeconds && leg + 2 < animation.pointCount) {
+            time -= legSeconds;
+            leg++;
+            legSeconds = LegSeconds(animation.points[leg], animation.points[leg + 1]);
+        }
+        float fraction = min(1.0f, max(0.0f, time / legSeconds));
+        int from = animation.points[leg];
+        int to = animation.points[leg + 1];
+        float x = SquareX(from) + (SquareX(to) - SquareX(from)) * fraction;
+        float y = SquareY(from) + (SquareY(to) - SquareY(from)) * fraction;
+        backend.drawSprite(backend.context, animation.sprite, (int)(x * CELL_SIZE + 0.5f), (int)(y * CELL_SIZE + 0.5f), 255);
+    }
+}
@@ -0,0 +1,47 @@
+// @file animation.h
+// @brief Piece slide and capture fade animations on a fixed timestep. Everything lives in fixed arrays, so
+// starting, updating and drawing animations never allocates.
+//
+// Animations only change what is drawn: the game state has already moved on when one starts, so input and
+// any search keep running while pieces are still sliding.
+
+#ifndef ANIMATION_H
+#define ANIMATION_H
+
+#include "rules.h"
+#include "render.h"
+
+const int MAX_ANIMATIONS = 64;                  // Animations running at once; when full, the oldest finishes early
+const double ANIMATION_STEP = 1.0 / 120.0;      // Fixed simulation step in seconds, independent of the frame rate
+const double MAX_ANIMATION_FRAME = 0.25;        // Longest frame time simulated in one update (after a stall or idle wait)
+const float SLIDE_SECONDS_PER_SQUARE = 0.07f;   // Time a sliding piece takes to cross one square diagonally
+const float FADE_SECONDS = 0.25f;               // Time a captured piece takes to fade out
+
+enum AnimationKind { ANIMATION_SLIDE, ANIMATION_FADE };
+
+struct PieceAnimation {
+    uint8_t kind;                       // AnimationKind
+    uint8_t sprite;                     // PieceSprite drawn
+    uint8_t pointCount;                 // Squares in points: the start square, then every landing square (1 for a fade)
+    uint8_t points[MAX_CAPTURES + 1];
+    float delay;                        // Seconds before it starts (a captured piece fades once it has been jumped)
+    float duration;                     // Seconds it runs after the delay
+    double elapsed;                     // Simulated seconds since it was added
+};
+
+struct AnimationSystem {
+    PieceAnimation animations[MAX_ANIMATIONS];
+    int count;
+    double accumulator;     // Frame time not simulated yet, always less than ANIMATION_STEP after an update
+    uint64_t steps;         // Fixed steps simulated so far
+};
+
+void ResetAnimations(AnimationSystem &system);
+void StartMoveAnimation(AnimationSystem &system, const Bitboards &before, const Move &move); // Slides the mover along the move's path and fades what it captures.
+void AnimateTransition(AnimationSystem &system, const Bitboards &before, const Bitboards &after, const Move *lastTurn); // Animates whatever single move or capture step leads from `before` to `after`; anything else shows at once. Undo is not told apart from a move; the caller skips this for it.
+void UpdateAnimations(AnimationSystem &system, double frameSeconds); // Advances in fixed steps and drops finished animations.
+bool AnimationsActive(const AnimationSystem &system);
+uint32_t AnimatedSquares(const AnimationSystem &system); // Squares where sliding pieces will land; the cached scene leaves those pieces out.
+void DrawAnimations(const RenderBackend &backend, const AnimationSystem &system);
+
+#endif
@@ -0,0 +1,80 @@
+// @file engine.cpp
+// @brief Negamax alpha-beta search over the headless rules.
+
+#include "engine.h"
+#include "trace.h"
+
+static int EvaluateWith(const Bitboards &pos, bool useAdvancement) {
+    int score[2];
+    for (int side = 0; side < 2; side++) {
+        uint32_t men = pos.pieces[side] & ~pos.kings;
+        uint32_t kings = pos.pieces[side] & pos.kings;
+        score[side] = PopCount(men) * MAN_VALUE + PopCount(kings) * KING_VALUE;
+
+        if (useAdvancement) {
+            for (uint32_t remaining = men; remaining != 0; remaining &= remaining - 1) {
+                int y = SquareY(__builtin_ctz(remaining));
+                score[side] += 2 * ((side == 0) ? y : 7 - y); // Rows travelled towards promotion
+            }
+        }
+    }
+
+    int side = (int)pos.sideToMove;
+    return score[side] - score[side ^ 1];
+}
+
+
+int Evaluate(const Bitboards &pos) {
+    return EvaluateWith(pos, true);
+}
+
+
+static int Search(Bitboards &pos, const EngineConfig &config, int depth, int ply, int alpha, int beta) {
+    MoveList list;
+    GenerateMoves(pos, list);
+    if (list.count == 0) {
+        return -SCORE_WIN + ply;  // No moves left: the side to move has lost
+    }
+    if (depth == 0) {
+        return EvaluateWith(pos, config.useAdvancement);
+    }
+
+    for (int i = 0; i < list.count; i++) {
+        MakeMove(pos, list.moves[i]);
+        int score = -Search(pos, config, depth - 1, ply + 1, -beta, -alpha);
+        UnmakeMove(pos, list.moves[i]);
+
+        if (score > alpha) {
+            alpha = score;
+            if (alpha >= beta) break;
+        }
+    }
+    return alpha;
+}
+
+
+bool FindBestMove(const Bitboards &pos, const EngineConfig &config, Move &bestMove) {
+    TRACE_SCOPE("FindBestMove");
+    MoveList list;
+    GenerateMoves(pos, list);
+    if (list.count == 0) {
+        return false;
+    }
+
+    Bitboards work = pos;
+    int alpha = -SCORE_WIN - 1;
+    bestMove = list.moves[0];
+
+    for (int i = 0; i < list.count; i++) {
+        TRACE_SCOPE("Search root move");
+        MakeMove(work, list.moves[i]);
+        int score = -Search(work, config, config.depth > 0 ? config.depth - 1 : 0, 1, -SCORE_WIN - 1, -alpha);
+        UnmakeMove(work, list.moves[i]);
+
+        if (score > alpha) {
+            alpha = score;
+            bestMove = list.moves[i];
+        }
+    }
+    return true;
+}
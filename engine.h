@@ -0,0 +1,22 @@
+// @file engine.h
+// @brief Small alpha-beta search used for computer players and self-play matches.
+
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include "rules.h"
+
+const int SCORE_WIN = 100000;           // Score of a won position (adjusted by distance so faster wins score higher)
+const int MAN_VALUE = 100;              // Material value of a regular piece
+const int KING_VALUE = 250;             // Material value of a king
+
+// Settings that describe one computer player.
+struct EngineConfig {
+    int depth;              // Search depth in plies (full turns)
+    bool useAdvancement;    // Reward regular pieces for moving towards promotion
+};
+
+int Evaluate(const Bitboards &pos); // Static evaluation from the point of view of the side to move.
+bool FindBestMove(const Bitboards &pos, const EngineConfig &config, Move &bestMove); // Returns false if the side to move has no moves.
+
+#endif
@@ -0,0 +1,419 @@
+// @file gamedb.cpp
+// @brief Memory-mapped game database with a Zobrist-keyed position index.
+
+#include "gamedb.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <queue>
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+using namespace std;
+
+static_assert(sizeof(DbHeader) == 64, "DbHeader must match the file layout");
+static_assert(sizeof(DbGameEntry) == 16, "DbGameEntry must match the file layout");
+static_assert(sizeof(DbIndexEntry) == 16, "DbIndexEntry must match the file layout");
+
+const char DB_MAGIC[4] = { 'E', 'C', 'D', 'B' };
+const size_t DB_MERGE_BUFFER = 64 * 1024; // Index entries buffered per run while merging
+
+// The file stores integers little-endian and is mapped without conversion.
+static bool IsLittleEndianHost() {
+    const uint16_t probe = 1;
+    return *reinterpret_cast<const uint8_t*>(&probe) == 1;
+}
+
+
+static bool SeekFile(FILE *file, uint64_t offset) {
+#ifdef _WIN32
+    return _fseeki64(file, (long long)offset, SEEK_SET) == 0;
+#else
+    return fseeko(file, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+
+static bool IndexEntryLess(const DbIndexEntry &a, const DbIndexEntry &b) {
+    if (a.key != b.key) return a.key < b.key;
+    if (a.game != b.game) return a.game < b.game;
+    return a.ply < b.ply;
+}
+
+
+// ---------------------------------------------------------------------------------------------
+// Reading
+// ---------------------------------------------------------------------------------------------
+
+// True if every bucket is a range of the index and every game lies between the header and the game table,
+// so queries never read outside the file. Runs once when the file is opened.
+static bool ValidTables(const GameDatabase &db) {
+    if (db.buckets[0] != 0 || db.buckets[DB_BUCKET_COUNT] != db.header->indexCount) return false;
+    for (int bucket = 0; bucket < DB_BUCKET_COUNT; bucket++) {
+        if (db.buckets[bucket] > db.buckets[bucket + 1]) return false;
+    }
+    for (uint64_t game = 0; game < db.header->gameCount; game++) {
+        const DbGameEntry &entry = db.games[game];
+        if (entry.offset < sizeof(DbHeader) || entry.offset > db.header->gameTableOffset ||
+            entry.length > db.header->gameTableOffset - entry.offset) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+bool OpenGameDatabase(GameDatabase &db, const string &path, string &error) {
+    memset(&db, 0, sizeof(db));
+    if (!IsLittleEndianHost()) {
+        error = "databases can only be read on little-endian machines";
+        return false;
+    }
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        error = "could not open " + path;
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(file, &fileSize);
+    HANDLE mapping = (fileSize.QuadPart > 0) ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+    CloseHandle(file);
+    if (mapping == nullptr) {
+        error = "could not map " + path;
+        return false;
+    }
+    db.data = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    db.mapping = mapping;
+    db.size = (size_t)fileSize.QuadPart;
+    if (db.data == nullptr) {
+        CloseHandle(mapping);
+        error = "could not map " + path;
+        return false;
+    }
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error = "could not open " + path;
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        close(fd);
+        error = "could not read " + path;
+        return false;
+    }
+    void *address = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (address == MAP_FAILED) {
+        error = "could not map " + path;
+        return false;
+    }
+    madvise(address, (size_t)info.st_size, MADV_RANDOM);
+    db.data = static_cast<const uint8_t*>(address);
+    db.size = (size_t)info.st_size;
+#endif
+
+    // Check that every section lies inside the file before handing out pointers into it
+    const DbHeader *header = reinterpret_cast<const DbHeader*>(db.data);
+    bool valid = db.size >= sizeof(DbHeader) && memcmp(header->magic, DB_MAGIC, 4) == 0;
+    if (valid && header->version > DB_VERSION) {
+        error = path + " was written by a newer version";
+        CloseGameDatabase(db);
+        return false;
+    }
+    valid = valid &&
+            header->gameTableOffset % 8 == 0 && header->bucketOffset % 8 == 0 && header->indexOffset % 8 == 0 &&
+            header->gameTableOffset >= sizeof(DbHeader) && header->gameTableOffset <= db.size && header->bucketOffset <= db.size && header->indexOffset <= db.size &&
+            header->gameCount <= (db.size - header->gameTableOffset) / sizeof(DbGameEntry) &&
+            header->gameTableOffset + header->gameCount * sizeof(DbGameEntry) <= header->bucketOffset &&
+            header->bucketOffset + (DB_BUCKET_COUNT + 1) * sizeof(uint64_t) <= header->indexOffset &&
+            header->indexCount == (db.size - header->indexOffset) / sizeof(DbIndexEntry);
+    if (!valid) {
+        error = path + " is not a valid game database";
+        CloseGameDatabase(db);
+        return false;
+    }
+
+    db.header = header;
+    db.games = reinterpret_cast<const DbGameEntry*>(db.data + header->gameTableOffset);
+    db.buckets = reinterpret_cast<const uint64_t*>(db.data + header->bucketOffset);
+    db.index = reinterpret_cast<const DbIndexEntry*>(db.data + header->indexOffset);
+    if (!ValidTables(db)) {
+        error = path + " has a damaged index or game table";
+        CloseGameDatabase(db);
+        return false;
+    }
+    return true;
+}
+
+
+void CloseGameDatabase(GameDatabase &db) {
+    if (db.data != nullptr) {
+#ifdef _WIN32
+        UnmapViewOfFile(db.data);
+        CloseHandle((HANDLE)db.mapping);
+#else
+        munmap(const_cast<uint8_t*>(db.data), db.size);
+#endif
+    }
+    memset(&db, 0, sizeof(db));
+}
+
+
+size_t FindPosition(const GameDatabase &db, uint64_t key, const DbIndexEntry *&first) {
+    size_t bucket = (size_t)(key >> (64 - DB_BUCKET_BITS));
+    const DbIndexEntry *begin = db.index + db.buckets[bucket];
+    const DbIndexEntry *end = db.index + db.buckets[bucket + 1];
+
+    first = lower_bound(begin, end, key, [](const DbIndexEntry &entry, uint64_t value) { return entry.key < value; });
+    const DbIndexEntry *last = upper_bound(first, end, key, [](uint64_t value, const DbIndexEntry &entry) { return value < entry.key; });
+    return (size_t)(last - first);
+}
+
+
+bool ReadDatabaseGame(const GameDatabase &db, uint32_t game, GameRecord &record, Bitboards &finalPos) {
+    if (game >= db.header->gameCount) return false;
+    const DbGameEntry &entry = db.games[game];
+    if (entry.offset > db.header->gameTableOffset || entry.length > db.header->gameTableOffset - entry.offset) return false;
+
+    const uint8_t *data = db.data + entry.offset;
+    size_t length = entry.length;
+    if (entry.flags & SAVE_FLAG_CUSTOM_START) {
+        if (length < 13) return false;
+        memcpy(&record.start, data, 12);
+        record.start.sideToMove = data[12];
+        data += 13;
+        length -= 13;
+        if (!IsValidPosition(record.start)) return false;
+    } else {
+        InitialBitboards(record.start);
+    }
+    return DecodeMoves(data, length, entry.turns, record.start, record.moves, finalPos) == SAVE_OK;
+}
+
+
+// ---------------------------------------------------------------------------------------------
+// Building
+// ---------------------------------------------------------------------------------------------
+
+static bool WriteBytes(GameDatabaseWriter &writer, const void *data, size_t size, string &error) {
+    if (size > 0 && fwrite(data, 1, size, writer.file) != size) {
+        error = "could not write " + writer.path;
+        return false;
+    }
+    writer.offset += size;
+    return true;
+}
+
+
+static bool PadTo8(GameDatabaseWriter &writer, string &error) {
+    static const uint8_t zeros[8] = { 0 };
+    return WriteBytes(writer, zeros, (size_t)((8 - writer.offset % 8) % 8), error);
+}
+
+
+// Sorts the in-memory index entries and writes them to a temporary run file.
+static bool SpillRun(GameDatabaseWriter &writer, string &error) {
+    if (writer.run.empty()) return true;
+    sort(writer.run.begin(), writer.run.end(), IndexEntryLess);
+
+    string runPath = writer.path + ".run" + to_string(writer.runFiles.size());
+    FILE *runFile = fopen(runPath.c_str(), "wb");
+    if (runFile == nullptr) {
+        error = "could not create " + runPath;
+        return false;
+    }
+    size_t written = fwrite(writer.run.data(), sizeof(DbIndexEntry), writer.run.size(), runFile);
+    bool ok = fclose(runFile) == 0 && written == writer.run.size();
+    writer.runFiles.push_back(runPath);
+    writer.run.clear();
+    if (!ok) error = "could not write " + runPath;
+    return ok;
+}
+
+
+bool BeginGameDatabase(GameDatabaseWriter &writer, const string &path, size_t runEntries, string &error) {
+    if (!IsLittleEndianHost()) {
+        error = "databases can only be written on little-endian machines";
+        return false;
+    }
+
+    writer.path = path;
+    writer.file = fopen(path.c_str(), "wb");
+    writer.offset = 0;
+    writer.games.clear();
+    writer.run.clear();
+    writer.runCapacity = (runEntries > 0) ? runEntries : DB_DEFAULT_RUN_ENTRIES;
+    writer.run.reserve(writer.runCapacity);
+    writer.runFiles.clear();
+    if (writer.file == nullptr) {
+        error = "could not create " + path;
+        return false;
+    }
+
+    DbHeader placeholder;
+    memset(&placeholder, 0, sizeof(placeholder)); // Rewritten by FinishGameDatabase
+    return WriteBytes(writer, &placeholder, sizeof(placeholder), error);
+}
+
+
+bool AddDatabaseGame(GameDatabaseWriter &writer, const GameRecord &record, PdnResult result, string &error) {
+    if (record.moves.size() > 0xFFFF || writer.games.size() >= 0xFFFFFFFFu) {
+        error = "game too long for the database";
+        return false;
+    }
+
+    Bitboards initial;
+    InitialBitboards(initial);
+    bool customStart = memcmp(&record.start, &initial, sizeof(Bitboards)) != 0;
+
+    vector<uint8_t> bytes;
+    if (customStart) {
+        const uint8_t *start = reinterpret_cast<const uint8_t*>(&record.start);
+        bytes.insert(bytes.end(), start, start + 12);
+        bytes.push_back((uint8_t)record.start.sideToMove);
+    }
+    EncodeMoves(record.moves, bytes);
+
+    DbGameEntry entry;
+    entry.offset = writer.offset;
+    entry.length = (uint32_t)bytes.size();
+    entry.turns = (uint16_t)record.moves.size();
+    entry.flags = customStart ? SAVE_FLAG_CUSTOM_START : 0;
+    entry.result = (uint8_t)result;
+    if (!WriteBytes(writer, bytes.data(), bytes.size(), error)) return false;
+
+    // One index entry per position reached, including the start
+    uint32_t game = (uint32_t)writer.games.size();
+    writer.games.push_back(entry);
+
+    Bitboards pos = record.start;
+    uint64_t key = ZobristHash(pos);
+    for (size_t ply = 0; ply <= record.moves.size(); ply++) {
+        DbIndexEntry indexEntry;
+        indexEntry.key = key;
+        indexEntry.game = game;
+        indexEntry.ply = (uint16_t)ply;
+        indexEntry.reserved = 0;
+        writer.run.push_back(indexEntry);
+        if (writer.run.size() >= writer.runCapacity && !SpillRun(writer, error)) return false;
+
+        if (ply < record.moves.size()) {
+            key = ZobristAfterMove(key, pos, record.moves[ply]);
+            MakeMove(pos, record.moves[ply]);
+        }
+    }
+    return true;
+}
+
+
+// Buffered reader over one sorted run file.
+struct RunReader {
+    FILE *file;
+    vector<DbIndexEntry> buffer;
+    size_t pos;
+    size_t length;
+};
+
+
+static bool RefillRun(RunReader &reader) {
+    reader.length = fread(reader.buffer.data(), sizeof(DbIndexEntry), reader.buffer.size(), reader.file);
+    reader.pos = 0;
+    return reader.length > 0;
+}
+
+
+bool FinishGameDatabase(GameDatabaseWriter &writer, string &error) {
+    bool ok = SpillRun(writer, error) && PadTo8(writer, error);
+    vector<DbIndexEntry>().swap(writer.run); // Release the run buffer before merging
+
+    DbHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, DB_MAGIC, 4);
+    header.version = DB_VERSION;
+    header.gameCount = writer.games.size();
+    header.gameTableOffset = writer.offset;
+    ok = ok && WriteBytes(writer, writer.games.data(), writer.games.size() * sizeof(DbGameEntry), error);
+
+    // Bucket offsets are only known after the merge; reserve their space now
+    vector<uint64_t> buckets(DB_BUCKET_COUNT + 1, 0);
+    header.bucketOffset = writer.offset;
+    ok = ok && WriteBytes(writer, buckets.data(), buckets.size() * sizeof(uint64_t), error);
+    header.indexOffset = writer.offset;
+
+    // k-way merge of the sorted runs, keeping only the first ply at which each game reached a position
+    vector<RunReader> readers(writer.runFiles.size());
+    typedef pair<DbIndexEntry, size_t> Head;
+    auto greater = [](const Head &a, const Head &b) { return IndexEntryLess(b.first, a.first); };
+    priority_queue<Head, vector<Head>, decltype(greater)> heads(greater);
+
+    for (size_t i = 0; ok && i < readers.size(); i++) {
+        readers[i].file = fopen(writer.runFiles[i].c_str(), "rb");
+        readers[i].buffer.resize(DB_MERGE_BUFFER);
+        if (readers[i].file == nullptr) {
+            error = "could not reopen " + writer.runFiles[i];
+            ok = false;
+        } else if (RefillRun(readers[i])) {
+            heads.push(Head(readers[i].buffer[readers[i].pos++], i));
+        }
+    }
+
+    vector<DbIndexEntry> output;
+    output.reserve(DB_MERGE_BUFFER);
+    uint64_t count = 0;
+    size_t nextBucket = 0;
+    bool havePrevious = false;
+    DbIndexEntry previous;
+
+    while (ok && !heads.empty()) {
+        Head head = heads.top();
+        heads.pop();
+        RunReader &reader = readers[head.second];
+        if (reader.pos < reader.length || RefillRun(reader)) {
+            heads.push(Head(reader.buffer[reader.pos++], head.second));
+        }
+
+        const DbIndexEntry &entry = head.first;
+        if (havePrevious && previous.key == entry.key && previous.game == entry.game) continue;
+        previous = entry;
+        havePrevious = true;
+
+        size_t bucket = (size_t)(entry.key >> (64 - DB_BUCKET_BITS));
+        while (nextBucket <= bucket) buckets[nextBucket++] = count;
+        output.push_back(entry);
+        count++;
+        if (output.size() == DB_MERGE_BUFFER) {
+            ok = WriteBytes(writer, output.data(), output.size() * sizeof(DbIndexEntry), error);
+            output.clear();
+        }
+    }
+    ok = ok && WriteBytes(writer, output.data(), output.size() * sizeof(DbIndexEntry), error);
+    while (nextBucket <= (size_t)DB_BUCKET_COUNT) buckets[nextBucket++] = count;
+    header.indexCount = count;
+
+    for (size_t i = 0; i < readers.size(); i++) {
+        if (readers[i].file != nullptr) fclose(readers[i].file);
+        remove(writer.runFiles[i].c_str());
+    }
+    writer.runFiles.clear();
+
+    // Fill in the bucket offsets and the header
+    ok = ok && SeekFile(writer.file, header.bucketOffset) &&
+         fwrite(buckets.data(), sizeof(uint64_t), buckets.size(), writer.file) == buckets.size() &&
+         SeekFile(writer.file, 0) &&
+         fwrite(&header, sizeof(header), 1, writer.file) == 1;
+    if (fclose(writer.file) != 0) ok = false;
+    writer.file = nullptr;
+    if (!ok && error.empty()) error = "could not write " + writer.path;
+    return ok;
+}
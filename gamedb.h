@@ -0,0 +1,86 @@
+// @file gamedb.h
+// @brief Memory-mapped game database with a Zobrist-keyed position index.
+//
+// File layout (little-endian, every section 8-byte aligned):
+//   header        DbHeader (64 bytes)
+//   games         every game's compact encoding back to back (optional 13 byte start position, then
+//                 the turns as in savefile.h)
+//   game table    one DbGameEntry per game
+//   buckets       DB_BUCKET_COUNT + 1 uint64 offsets into the index, one bucket per top 16 bits of the key
+//   index         DbIndexEntry for every distinct position of every game, sorted by (key, game, ply)
+//
+// The file is only ever read after it is built, so any number of threads and processes can map it and
+// query it at the same time. A lookup is one bucket read plus a binary search over a few entries.
+
+#ifndef GAMEDB_H
+#define GAMEDB_H
+
+#include "pdn.h"
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+const uint32_t DB_VERSION = 1;          // Current version of the database format
+const int DB_BUCKET_BITS = 16;          // Top bits of the position key used to pick an index bucket
+const int DB_BUCKET_COUNT = 1 << DB_BUCKET_BITS;
+const size_t DB_DEFAULT_RUN_ENTRIES = 8 * 1024 * 1024; // Index entries kept in memory before spilling a sorted run (128 MB)
+
+struct DbHeader {
+    char magic[4];          // "ECDB"
+    uint32_t version;
+    uint64_t gameCount;
+    uint64_t indexCount;    // Number of DbIndexEntry records
+    uint64_t gameTableOffset;
+    uint64_t bucketOffset;
+    uint64_t indexOffset;
+    uint64_t reserved[2];
+};
+
+struct DbGameEntry {
+    uint64_t offset;        // Where the game's encoding starts in the file
+    uint32_t length;        // Bytes of encoding
+    uint16_t turns;         // Number of turns in the game
+    uint8_t flags;          // SAVE_FLAG_CUSTOM_START if the encoding starts with a position
+    uint8_t result;         // PdnResult
+};
+
+struct DbIndexEntry {
+    uint64_t key;           // ZobristHash of the position
+    uint32_t game;          // Game number (index into the game table)
+    uint16_t ply;           // Turns played in that game before the position (first occurrence only)
+    uint16_t reserved;
+};
+
+// An open, read-only database. All queries point straight into the mapped file.
+struct GameDatabase {
+    const uint8_t *data;
+    size_t size;
+    const DbHeader *header;
+    const DbGameEntry *games;
+    const uint64_t *buckets;
+    const DbIndexEntry *index;
+    void *mapping;          // Platform handle for the mapping (Windows only)
+};
+
+// State of a database being built. Games are written as they arrive; the index is sorted in runs on disk.
+struct GameDatabaseWriter {
+    std::string path;
+    FILE *file;
+    uint64_t offset;                        // Bytes written so far
+    std::vector<DbGameEntry> games;
+    std::vector<DbIndexEntry> run;          // Index entries not yet spilled
+    size_t runCapacity;
+    std::vector<std::string> runFiles;      // Sorted runs waiting to be merged
+};
+
+bool OpenGameDatabase(GameDatabase &db, const std::string &path, std::string &error); // Maps a database read-only and checks its header.
+void CloseGameDatabase(GameDatabase &db);
+size_t FindPosition(const GameDatabase &db, uint64_t key, const DbIndexEntry *&first); // Returns how many games reached the position; first points at the matching entries.
+bool ReadDatabaseGame(const GameDatabase &db, uint32_t game, GameRecord &record, Bitboards &finalPos); // Decodes and validates one game.
+
+bool BeginGameDatabase(GameDatabaseWriter &writer, const std::string &path, size_t runEntries, std::string &error);
+bool AddDatabaseGame(GameDatabaseWriter &writer, const GameRecord &record, PdnResult result, std::string &error);
+bool FinishGameDatabase(GameDatabaseWriter &writer, std::string &error); // Merges the index runs and completes the file.
+
+#endif
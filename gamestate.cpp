@@ -0,0 +1,523 @@
+// @file gamestate.cpp
+// @brief The board the game is played on: setting it up, the per-piece move rules, applying clicks, turns,
+// undo/redo and conversion to and from bitboards. Nothing here uses raylib, so the tools can drive it too.
+
+#include "gamestate.h"
+#include "profiler.h"
+#include <cstdlib>
+
+using namespace std;
+
+
+void InitializeGame(GameState &gameState) {
+    // Initialize board with default pieces
+    int player1Rows = 3;
+    int player2Rows = 3;
+    int boardColumns = BOARD_WIDTH / CELL_SIZE;
+
+    for (int y = 0; y < BOARD_HEIGHT / CELL_SIZE; y++) {
+        for (int x = 0; x < boardColumns; x++) {
+            gameState.board[y][x].type = NONE;
+            gameState.board[y][x].isKing = false;
+
+            if ((x + y) % 2 != 0 && y < player1Rows) {
+                gameState.board[y][x].type = REGULAR;
+                gameState.board[y][x].player = PLAYER1;
+            } else if ((x + y) % 2 != 0 && y >= (BOARD_HEIGHT / CELL_SIZE - player2Rows)) {
+                gameState.board[y][x].type = REGULAR;
+                gameState.board[y][x].player = PLAYER2;
+            }
+        }
+    }
+
+    // Set initial game state
+    gameState.currentPlayer = PLAYER1;
+    gameState.player1Score = 0;
+    gameState.player2Score = 0;
+    gameState.pieceSelected = false;
+    gameState.selectedX = -1;
+    gameState.selectedY = -1;
+    ClearValidMoves(gameState);
+    gameState.isCapturing = false;
+    gameState.gameOver = false;
+    gameState.winner = -1;
+
+    // Start a fresh move history
+    InitialBitboards(gameState.startPosition);
+    gameState.moveHistory.clear();
+    gameState.redoMoves.clear();
+    gameState.revision++;
+}
+
+
+void ApplyClick(GameState &gameState, int x, int y) {
+    gameState.revision++;  // A click may select, move or capture, so the board must be redrawn
+    bool onBoard = x >= 0 && x < BOARD_WIDTH / CELL_SIZE && y >= 0 && y < BOARD_HEIGHT / CELL_SIZE; // Clicks on the info panel are not
+
+    if (!gameState.pieceSelected) {
+        // Only allow selecting a new piece if no multi-capture is ongoing
+        if (!gameState.isCapturing) {
+            // Select a piece
+            if (onBoard && gameState.board[y][x].type != NONE && gameState.board[y][x].player == gameState.currentPlayer) {
+                gameState.pieceSelected = true;
+                gameState.selectedX = x;
+                gameState.selectedY = y;
+                //calculates all the valid moves for the selected piece.
+                FindValidMoves(gameState, x, y, false);  // false indicates initial move.
+            }
+        }
+    } else {
+        // Prevent selecting another piece during multiple capture scenario
+        if (!gameState.isCapturing && onBoard && gameState.board[y][x].type != NONE && gameState.board[y][x].player == gameState.currentPlayer) {
+            // Allow selecting another piece only if a capture sequence is not ongoing
+            gameState.pieceSelected = true;
+            gameState.selectedX = x;
+            gameState.selectedY = y;
+            FindValidMoves(gameState, x, y, false);  // Recalculate valid moves for the new piece
+        } else if (IsValidMove(gameState, x, y)) {
+            // Start recording the turn on its first step
+            if (!gameState.isCapturing) {
+                gameState.currentMove.from = (uint8_t)SquareIndex(gameState.selectedX, gameState.selectedY);
+                gameState.currentMove.length = 0;
+                gameState.currentMove.promotes = 0;
+                gameState.currentMove.captured = 0;
+                gameState.currentMove.capturedKings = 0;
+            }
+
+            // Move the selected piece
+            Piece &movingPiece = gameState.board[gameState.selectedY][gameState.selectedX];
+            Piece &destinationPiece = gameState.board[y][x];
+            
+            // Determine if the move is a capture by checking if the piece jumps over an opponent's piece
+            bool isCapture = abs(gameState.selectedX - x) > 1 && abs(gameState.selectedY - y) > 1;
+
+            // Handle capture
+            if (isCapture) {
+                // King long-range capture logic
+                if (movingPiece.isKing) {
+
+                    // To determine direction of movement based on the destination piece(the direction in which the piece has moved)
+                    int dx = (x > gameState.selectedX) ? 1 : -1;
+                    int dy = (y > gameState.selectedY) ? 1 : -1;
+                    // Coordinates of the first square that the piece will check after moving
+                    int captureX = gameState.selectedX + dx;
+                    int captureY = gameState.selectedY + dy;
+                    bool captureAllowed = false;
+
+                    // Traverse diagonally to find opponent's piece and capture
+                    while (captureX != x && captureY != y) {
+                        if (gameState.board[captureY][captureX].type != NONE &&
+                            gameState.board[captureY][captureX].player != gameState.currentPlayer) {
+                            captureAllowed = true;  // Capture is valid only if an opponent's piece is found
+                            gameState.currentMove.captured |= SquareBit(SquareIndex(captureX, captureY));
+                            if (gameState.board[captureY][captureX].isKing) {
+                                gameState.currentMove.capturedKings |= SquareBit(SquareIndex(captureX, captureY));
+                            }
+                            gameState.board[captureY][captureX].type = NONE;  // Capture opponent piece
+
+                            // Update scores
+                            if (gameState.currentPlayer == PLAYER1) {
+                                gameState.player1Score++;
+                            } else {
+                                gameState.player2Score++;
+                            }
+                            break;  // Stop after capturing the first piece
+                        }
+                        captureX += dx;
+                        captureY += dy;
+                    }
+
+                    if (!captureAllowed) {
+                        // If no valid capture was found, treat it as a regular move
+                        isCapture = false;
+                    } else {
+                        // Check for additional captures, but restrict backward captures
+                        int nextX, nextY;  // potential positions for additional capture
+                        bool additionalCapturePossible = false;
+
+                        // The nested loops iterate through potential directions for capturing additional pieces.
+                        for (int directionX = -1; directionX <= 1; directionX += 2) {
+                            for (int directionY = 1; directionY >= -1; directionY -= 2) {  // Only forward captures
+                                nextX = x + directionX * 2;
+                                nextY = y + directionY * 2;
+                                
+                                if (nextX >= 0 && nextX < BOARD_WIDTH / CELL_SIZE &&
+                                    nextY >= 0 && nextY < BOARD_HEIGHT / CELL_SIZE &&
+                                    gameState.board[nextY][nextX].type == NONE &&
+                                    gameState.board[y + directionY][x + directionX].player != gameState.currentPlayer &&
+                                    gameState.board[y + directionY][x + directionX].type != NONE) {
+                                    
+                                    additionalCapturePossible = true;
+                                    break;  // Additional capture found, so break out of the loop
+                                }
+                            }
+
+                            // If we found another piece to capture, stop looking for more captures in that direct
+                            if (additionalCapturePossible) break;
+                        }
+
+                        if (!additionalCapturePossible) {
+                            isCapture = false;
+                        }
+                    }
+                } else {
+                    // Regular piece capture (same as before)
+                    int capturedX = (gameState.selectedX + x) / 2;
+                    int capturedY = (gameState.selectedY + y) / 2;
+                    gameState.currentMove.captured |= SquareBit(SquareIndex(capturedX, capturedY));
+                    if (gameState.board[capturedY][capturedX].isKing) {
+                        gameState.currentMove.capturedKings |= SquareBit(SquareIndex(capturedX, capturedY));
+                    }
+                    gameState.board[capturedY][capturedX].type = NONE;
+
+                    // Update scores
+                    if (gameState.currentPlayer == PLAYER1) {
+                        gameState.player1Score++;
+                    } else {
+                        gameState.player2Score++;
+                    }
+                }
+
+                // Mark that the capturing sequence is ongoing
+                gameState.isCapturing = true;
+            }
+
+            // Move the piece
+            destinationPiece = movingPiece;
+            movingPiece.type = NONE;
+            gameState.currentMove.path[gameState.currentMove.length++] = (uint8_t)SquareIndex(x, y);
+            gameState.currentMove.to = (uint8_t)SquareIndex(x, y);
+
+            bool wasKing = movingPiece.isKing;
+            PromoteToKing(gameState, x, y);
+
+            // If the piece was promoted to a King, force the player to switch turns
+            if (!wasKing && destinationPiece.isKing) {
+                gameState.currentMove.promotes = 1;
+                RecordTurn(gameState);
+                gameState.pieceSelected = false;
+                ClearValidMoves(gameState);
+                gameState.isCapturing = false;  // Reset capturing state
+                SwitchTurn(gameState);
+                return;
+            }
+
+            // Check if the King can make additional captures
+            FindValidMoves(gameState, x, y, true);  // true indicates after capture
+
+            if (isCapture && gameState.validMoveCount > 0) {
+                // Keep the piece selected if more captures are possible
+                gameState.pieceSelected = true;
+                gameState.selectedX = x;
+                gameState.selectedY = y;
+            } else {
+                // No additional captures or it's a regular move, record the turn and switch
+                RecordTurn(gameState);
+                gameState.pieceSelected = false;
+                ClearValidMoves(gameState);
+                gameState.isCapturing = false;  // Reset capturing state
+                SwitchTurn(gameState);
+            }
+        } else {
+            // Invalid move or trying to select a different piece during capture
+            if (gameState.isCapturing) {
+                // Prevent selecting other pieces during multi-capture
+                return;
+            }
+
+            // Deselect the piece if it's an invalid move
+            gameState.pieceSelected = false;
+            ClearValidMoves(gameState);
+        }
+    }
+}
+
+
+void SwitchTurn(GameState &gameState) {
+    gameState.currentPlayer = (gameState.currentPlayer == PLAYER1) ? PLAYER2 : PLAYER1;
+    UpdateGameOver(gameState);
+}
+
+
+bool IsValidMove(const GameState &gameState, int endX, int endY) {
+    // Valid moves are always dark squares on the board, so anything else cannot be one
+    if (endX < 0 || endX >= BOARD_WIDTH / CELL_SIZE || endY < 0 || endY >= BOARD_HEIGHT / CELL_SIZE || (endX + endY) % 2 == 0) {
+        return false;
+    }
+    return (gameState.validMoveMask & SquareBit(SquareIndex(endX, endY))) != 0;
+}
+
+
+void ClearValidMoves(GameState &gameState) {
+    gameState.validMoveCount = 0;
+    gameState.validMoveMask = 0;
+}
+
+
+bool AddValidMove(GameState &gameState, int x, int y) {
+    if (gameState.validMoveCount >= MAX_VALID_MOVES) {
+        return false;
+    }
+    gameState.validMoves[gameState.validMoveCount].x = x;
+    gameState.validMoves[gameState.validMoveCount].y = y;
+    gameState.validMoveCount++;
+    gameState.validMoveMask |= SquareBit(SquareIndex(x, y));
+    return true;
+}
+
+
+void FindValidMoves(GameState &gameState, int x, int y, bool isAfterCapture) {
+    ClearValidMoves(gameState);
+
+    Piece piece = gameState.board[y][x];
+    // Array to store movement direction vectors for a piece (dx, dy) for four diagonal directions
+    int directions[4][2];
+
+    if (piece.isKing) {
+        // Kings can move and capture in all directions
+        directions[0][0] = 1; directions[0][1] = 1;   // Down-right
+        directions[1][0] = -1; directions[1][1] = 1;  // Down-left
+        directions[2][0] = 1; directions[2][1] = -1;  // Up-right
+        directions[3][0] = -1; directions[3][1] = -1; // Up-left
+        int numDirections = 4;
+
+        bool captureAvailable = false;  // Track if there's any capture available
+
+        for (int i = 0; i < numDirections; i++) {
+            int dx = directions[i][0]; //stores change in the x coordinates for the current piece.
+            int dy = directions[i][1];//stores change in the y coordinates for the current piece.
+            int newX = x;
+            int newY = y;
+            bool opponentPieceFound = false;  // Track if an opponent's piece is found
+
+            // Check for possible captures
+            while (true) {
+                newX += dx;
+                newY += dy;
+
+                if (newX < 0 || newX >= BOARD_WIDTH / CELL_SIZE || newY < 0 || newY >= BOARD_HEIGHT / CELL_SIZE) {
+                    break;  // Out of bounds
+                }
+
+                if (gameState.board[newY][newX].type == NONE) {
+                    if (opponentPieceFound) {
+                        // If an opponent's piece was found, this is a valid capture move
+                        // King lands immediately after the opponent's piece (diagonal)
+                        if (AddValidMove(gameState, newX, newY)) {
+                            captureAvailable = true;  // Indicate that captures are possible
+                        }
+                        break;  // Stop further movement after landing after capture
+                    } else if (!isAfterCapture) {
+                        // Allow regular moves only if not after a capture
+                        AddValidMove(gameState, newX, newY);
+                    }
+                } else {
+                    // This marks that capturing may be possible in the future if there is an empty cell immediately after this opponent's piece.
+                    if (gameState.board[newY][newX].player != piece.player) {
+                        if (!opponentPieceFound) {
+                            opponentPieceFound = true;  // Found an opponent piece
+                        } else {
+                            break;  // If we've already found one, can't capture beyond it
+                        }
+                    } else {
+                        break;  // Blocked by own piece, stop further checks in this direction
+                    }
+                }
+            }
+        }
+
+        // If it's after a capture, only allow moves that result in more captures
+        if (isAfterCapture && !captureAvailable) {
+            ClearValidMoves(gameState);  // No valid moves if there are no captures
+        }
+
+    } else {
+        // Regular pieces move forward only after a capture
+        if (piece.player == PLAYER1) {
+            // Player 1's pieces move down the board
+            directions[0][0] = 1; directions[0][1] = 1; // Down-right
+            directions[1][0] = -1; directions[1][1] = 1; // Down-left
+        } else {
+            // Player 2's pieces move up the board
+            directions[0][0] = 1; directions[0][1] = -1; // Up-right
+            directions[1][0] = -1; directions[1][1] = -1; // Up-left
+        }
+        int numDirections = 2;
+
+        for (int i = 0; i < numDirections; i++) {
+            int dx = directions[i][0];
+            int dy = directions[i][1];
+            int newX = x + dx;
+            int newY = y + dy;
+
+            if (newX >= 0 && newX < BOARD_WIDTH / CELL_SIZE && newY >= 0 && newY < BOARD_HEIGHT / CELL_SIZE) {
+                if (gameState.board[newY][newX].type == NONE && !isAfterCapture) {
+                    // Regular forward move (only if not after a capture)
+                    AddValidMove(gameState, newX, newY);
+                }
+
+                // Check for capturing move (can move only forward after capture)
+                int captureX = x + 2 * dx;
+                int captureY = y + 2 * dy;
+                if (captureX >= 0 && captureX < BOARD_WIDTH / CELL_SIZE && 
+                    captureY >= 0 && captureY < BOARD_HEIGHT / CELL_SIZE) {
+                    if (gameState.board[captureY][captureX].type == NONE &&
+                        gameState.board[newY][newX].type != NONE &&
+                        gameState.board[newY][newX].player != piece.player) {
+                        AddValidMove(gameState, captureX, captureY);
+                    }
+                }
+            }
+        }
+    }
+}
+
+
+
+
+void PromoteToKing(GameState &gameState, int x, int y) {
+    if (gameState.currentPlayer == PLAYER1 && y == BOARD_HEIGHT / CELL_SIZE - 1) {
+        gameState.board[y][x].isKing = true;
+        gameState.board[y][x].type = KING;
+    } else if (gameState.currentPlayer == PLAYER2 && y == 0) {
+        gameState.board[y][x].isKing = true;
+        gameState.board[y][x].type = KING;
+    }
+}
+
+
+
+
+// The game is lost by the player to move when they have no pieces left or no legal turn, using the same
+// move generator the save files are checked with, so the result always matches the moves on offer.
+void UpdateGameOver(GameState &gameState) {
+    uint64_t startTime = ProfilerNow();
+    Bitboards pos;
+    GameStateToBitboards(gameState, pos);
+
+    MoveList moves;
+    GenerateMoves(pos, moves);
+
+    gameState.gameOver = pos.pieces[pos.sideToMove] == 0 || moves.count == 0;
+    gameState.winner = gameState.gameOver ? ((gameState.currentPlayer == PLAYER1) ? PLAYER2 : PLAYER1) : -1;
+    ProfilerAddPhase(PHASE_GAME_OVER, startTime);
+}
+
+
+
+
+
+void GameStateToBitboards(const GameState &gameState, Bitboards &pos) {
+    pos.pieces[0] = 0;
+    pos.pieces[1] = 0;
+    pos.kings = 0;
+    for (int y = 0; y < BOARD_HEIGHT / CELL_SIZE; y++) {
+        for (int x = 0; x < BOARD_WIDTH / CELL_SIZE; x++) {
+            const Piece &piece = gameState.board[y][x];
+            if (piece.type != NONE) {
+                pos.pieces[piece.player] |= SquareBit(SquareIndex(x, y));
+                if (piece.isKing) {
+                    pos.kings |= SquareBit(SquareIndex(x, y));
+                }
+            }
+        }
+    }
+    pos.sideToMove = (gameState.currentPlayer == PLAYER1) ? 0 : 1;
+}
+
+
+void BitboardsToGameState(const Bitboards &pos, GameState &gameState) {
+    for (int y = 0; y < BOARD_HEIGHT / CELL_SIZE; y++) {
+        for (int x = 0; x < BOARD_WIDTH / CELL_SIZE; x++) {
+            Piece &piece = gameState.board[y][x];
+            piece.type = NONE;
+            piece.player = PLAYER1;
+            piece.isKing = false;
+
+            if ((x + y) % 2 != 0) {
+                uint32_t bit = SquareBit(SquareIndex(x, y));
+                if ((pos.pieces[0] | pos.pieces[1]) & bit) {
+                    piece.player = (pos.pieces[0] & bit) ? PLAYER1 : PLAYER2;
+                    piece.isKing = (pos.kings & bit) != 0;
+                    piece.type = piece.isKing ? KING : REGULAR;
+                }
+            }
+        }
+    }
+
+    // Scores are the number of opponent pieces captured
+    gameState.currentPlayer = (pos.sideToMove == 0) ? PLAYER1 : PLAYER2;
+    gameState.player1Score = 12 - PopCount(pos.pieces[1]);
+    gameState.player2Score = 12 - PopCount(pos.pieces[0]);
+    gameState.pieceSelected = false;
+    gameState.selectedX = -1;
+    gameState.selectedY = -1;
+    ClearValidMoves(gameState);
+    gameState.isCapturing = false;
+    UpdateGameOver(gameState);
+    gameState.revision++;
+}
+
+
+void GameRecordToGameState(const GameRecord &record, GameState &gameState) {
+    Bitboards pos = record.start;
+    for (const Move &move : record.moves) {
+        MakeMove(pos, move);
+    }
+    BitboardsToGameState(pos, gameState);
+    gameState.startPosition = record.start;
+    gameState.moveHistory = record.moves;
+    gameState.redoMoves.clear();
+}
+
+
+void RecordTurn(GameState &gameState) {
+    gameState.moveHistory.push_back(gameState.currentMove);
+    gameState.redoMoves.clear();
+}
+
+
+bool UndoMove(GameState &gameState) {
+    Bitboards pos;
+    GameStateToBitboards(gameState, pos);
+
+    if (gameState.isCapturing) {
+        // Put the board back to the start of this turn; the partial turn unmakes like a finished one
+        pos.sideToMove ^= 1;
+        UnmakeMove(pos, gameState.currentMove);
+    } else if (!gameState.moveHistory.empty()) {
+        UnmakeMove(pos, gameState.moveHistory.back());
+        gameState.redoMoves.push_back(gameState.moveHistory.back());
+        gameState.moveHistory.pop_back();
+    } else {
+        return false;
+    }
+
+    BitboardsToGameState(pos, gameState);
+    return true;
+}
+
+
+void ApplyTurn(GameState &gameState, const Move &move) {
+    Bitboards pos;
+    GameStateToBitboards(gameState, pos);
+    MakeMove(pos, move);
+    gameState.moveHistory.push_back(move);
+    gameState.redoMoves.clear();
+    BitboardsToGameState(pos, gameState);
+}
+
+
+bool RedoMove(GameState &gameState) {
+    if (gameState.redoMoves.empty() || gameState.isCapturing) {
+        return false;
+    }
+
+    Bitboards pos;
+    GameStateToBitboards(gameState, pos);
+    MakeMove(pos, gameState.redoMoves.back());
+    gameState.moveHistory.push_back(gameState.redoMoves.back());
+    gameState.redoMoves.pop_back();
+    BitboardsToGameState(pos, gameState);
+    return true;
+}
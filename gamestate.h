@@ -0,0 +1,76 @@
+// @file gamestate.h
+// @brief The board model the game window plays on: pieces on an 8x8 board, the selected piece and its moves,
+// the turn in progress and the move history.
+//
+// ApplyClick is everything a mouse click on the board does, so the tools can play through exactly the same
+// rules as the window by feeding it board coordinates.
+
+#ifndef GAMESTATE_H
+#define GAMESTATE_H
+
+#include "rules.h"
+#include "render.h"
+#include "savefile.h"
+#include <vector>
+
+const int MAX_VALID_MOVES = 13;         // The most squares a selected piece can move to (a king near the centre of an empty board).
+
+enum PieceType { NONE, REGULAR, KING }; // Enum to represent the type of a game piece.
+enum Player { PLAYER1, PLAYER2 }; // Enum to represent the players in the game.
+
+// Struct to represent a game piece.
+struct Piece {
+    PieceType type;
+    Player player;
+    bool isKing;
+};
+
+
+// Struct to represent the position(location) of an item on a board.
+struct Position {
+    int x; // Horizontal component
+    int y; // Vertical component
+};
+
+
+// This Struct is like a giant box where we store all the information about the game at any point.
+struct GameState {
+    Piece board[BOARD_HEIGHT / CELL_SIZE][BOARD_WIDTH / CELL_SIZE]; // 2D array representing the game board with pieces
+    Player currentPlayer; // Tracks which player's turn it is (PLAYER1 or PLAYER2)
+    int player1Score; // Score for player 1
+    int player2Score; // Score for player 2
+    bool pieceSelected; // Indicates if a piece has been selected for movement
+    int selectedX; // X-coordinate of the currently selected piece
+    int selectedY; // Y-coordinate of the currently selected piece
+    Position validMoves[MAX_VALID_MOVES]; // Stores list of possible moves for the selected piece
+    int validMoveCount; // Number of valid moves available for the selected piece
+    uint32_t validMoveMask; // The same squares as validMoves, one bit per square (see SquareBit)
+    bool isCapturing; // Tracks if a piece is currently in the middle of a capture sequence
+    Bitboards startPosition; // Position the recorded move history starts from
+    std::vector<Move> moveHistory; // Every completed turn, in the order they were played
+    std::vector<Move> redoMoves; // Turns taken back with undo, the most recently undone last
+    Move currentMove; // The turn being played (landing squares so far during a capture sequence)
+    bool gameOver; // Set when the player to move has no pieces or no legal moves
+    int winner; // PLAYER1 or PLAYER2 once the game is over, -1 before that
+    unsigned int revision = 0; // Bumped whenever anything drawn on the board may have changed
+};
+
+
+void InitializeGame(GameState &gameState); //Sets up the game at the start, including placing pieces on the board.
+void ApplyClick(GameState &gameState, int x, int y); // Everything a left click on board square (x, y) does: selects a piece, moves it, captures, and ends the turn.
+void UpdateGameOver(GameState &gameState); // Decides whether the player to move has lost; called once per applied turn.
+void PromoteToKing(GameState &gameState, int x, int y); // Promotes a piece to a king if it reaches the opposite side of the board.
+void SwitchTurn(GameState &gameState);// Switches the turn to the next player in the game.
+bool IsValidMove(const GameState &gameState, int endX, int endY);// Validates whether the selected piece may move to (endX, endY).
+void FindValidMoves(GameState &gameState, int x, int y, bool isAfterCapture);//  Finds all the places a piece can move to.
+void ClearValidMoves(GameState &gameState); // Empties the list (and mask) of valid moves.
+bool AddValidMove(GameState &gameState, int x, int y); // Adds a square to the valid moves; returns false if the list is full.
+void GameStateToBitboards(const GameState &gameState, Bitboards &pos); // Converts the board and turn into the compact bitboard position.
+void BitboardsToGameState(const Bitboards &pos, GameState &gameState); // Sets the board, turn and scores from a bitboard position and clears any selection.
+void GameRecordToGameState(const GameRecord &record, GameState &gameState); // Sets the board to the end of the record, with its turns as the move history.
+void RecordTurn(GameState &gameState); // Adds the finished turn to the move history; a new turn discards anything that could be redone.
+bool UndoMove(GameState &gameState); // Takes back the capture sequence in progress, or else the last turn. Returns false if there is nothing to undo.
+void ApplyTurn(GameState &gameState, const Move &move); // Plays a whole turn made elsewhere (the opponent, online) and records it.
+bool RedoMove(GameState &gameState); // Plays the most recently undone turn again. Returns false if there is nothing to redo.
+
+#endif
@@ -0,0 +1,182 @@
+// @file input.cpp
+// @brief Scripted input source, input script reader and session recorder. Nothing here uses raylib.
+
+#include "input.h"
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+using namespace std;
+
+
+void ClearInputFrame(InputFrame &frame) {
+    frame.clicked = false;
+    frame.mouseX = 0;
+    frame.mouseY = 0;
+    frame.keysPressed = 0;
+}
+
+
+static bool ReadScriptedFrame(void *context, InputFrame &frame) {
+    ScriptedInput &scripted = *(ScriptedInput *)context;
+    const InputScript &script = *scripted.script;
+    ClearInputFrame(frame);
+
+    if (scripted.nextEvent >= script.events.size()) {
+        return scripted.frame++ < script.frames && !scripted.skipIdleFrames;  // Idle frames after the last input
+    }
+
+    const InputEvent &event = script.events[scripted.nextEvent];
+    if (scripted.skipIdleFrames) {
+        scripted.frame = event.frame;
+    }
+    if (scripted.frame == event.frame) {
+        frame = event.input;
+        scripted.nextEvent++;
+    }
+    scripted.frame++;
+    return true;
+}
+
+
+void InitScriptedInput(InputSource &source, ScriptedInput &scripted, const InputScript &script, bool skipIdleFrames) {
+    scripted.script = &script;
+    scripted.nextEvent = 0;
+    scripted.frame = 0;
+    scripted.skipIdleFrames = skipIdleFrames;
+    source.context = &scripted;
+    source.readFrame = ReadScriptedFrame;
+}
+
+
+static bool DecodeHex(const string &text, vector<uint8_t> &bytes) {
+    if (text.size() % 2 != 0) return false;
+    for (size_t i = 0; i < text.size(); i += 2) {
+        unsigned value;
+        if (sscanf(text.c_str() + i, "%2x", &value) != 1) return false;
+        bytes.push_back((uint8_t)value);
+    }
+    return true;
+}
+
+
+bool ReadInputScript(const string &path, InputScript &script, string &error) {
+    script.events.clear();
+    script.hasStart = false;
+    script.frames = 0;
+    script.endFen.clear();
+
+    ifstream file(path);
+    if (!file.is_open()) {
+        error = "could not open " + path;
+        return false;
+    }
+
+    string line;
+    int lineNumber = 0;
+    while (getline(file, line)) {
+        lineNumber++;
+        if (line.empty() || line[0] == '#') continue;
+        istringstream fields(line);
+        string first;
+        fields >> first;
+        error = "line " + to_string(lineNumber) + ": ";
+
+        if (first == "game") {
+            string hex;
+            vector<uint8_t> bytes;
+            Bitboards finalPos;
+            if (!(fields >> hex) || !DecodeHex(hex, bytes) ||
+                DecodeGameRecord(bytes.data(), bytes.size(), script.start, finalPos) != SAVE_OK) {
+                error += "bad start game";
+                return false;
+            }
+            script.hasStart = true;
+        } else if (first == "end") {
+            if (!(fields >> script.frames >> script.endFen)) {
+                error += "expected \"end <frames> <FEN>\"";
+                return false;
+            }
+        } else {
+            char *rest = nullptr;
+            unsigned long frame = strtoul(first.c_str(), &rest, 10);
+            if (first.empty() || *rest != '\0') {
+                error += "unknown line \"" + line + "\"";
+                return false;
+            }
+            if (!script.events.empty() && frame < script.events.back().frame) {
+                error += "frames must not go back";
+                return false;
+            }
+            if (script.events.empty() || script.events.back().frame != frame) {
+                InputEvent event;
+                event.frame = (uint32_t)frame;
+                ClearInputFrame(event.input);
+                script.events.push_back(event);
+            }
+
+            InputFrame &input = script.events.back().input;
+            string kind;
+            fields >> kind;
+            if (kind == "click" && fields >> input.mouseX >> input.mouseY) {
+                input.clicked = true;
+            } else if (kind == "key") {
+                string key;
+                fields >> key;
+                const char *found = (key.size() == 1) ? strchr(INPUT_KEY_NAMES, key[0]) : nullptr;
+                if (found == nullptr || *found == '\0') {
+                    error += "unknown key \"" + key + "\"";
+                    return false;
+                }
+                input.keysPressed |= 1u << (found - INPUT_KEY_NAMES);
+            } else {
+                error += "expected \"click <x> <y>\" or \"key <K>\"";
+                return false;
+            }
+        }
+    }
+
+    error.clear();
+    return true;
+}
+
+
+bool OpenInputRecording(InputRecorder &recorder, const string &path, const GameRecord &start) {
+    recorder.frame = 0;
+    recorder.file = fopen(path.c_str(), "w");
+    if (recorder.file == nullptr) return false;
+
+    vector<uint8_t> bytes;
+    EncodeGameRecord(start, bytes);
+    fprintf(recorder.file, "# Checkers input recording: \"<frame> click <x> <y>\" or \"<frame> key <K>\"\ngame ");
+    for (uint8_t byte : bytes) {
+        fprintf(recorder.file, "%02x", byte);
+    }
+    fprintf(recorder.file, "\n");
+    return true;
+}
+
+
+// Lines go through the FILE buffer, so recording a frame does not allocate.
+void RecordInputFrame(InputRecorder &recorder, const InputFrame &frame) {
+    if (recorder.file == nullptr) return;
+
+    if (frame.clicked) {
+        fprintf(recorder.file, "%u click %d %d\n", recorder.frame, frame.mouseX, frame.mouseY);
+    }
+    for (int key = 0; key < INPUT_KEY_COUNT; key++) {
+        if (InputKeyPressed(frame, (InputKey)key)) {
+            fprintf(recorder.file, "%u key %c\n", recorder.frame, INPUT_KEY_NAMES[key]);
+        }
+    }
+    recorder.frame++;
+}
+
+
+void CloseInputRecording(InputRecorder &recorder, const string &endFen) {
+    if (recorder.file == nullptr) return;
+    fprintf(recorder.file, "end %u %s\n", recorder.frame, endFen.c_str());
+    fclose(recorder.file);
+    recorder.file = nullptr;
+}
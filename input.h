@@ -0,0 +1,92 @@
+// @file input.h
+// @brief Where the game's input comes from: the mouse and keyboard, or a recorded session played back.
+//
+// The main loop reads one InputFrame per frame from an InputSource instead of asking raylib directly. The
+// live source (raylibinput.cpp, the game only) reads the mouse and keyboard; the scripted source replays an
+// InputScript, either frame by frame in the window or skipping the frames without input for headless
+// replay at full speed. An InputRecorder writes the frames of a live session that had input.
+//
+// Script files are text, one line per input: "<frame> click <x> <y>" (window pixels) or "<frame> key <K>"
+// (one of INPUT_KEY_NAMES), frames counted from 0 in increasing order. An optional "game <hex>" line holds the
+// save file (savefile.h) of the board the session started from, and "end <frames> <FEN>" the number of frames
+// the session ran and the position it ended in. Lines starting with '#' are comments.
+
+#ifndef INPUT_H
+#define INPUT_H
+
+#include "savefile.h"
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// The keys the game reacts to.
+enum InputKey {
+    INPUT_KEY_Z,    // Undo
+    INPUT_KEY_Y,    // Redo
+    INPUT_KEY_S,    // Save
+    INPUT_KEY_L,    // Load
+    INPUT_KEY_P,    // Profiler overlay
+    INPUT_KEY_T,    // Write a trace (tracing builds only)
+    INPUT_KEY_Q,    // Quit once the game is over
+    INPUT_KEY_R,    // Restart once the game is over
+    INPUT_KEY_COUNT
+};
+
+const char INPUT_KEY_NAMES[INPUT_KEY_COUNT + 1] = "ZYSLPTQR"; // Letter of every InputKey, as written in scripts
+
+// Everything the game reads in one frame.
+struct InputFrame {
+    bool clicked;           // Left mouse button pressed this frame
+    int mouseX;             // Pointer position in window pixels when clicked
+    int mouseY;
+    uint32_t keysPressed;   // One bit per InputKey pressed this frame
+};
+
+// Fills in the input of the next frame. `readFrame` returns false once a script has run out.
+struct InputSource {
+    void *context;
+    bool (*readFrame)(void *context, InputFrame &frame);
+};
+
+// One frame of a script that had input.
+struct InputEvent {
+    uint32_t frame;
+    InputFrame input;
+};
+
+struct InputScript {
+    std::vector<InputEvent> events; // In frame order, at most one per frame
+    bool hasStart;                  // The session started from `start` rather than a new game
+    GameRecord start;
+    uint32_t frames;                // Frames the session ran, 0 if not known
+    std::string endFen;             // Position the session ended in, empty if not known
+};
+
+// Replay state of the scripted source.
+struct ScriptedInput {
+    const InputScript *script;
+    size_t nextEvent;
+    uint32_t frame;         // Frame the next readFrame call returns
+    bool skipIdleFrames;    // Jump straight to the next frame with input (headless replay)
+};
+
+// Writes the frames of a live session that had input.
+struct InputRecorder {
+    FILE *file;             // nullptr when not recording
+    uint32_t frame;         // Frames recorded so far
+};
+
+inline bool InputKeyPressed(const InputFrame &frame, InputKey key) { return (frame.keysPressed >> key) & 1u; }
+inline bool InputFrameEmpty(const InputFrame &frame) { return !frame.clicked && frame.keysPressed == 0; }
+
+void ClearInputFrame(InputFrame &frame);
+void InitRaylibInput(InputSource &source); // Reads the mouse and keyboard (raylibinput.cpp, the game only).
+void InitScriptedInput(InputSource &source, ScriptedInput &scripted, const InputScript &script, bool skipIdleFrames);
+
+bool ReadInputScript(const std::string &path, InputScript &script, std::string &error); // error says which line is wrong.
+
+bool OpenInputRecording(InputRecorder &recorder, const std::string &path, const GameRecord &start);
+void RecordInputFrame(InputRecorder &recorder, const InputFrame &frame); // Call once per frame, with or without input.
+void CloseInputRecording(InputRecorder &recorder, const std::string &endFen); // Writes the end line and closes the file.
+
+#endif
@@ -0,0 +1,255 @@
+// @file journal.cpp
+// @brief Append-only move journal written by a background thread, used to recover games after a crash.
+
+#include "journal.h"
+#include "profiler.h"
+#include "trace.h"
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #include <io.h>
+    #include <windows.h>
+#else
+    #include <unistd.h>
+#endif
+
+using namespace std;
+
+const uint8_t JOURNAL_MAGIC[4] = { 'E', 'C', 'J', 'L' };
+const int JOURNAL_HEADER_SIZE = 8;
+
+static void SyncFile(FILE *file) {
+    fflush(file);
+#ifdef _WIN32
+    _commit(_fileno(file));
+#else
+    fsync(fileno(file));
+#endif
+}
+
+
+static void AppendRecord(vector<uint8_t> &out, uint8_t type, const uint8_t *payload, size_t length) {
+    size_t start = out.size();
+    out.push_back(type);
+    out.push_back((uint8_t)length);
+    out.insert(out.end(), payload, payload + length);
+
+    uint32_t crc = Crc32(out.data() + start, out.size() - start);
+    for (int i = 0; i < 4; i++) {
+        out.push_back((uint8_t)((crc >> (8 * i)) & 0xFF));
+    }
+}
+
+
+static void AppendGameStart(vector<uint8_t> &out, const GameRecord &record) {
+    uint8_t payload[13];
+    for (int i = 0; i < 4; i++) {
+        payload[i] = (uint8_t)(record.start.pieces[0] >> (8 * i));
+        payload[4 + i] = (uint8_t)(record.start.pieces[1] >> (8 * i));
+        payload[8 + i] = (uint8_t)(record.start.kings >> (8 * i));
+    }
+    payload[12] = (uint8_t)record.start.sideToMove;
+    AppendRecord(out, JOURNAL_GAME_START, payload, sizeof(payload));
+
+    vector<uint8_t> encoded;
+    vector<Move> single(1);
+    for (size_t i = 0; i < record.moves.size(); i++) {
+        single[0] = record.moves[i];
+        encoded.clear();
+        EncodeMoves(single, encoded);
+        AppendRecord(out, JOURNAL_MOVE, encoded.data(), encoded.size());
+    }
+}
+
+
+// Hands bytes to the worker thread. This is the only work done on the caller's thread.
+static void Enqueue(Journal &journal, const vector<uint8_t> &bytes) {
+    {
+        lock_guard<mutex> guard(journal.lock);
+        journal.pending.insert(journal.pending.end(), bytes.begin(), bytes.end());
+    }
+    journal.wake.notify_one();
+}
+
+
+// Worker: waits for records, writes them, and syncs at most once per interval so bursts share one fsync.
+static void JournalWorker(Journal *journal) {
+    vector<uint8_t> batch;
+    TRACE_THREAD_NAME("Journal writer");
+    unique_lock<mutex> guard(journal->lock);
+
+    while (true) {
+        journal->wake.wait(guard, [journal] { return journal->stopping || !journal->pending.empty(); });
+        if (!journal->stopping) {
+            // Let more records arrive before paying for the sync
+            journal->wake.wait_for(guard, chrono::milliseconds(JOURNAL_SYNC_INTERVAL_MS), [journal] { return journal->stopping; });
+        }
+
+        batch.swap(journal->pending);
+        bool stopping = journal->stopping;
+        guard.unlock();
+
+        if (!batch.empty()) {
+            TRACE_SCOPE("Journal flush");
+            uint64_t busyStart = ProfilerNow();
+            fwrite(batch.data(), 1, batch.size(), journal->file);
+            SyncFile(journal->file);
+            journal->syncCount++;
+            batch.clear();
+            ProfilerAddThreadBusy(PROFILE_THREAD_JOURNAL, ProfilerNow() - busyStart);
+        }
+
+        guard.lock();
+        if (stopping && journal->pending.empty()) break;
+    }
+}
+
+
+bool RecoverJournal(const string &path, GameRecord &record, Bitboards &finalPos) {
+    ifstream inFile(path, ios::binary);
+    if (!inFile.is_open()) return false;
+    vector<uint8_t> bytes((istreambuf_iterator<char>(inFile)), istreambuf_iterator<char>());
+    if (bytes.size() < (size_t)JOURNAL_HEADER_SIZE || memcmp(bytes.data(), JOURNAL_MAGIC, 4) != 0) return false;
+    uint32_t version = (uint32_t)bytes[4] | ((uint32_t)bytes[5] << 8) | ((uint32_t)bytes[6] << 16) | ((uint32_t)bytes[7] << 24);
+    if (version > JOURNAL_VERSION) return false;
+
+    bool inGame = false;
+    Bitboards pos;
+    vector<Move> decoded;
+    size_t offset = JOURNAL_HEADER_SIZE;
+
+    while (offset + 6 <= bytes.size()) {
+        uint8_t type = bytes[offset];
+        size_t length = bytes[offset + 1];
+        if (offset + 2 + length + 4 > bytes.size()) break; // Torn write at the end
+
+        const uint8_t *payload = bytes.data() + offset + 2;
+        const uint8_t *stored = payload + length;
+        uint32_t crc = (uint32_t)stored[0] | ((uint32_t)stored[1] << 8) | ((uint32_t)stored[2] << 16) | ((uint32_t)stored[3] << 24);
+        if (Crc32(bytes.data() + offset, 2 + length) != crc) break;
+        offset += 2 + length + 4;
+
+        if (type == JOURNAL_GAME_START && length == 13) {
+            for (int i = 0; i < 3; i++) {
+                uint32_t value = (uint32_t)payload[4 * i] | ((uint32_t)payload[4 * i + 1] << 8) |
+                                 ((uint32_t)payload[4 * i + 2] << 16) | ((uint32_t)payload[4 * i + 3] << 24);
+                if (i < 2) record.start.pieces[i] = value;
+                else record.start.kings = value;
+            }
+            record.start.sideToMove = payload[12];
+            record.moves.clear();
+            inGame = IsValidPosition(record.start);
+            pos = record.start;
+        } else if (type == JOURNAL_MOVE && inGame) {
+            Bitboards next;
+            if (DecodeMoves(payload, length, 1, pos, decoded, next) != SAVE_OK) break;
+            record.moves.push_back(decoded[0]);
+            pos = next;
+        } else if (type == JOURNAL_UNDO && inGame && !record.moves.empty()) {
+            UnmakeMove(pos, record.moves.back());
+            record.moves.pop_back();
+        } else if (type == JOURNAL_GAME_END) {
+            inGame = false;
+        }
+    }
+
+    finalPos = pos;
+    return inGame;
+}
+
+
+// Puts `from` in place of `to` in one step, so a crash leaves either the old journal or the new one.
+static bool ReplaceJournalFile(const string &from, const string &to) {
+#ifdef _WIN32
+    return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;  // rename will not replace a file here
+#else
+    return rename(from.c_str(), to.c_str()) == 0;
+#endif
+}
+
+
+bool OpenJournal(Journal &journal, const string &path, const GameRecord &current) {
+    journal.file = nullptr;
+    journal.path = path;
+    journal.stopping = false;
+    journal.pending.clear();
+    journal.loggedMoves = current.moves.size();
+    journal.syncCount = 0;
+
+    // Start from a compact journal holding only the current game; the rename keeps the old one intact until then
+    vector<uint8_t> bytes(JOURNAL_MAGIC, JOURNAL_MAGIC + 4);
+    for (int i = 0; i < 4; i++) {
+        bytes.push_back((uint8_t)((JOURNAL_VERSION >> (8 * i)) & 0xFF));
+    }
+    AppendGameStart(bytes, current);
+
+    string tempPath = path + ".tmp";
+    FILE *temp = fopen(tempPath.c_str(), "wb");
+    if (temp == nullptr) return false;
+    bool ok = fwrite(bytes.data(), 1, bytes.size(), temp) == bytes.size();
+    SyncFile(temp);
+    fclose(temp);
+    if (!ok || !ReplaceJournalFile(tempPath, path)) return false;
+
+    journal.file = fopen(path.c_str(), "ab");
+    if (journal.file == nullptr) return false;
+    journal.worker = thread(JournalWorker, &journal);
+    return true;
+}
+
+
+void JournalStartGame(Journal &journal, const GameRecord &record) {
+    journal.loggedMoves = record.moves.size();
+    if (journal.file == nullptr) return;
+    vector<uint8_t> bytes;
+    AppendGameStart(bytes, record);
+    Enqueue(journal, bytes);
+}
+
+
+void JournalMove(Journal &journal, const Move &move) {
+    journal.loggedMoves++;
+    if (journal.file == nullptr) return;
+    vector<Move> single(1, move);
+    vector<uint8_t> encoded;
+    EncodeMoves(single, encoded);
+
+    vector<uint8_t> bytes;
+    AppendRecord(bytes, JOURNAL_MOVE, encoded.data(), encoded.size());
+    Enqueue(journal, bytes);
+}
+
+
+void JournalUndo(Journal &journal) {
+    if (journal.loggedMoves > 0) journal.loggedMoves--;
+    if (journal.file == nullptr) return;
+    vector<uint8_t> bytes;
+    AppendRecord(bytes, JOURNAL_UNDO, nullptr, 0);
+    Enqueue(journal, bytes);
+}
+
+
+void JournalEndGame(Journal &journal, int result) {
+    if (journal.file == nullptr) return;
+    uint8_t payload = (uint8_t)result;
+    vector<uint8_t> bytes;
+    AppendRecord(bytes, JOURNAL_GAME_END, &payload, 1);
+    Enqueue(journal, bytes);
+}
+
+
+void CloseJournal(Journal &journal) {
+    if (journal.file == nullptr) return;
+    {
+        lock_guard<mutex> guard(journal.lock);
+        journal.stopping = true;
+    }
+    journal.wake.notify_one();
+    journal.worker.join();
+    fclose(journal.file);
+    journal.file = nullptr;
+}
@@ -0,0 +1,44 @@
+// @file journal.h
+// @brief Append-only move journal written by a background thread, used to recover games after a crash.
+//
+// File layout: "ECJL" and a u32 version, then records of [u8 type][u8 length][payload][u32 CRC-32 of the
+// type, length and payload]. A torn or corrupted record ends recovery; everything before it is kept.
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "savefile.h"
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+const uint32_t JOURNAL_VERSION = 2;     // Current version of the journal format
+const int JOURNAL_SYNC_INTERVAL_MS = 250; // Longest time an appended record waits before it is flushed and synced
+
+enum JournalRecordType { JOURNAL_GAME_START = 'G', JOURNAL_MOVE = 'M', JOURNAL_GAME_END = 'E', JOURNAL_UNDO = 'U' };
+
+// An open journal. Appending only copies bytes into `pending`; the worker thread writes and syncs them.
+struct Journal {
+    FILE *file;
+    std::string path;
+    std::thread worker;
+    std::mutex lock;
+    std::condition_variable wake;
+    std::vector<uint8_t> pending;   // Records waiting for the worker (guarded by lock)
+    bool stopping;                  // Set by CloseJournal (guarded by lock)
+    size_t loggedMoves;             // Turns of the current game already appended
+    uint64_t syncCount;             // Number of fsyncs done by the worker
+};
+
+bool RecoverJournal(const std::string &path, GameRecord &record, Bitboards &finalPos); // Returns true if the journal ends in an unfinished game.
+bool OpenJournal(Journal &journal, const std::string &path, const GameRecord &current); // Rewrites the journal with just `current` and starts the worker.
+void JournalStartGame(Journal &journal, const GameRecord &record); // Logs a new game (with any turns it already has).
+void JournalMove(Journal &journal, const Move &move);
+void JournalUndo(Journal &journal); // Takes back the last logged turn.
+void JournalEndGame(Journal &journal, int result); // result: 0 PLAYER1 won, 1 PLAYER2 won
+void CloseJournal(Journal &journal); // Writes everything still pending, syncs and stops the worker.
+
+#endif
@@ -0,0 +1,499 @@
+// @file netclient.cpp
+// @brief Network play against a game server: the reader thread, the message ring and applying the server's
+// messages to the game.
+
+#include "netclient.h"
+#include "profiler.h"
+#include "trace.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <winsock2.h>
+    #include <ws2tcpip.h>
+    typedef SOCKET NetSocket;
+    const int SEND_FLAGS = 0;
+    const int SHUTDOWN_BOTH = SD_BOTH;
+    static void CloseSocket(NetSocket socket) { closesocket(socket); }
+    static bool SetBlocking(NetSocket socket, bool blocking) {
+        u_long nonBlocking = blocking ? 0 : 1;
+        return ioctlsocket(socket, FIONBIO, &nonBlocking) == 0;
+    }
+#else
+    #include <fcntl.h>
+    #include <netdb.h>
+    #include <netinet/in.h>
+    #include <netinet/tcp.h>
+    #include <sys/select.h>
+    #include <sys/socket.h>
+    #include <unistd.h>
+    typedef int NetSocket;
+    const int SEND_FLAGS = MSG_NOSIGNAL;    // A closed connection shows up in recv, not as SIGPIPE
+    const int SHUTDOWN_BOTH = SHUT_RDWR;
+    static void CloseSocket(NetSocket socket) { close(socket); }
+    static bool SetBlocking(NetSocket socket, bool blocking) {
+        int flags = fcntl(socket, F_GETFL, 0);
+        return flags >= 0 && fcntl(socket, F_SETFL, blocking ? (flags & ~O_NONBLOCK) : (flags | O_NONBLOCK)) == 0;
+    }
+#endif
+
+using namespace std;
+
+const RenderColor NET_TEXT_COLOR = {0, 0, 0, 255};
+const RenderColor NET_STATUS_COLOR = {80, 80, 80, 255};
+const RenderColor NET_ERROR_COLOR = {230, 41, 55, 255};
+
+
+static NetSocket SocketOf(const NetClient &client) {
+    return (NetSocket)client.socket;
+}
+
+
+// Sends one message from the main thread. The messages are tiny, so a blocking send returns at once unless
+// the connection is broken, which the reader reports.
+static void SendToServer(NetClient &client, ProtocolCommand command, const uint8_t *payload = nullptr, int payloadLength = 0) {
+    uint8_t buffer[PROTOCOL_MAX_MESSAGE];
+    int length = WriteProtocolMessage(buffer, sizeof(buffer), command, payload, payloadLength);
+    for (int sent = 0; sent < length; ) {
+        int written = (int)send(SocketOf(client), (const char *)buffer + sent, length - sent, SEND_FLAGS);
+        if (written <= 0) return;
+        sent += written;
+    }
+}
+
+
+// Connects with a time limit, checking `stopping` so closing the window never waits for a dead server.
+static bool ConnectSocket(NetClient &client, const sockaddr_in &address) {
+    NetSocket socket = SocketOf(client);
+    SetBlocking(socket, false);
+    bool connected = connect(socket, (const sockaddr *)&address, sizeof(address)) == 0;
+    for (int waited = 0; !connected && waited < NET_CONNECT_TIMEOUT_MS && !client.stopping; waited += 100) {
+        fd_set writable, failed;
+        FD_ZERO(&writable);
+        FD_ZERO(&failed);
+        FD_SET(socket, &writable);
+        FD_SET(socket, &failed);
+        timeval timeout = { 0, 100000 };
+        if (select((int)socket + 1, nullptr, &writable, &failed, &timeout) > 0) {
+            int socketError = 0;
+            socklen_t size = sizeof(socketError);
+            getsockopt(socket, SOL_SOCKET, SO_ERROR, (char *)&socketError, &size);
+            if (socketError != 0 || FD_ISSET(socket, &failed)) {
+                snprintf(client.error, sizeof(client.error), "Could not connect to %s:%d", client.host.c_str(), client.port);
+                return false;
+            }
+            connected = true;
+        }
+    }
+    if (!connected) {
+        snprintf(client.error, sizeof(client.error), "No answer from %s:%d", client.host.c_str(), client.port);
+        return false;
+    }
+    SetBlocking(socket, true);
+    int noDelay = 1;
+    setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, (const char *)&noDelay, sizeof(noDelay));
+    return true;
+}
+
+
+// The PING token: the send time in microseconds, wrapping every 71 minutes, which a round trip never gets near.
+static uint32_t PingClock() {
+    return (uint32_t)(ProfilerNow() / 1000);
+}
+
+
+// Reader thread: handles one message from the server. PONG is measured here; everything else goes to the ring.
+static void HandleServerData(NetClient &client, const uint8_t *data, int length) {
+    ProtocolMessage message;
+    bool valid = ParseProtocolMessage(data, length, message);
+    if (valid && message.command == PROTOCOL_PONG) {
+        client.latencyUs.store((int32_t)(PingClock() - GetProtocolU32(message.payload)), memory_order_relaxed);
+        return;
+    }
+
+    // Wait for the main thread to make room; it takes every message each frame, so this only waits if it stalls
+    uint32_t tail = client.queueTail.load(memory_order_relaxed);
+    while (tail - client.queueHead.load(memory_order_acquire) >= (uint32_t)NET_QUEUE_SIZE && !client.stopping) {
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+    NetMessage &slot = client.queue[tail % NET_QUEUE_SIZE];
+    slot.command = valid ? (uint8_t)message.command : (uint8_t)PROTOCOL_UNKNOWN;
+    slot.payloadLength = (uint8_t)message.payloadLength;
+    memcpy(slot.payload, message.payload, message.payloadLength);
+    client.queueTail.store(tail + 1, memory_order_release);
+}
+
+
+static void NetReader(NetClient *client, sockaddr_in address) {
+    TRACE_THREAD_NAME("Network reader");
+    if (ConnectSocket(*client, address)) {
+        SendToServer(*client, PROTOCOL_PLAY);  // Before `connected`, so it cannot interleave with the main thread's sends
+        client->connected = true;
+
+        // Messages are read where they arrived; only the start of one split across reads is moved to the front
+        uint8_t buffer[4096];
+        int length = 0;
+        while (true) {
+            int received = (int)recv(SocketOf(*client), (char *)buffer + length, sizeof(buffer) - length, 0);
+            if (received <= 0) {
+                snprintf(client->error, sizeof(client->error), "The server closed the connection");
+                break;
+            }
+            uint64_t busyStart = ProfilerNow();
+            length += received;
+            int offset = 0;
+            int messageLength;
+            while ((messageLength = FindProtocolMessage(buffer + offset, length - offset)) > 0) {
+                HandleServerData(*client, buffer + offset, messageLength);
+                offset += messageLength;
+            }
+            length -= offset;
+            memmove(buffer, buffer + offset, length);
+            ProfilerAddThreadBusy(PROFILE_THREAD_NETWORK, ProfilerNow() - busyStart);
+            if (messageLength < 0) {
+                snprintf(client->error, sizeof(client->error), "The server sent something that is not a message");
+                break;
+            }
+        }
+    }
+    client->closed.store(true, memory_order_release);
+}
+
+
+bool StartNetClient(NetClient &client, const string &host, int port, string &error) {
+#ifdef _WIN32
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+        error = "Could not start Windows sockets";
+        return false;
+    }
+#endif
+    client.host = host;
+    client.port = port;
+    client.status = NET_CONNECTING;
+    client.side = -1;
+    client.gameNumber = 0;
+    client.sentMoves = 0;
+    client.confirmedMoves = 0;
+    client.rejectedMoves = 0;
+    client.rollbacks = 0;
+    client.keptMoves = 0;
+    Bitboards initial;
+    InitialBitboards(initial);
+    ResetRollback(client.rollback, 0, initial);
+    client.resyncing = false;
+    client.resyncs = 0;
+    client.failure = nullptr;
+    client.nextPingAt = 0;
+    client.connected = false;
+    client.closed = false;
+    client.stopping = false;
+    client.latencyUs = -1;
+    client.queueHead = 0;
+    client.queueTail = 0;
+    client.error[0] = '\0';
+    client.socket = -1;
+
+    // Resolving is done here, so a bad host name is reported before the window opens
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *found = nullptr;
+    if (getaddrinfo(host.c_str(), nullptr, &hints, &found) != 0 || found == nullptr) {
+        error = "Unknown host " + host;
+        return false;
+    }
+    sockaddr_in address = *(const sockaddr_in *)found->ai_addr;
+    address.sin_port = htons((uint16_t)port);
+    freeaddrinfo(found);
+
+    NetSocket socket = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (socket == (NetSocket)-1) {
+        error = "Could not create a socket";
+        return false;
+    }
+    client.socket = (intptr_t)socket;
+    client.reader = thread(NetReader, &client, address);
+    return true;
+}
+
+
+// Drops the connection because the server broke the protocol; the reader sees the shutdown and stops.
+static void FailNetwork(NetClient &client, const char *failure) {
+    client.failure = failure;
+    client.status = NET_DISCONNECTED;
+    shutdown(SocketOf(client), SHUTDOWN_BOTH);
+}
+
+
+// Asks for the position when a turn from the server does not fit the board; turns are ignored until it comes.
+static void RequestResync(NetClient &client) {
+    if (client.resyncing) return;
+    client.resyncing = true;
+    client.resyncs++;
+    SendToServer(client, PROTOCOL_SYNC);
+}
+
+
+// Saves the position after each turn added to the move history since the last save, replayed from the
+// newest saved position.
+static void SaveNewTurns(NetClient &client, const GameState &gameState) {
+    uint32_t ply = client.rollback.last;
+    Bitboards pos;
+    if (ply > gameState.moveHistory.size() || !RestoreRollback(client.rollback, ply, pos)) {
+        // The ring no longer lines up with the history, so it is filled again from the start of the game
+        ply = 0;
+        pos = gameState.startPosition;
+        ResetRollback(client.rollback, 0, pos);
+    }
+    while (ply < gameState.moveHistory.size()) {
+        MakeMove(pos, gameState.moveHistory[ply]);
+        SaveRollback(client.rollback, ++ply, pos);
+    }
+}
+
+
+// Puts the board back to the last turn the server confirmed, whatever was played after it, and drops the
+// turns not confirmed. Returns false if the ring no longer holds that position.
+static bool RollBackToConfirmed(NetClient &client, GameState &gameState) {
+    uint32_t ply = (uint32_t)client.confirmedMoves;
+    Bitboards pos;
+    if (!RestoreRollback(client.rollback, ply, pos)) return false;
+    BitboardsToGameState(pos, gameState);
+    gameState.moveHistory.resize(ply);
+    gameState.redoMoves.clear();
+    client.rollback.last = ply;  // The turns after it are gone
+    client.keptMoves = min(client.keptMoves, (size_t)ply);
+    client.sentMoves = client.confirmedMoves;
+    client.rollbacks++;
+    return true;
+}
+
+
+// Plays a MOVE from the server: our own turn coming back, or the opponent's.
+static void HandleServerTurn(NetClient &client, GameState &gameState, const NetMessage &message) {
+    if (client.resyncing) return;
+
+    if (client.confirmedMoves < client.sentMoves) {
+        // Our own turn; it was shown when it was played, so only the bytes are compared
+        uint8_t expected[PROTOCOL_MAX_TURN];
+        int length = EncodeProtocolTurn(gameState.moveHistory[client.confirmedMoves], expected);
+        if (length == message.payloadLength && memcmp(expected, message.payload, length) == 0) {
+            client.confirmedMoves++;
+            return;
+        }
+        // The server played something else; it is applied below like any turn of the server's
+        if (!RollBackToConfirmed(client, gameState)) {
+            RequestResync(client);
+            return;
+        }
+    }
+
+    Bitboards pos;
+    Move move;
+    GameStateToBitboards(gameState, pos);
+    if (gameState.isCapturing || !DecodeProtocolTurn(pos, message.payload, message.payloadLength, move)) {
+        RequestResync(client);
+        return;
+    }
+    ApplyTurn(gameState, move);
+    SaveNewTurns(client, gameState);
+    client.sentMoves++;
+    client.confirmedMoves++;
+}
+
+
+// Applies one message from the server. Returns true if it replaced the game: a new game, or the position again.
+static bool HandleServerMessage(NetClient &client, GameState &gameState, const NetMessage &message) {
+    switch (message.command) {
+    case PROTOCOL_WAIT:
+        client.status = NET_WAITING;
+        return false;
+
+    case PROTOCOL_START: {
+        GameRecord record;
+        if (message.payload[4] > 1 || !DecodeProtocolPosition(message.payload + 5, record.start)) {
+            FailNetwork(client, "The server started a game that could not be read");
+            return false;
+        }
+        GameRecordToGameState(record, gameState);
+        ResetRollback(client.rollback, 0, record.start);
+        client.status = NET_PLAYING;
+        client.side = (message.payload[4] == 0) ? PLAYER1 : PLAYER2;
+        client.gameNumber = GetProtocolU32(message.payload);
+        client.sentMoves = 0;
+        client.confirmedMoves = 0;
+        client.resyncing = false;
+        return true;
+    }
+
+    case PROTOCOL_MOVE:
+        if (client.status != NET_PLAYING) {
+            FailNetwork(client, "The server sent a turn outside a game");
+        } else {
+            HandleServerTurn(client, gameState, message);
+        }
+        return false;
+
+    case PROTOCOL_POSITION: {
+        // The game goes on from the server's position; the turns before it are no longer known here
+        GameRecord record;
+        if (!client.resyncing || !DecodeProtocolPosition(message.payload + 2, record.start)) {
+            FailNetwork(client, "The server sent a position that could not be used");
+            return false;
+        }
+        GameRecordToGameState(record, gameState);
+        ResetRollback(client.rollback, 0, record.start);
+        client.sentMoves = 0;
+        client.confirmedMoves = 0;
+        client.resyncing = false;
+        return true;
+    }
+
+    case PROTOCOL_END: {
+        Player winner = (message.payload[0] == 0) ? PLAYER1 : PLAYER2;
+        if (!gameState.gameOver || gameState.winner != winner) {
+            gameState.gameOver = true;  // The opponent resigned or left
+            gameState.winner = winner;
+            gameState.revision++;
+        }
+        client.status = NET_GAME_OVER;
+        client.resyncing = false;
+        return false;
+    }
+
+    case PROTOCOL_ERROR:
+        // The server refused our last turn and still has the position from before it
+        if (client.sentMoves > client.confirmedMoves) {
+            client.rejectedMoves++;
+        }
+        if ((gameState.isCapturing || gameState.moveHistory.size() > client.confirmedMoves) && !RollBackToConfirmed(client, gameState)) {
+            RequestResync(client);
+        }
+        client.sentMoves = client.confirmedMoves;
+        return false;
+
+    default:
+        FailNetwork(client, "The server sent a message this game does not know");
+        return false;
+    }
+}
+
+
+bool UpdateNetworkGame(NetClient &client, GameState &gameState) {
+    client.keptMoves = gameState.moveHistory.size();
+    if (client.status == NET_DISCONNECTED) return false;
+
+    // Everything the reader has handed over; each slot is given back as soon as it has been applied
+    bool replaced = false;
+    uint32_t head = client.queueHead.load(memory_order_relaxed);
+    uint32_t tail = client.queueTail.load(memory_order_acquire);
+    while (head != tail && client.status != NET_DISCONNECTED) {
+        replaced = HandleServerMessage(client, gameState, client.queue[head % NET_QUEUE_SIZE]) || replaced;
+        client.queueHead.store(++head, memory_order_release);
+    }
+    if (client.status == NET_DISCONNECTED) return replaced;
+    if (client.closed.load(memory_order_acquire) && head == client.queueTail.load(memory_order_acquire)) {
+        client.status = NET_DISCONNECTED;
+        return replaced;
+    }
+
+    // Turns finished with the mouse since the last frame
+    if (client.status == NET_PLAYING) {
+        SaveNewTurns(client, gameState);
+        while (client.sentMoves < gameState.moveHistory.size() && !client.resyncing) {
+            uint8_t turn[PROTOCOL_MAX_TURN];
+            int length = EncodeProtocolTurn(gameState.moveHistory[client.sentMoves], turn);
+            SendToServer(client, PROTOCOL_MOVE, turn, length);
+            client.sentMoves++;
+        }
+    }
+
+    // The token is the send time, so the reader can work out the round trip without any shared state
+    uint64_t now = ProfilerNow();
+    if (client.connected && now >= client.nextPingAt) {
+        uint8_t token[4];
+        PutProtocolU32(token, PingClock());
+        SendToServer(client, PROTOCOL_PING, token, sizeof(token));
+        client.nextPingAt = now + (uint64_t)NET_PING_INTERVAL_MS * 1000000;
+    }
+    return replaced;
+}
+
+
+bool NetworkMayMove(const NetClient &client, const GameState &gameState) {
+    return client.status == NET_PLAYING && !client.resyncing && !gameState.gameOver && gameState.currentPlayer == client.side;
+}
+
+
+void RequestNetworkGame(NetClient &client) {
+    if (client.status == NET_GAME_OVER) {
+        SendToServer(client, PROTOCOL_PLAY);
+        client.status = NET_WAITING;
+    }
+}
+
+
+void CloseNetClient(NetClient &client) {
+    if (!client.reader.joinable()) return;
+    client.stopping = true;
+    if (client.status == NET_PLAYING) {
+        SendToServer(client, PROTOCOL_QUIT);
+    }
+    shutdown(SocketOf(client), SHUTDOWN_BOTH);
+    client.reader.join();
+    CloseSocket(SocketOf(client));
+    client.socket = -1;
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
+
+
+// Drawn straight to the screen every frame, like the profiler overlay, so the scene cache is not redrawn
+// for every latency update. Text is formatted into stack buffers, so nothing is allocated.
+void DrawNetworkPanel(const RenderBackend &backend, const NetClient &client, const GameState &gameState) {
+    int x = BOARD_WIDTH + 15;
+    int y = NET_PANEL_Y;
+    char text[64];
+
+    // The save, load and undo hints underneath do not apply to an online game
+    backend.drawRectangle(backend.context, BOARD_WIDTH, NET_PANEL_Y, INFO_PANEL_WIDTH, PROFILER_OVERLAY_Y - NET_PANEL_Y, LIGHT_SQUARE_COLOR);
+
+    if (client.side >= 0) {
+        snprintf(text, sizeof(text), "Online as %s", (client.side == PLAYER1) ? "Player1" : "Player2");
+    } else {
+        snprintf(text, sizeof(text), "Online");
+    }
+    backend.drawText(backend.context, text, x, y, 22, NET_TEXT_COLOR);
+
+    const char *status = "";
+    switch (client.status) {
+    case NET_CONNECTING: status = "Connecting..."; break;
+    case NET_WAITING: status = "Waiting for opponent"; break;
+    case NET_PLAYING:
+        status = gameState.gameOver ? "Game over" : (gameState.currentPlayer == client.side) ? "Your turn" : "Opponent's turn";
+        break;
+    case NET_GAME_OVER: status = "New game 'R'"; break;
+    case NET_DISCONNECTED: status = "Disconnected"; break;
+    }
+    backend.drawText(backend.context, status, x, y + 30, 20, (client.status == NET_DISCONNECTED) ? NET_ERROR_COLOR : NET_STATUS_COLOR);
+
+    if (client.status == NET_DISCONNECTED) {
+        backend.drawText(backend.context, (client.failure != nullptr) ? client.failure : client.error, x, y + 56, 10, NET_ERROR_COLOR);
+    } else {
+        int32_t latencyUs = client.latencyUs.load(memory_order_relaxed);
+        if (latencyUs >= 0) {
+            snprintf(text, sizeof(text), "Latency: %.1f ms", latencyUs / 1000.0);
+        } else {
+            snprintf(text, sizeof(text), "Latency: -");
+        }
+        backend.drawText(backend.context, text, x, y + 56, 20, NET_STATUS_COLOR);
+    }
+    backend.drawText(backend.context, "Profiler 'P'", x, 370, 22, NET_STATUS_COLOR);
+}
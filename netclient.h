@@ -0,0 +1,88 @@
+// @file netclient.h
+// @brief Network play: connects the game to a game server (tools/gameserver, protocol.h) without ever
+// blocking the render loop.
+//
+// A reader thread connects, sends PLAY and then sits in a blocking recv. Every complete message it receives
+// is copied into a fixed ring of messages shared with the main thread, which the reader only ever
+// appends to and the main thread only ever takes from, so each side advances its own atomic index and
+// neither takes a lock. The main thread sends its few short messages itself. PONG never goes through the
+// ring: the reader works out the round trip the moment it arrives, so the latency shown does not include
+// the time the message would have waited for the next frame.
+//
+// Turns are played optimistically: a turn completed with the mouse is shown at once and sent, and the
+// server's copy confirms it. The position after every turn is kept in a rollback ring (rollback.h), so if the
+// server rejects a turn, or confirms a different one, the board goes straight back to the last confirmed
+// position in constant time and continues from the server's turns. Only if a turn from the server does not fit
+// the board does the client ask for the position (SYNC) and continue from there.
+
+#ifndef NETCLIENT_H
+#define NETCLIENT_H
+
+#include "gamestate.h"
+#include "protocol.h"
+#include "render.h"
+#include "rollback.h"
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+const int NET_QUEUE_SIZE = 64;              // Messages the reader can hand over before the main thread takes them (a power of two)
+const int NET_PING_INTERVAL_MS = 1000;      // Time between latency measurements
+const int NET_CONNECT_TIMEOUT_MS = 5000;    // Longest wait for the server to accept the connection
+const int NET_PANEL_Y = 280;                // Top of the network status in the info panel, in place of the key hints
+
+enum NetStatus {
+    NET_CONNECTING,     // The reader is still connecting
+    NET_WAITING,        // Asked for a game, waiting for an opponent
+    NET_PLAYING,
+    NET_GAME_OVER,      // The last game ended; R asks for another
+    NET_DISCONNECTED    // The connection failed or was closed, see NetClient::error
+};
+
+// One message from the server, copied out of the receive buffer by the reader thread.
+struct NetMessage {
+    uint8_t command;                        // ProtocolCommand
+    uint8_t payloadLength;
+    uint8_t payload[PROTOCOL_MAX_PAYLOAD];
+};
+
+struct NetClient {
+    // Shared with the reader thread
+    intptr_t socket;                    // SOCKET on Windows, a file descriptor elsewhere
+    std::thread reader;
+    std::atomic<bool> connected;        // Set by the reader once the connection is up
+    std::atomic<bool> closed;           // Set by the reader when the connection ends
+    std::atomic<bool> stopping;         // Set by CloseNetClient
+    std::atomic<int32_t> latencyUs;     // Last PING round trip in microseconds, -1 before the first
+    std::atomic<uint32_t> queueHead;    // Next message the main thread takes
+    std::atomic<uint32_t> queueTail;    // Next slot the reader fills
+    NetMessage queue[NET_QUEUE_SIZE];
+    char error[96];                     // Why the reader stopped (written before `closed` is set)
+
+    // Main thread only
+    std::string host;
+    int port;
+    NetStatus status;
+    int side;                           // Our seat in the current game (PLAYER1 or PLAYER2), -1 before START
+    uint32_t gameNumber;
+    size_t sentMoves;                   // Turns of moveHistory sent to the server
+    size_t confirmedMoves;              // Turns of moveHistory the server has confirmed
+    int rejectedMoves;                  // Turns the server refused, which were taken back
+    int rollbacks;                      // Times the board went back to the last confirmed turn
+    size_t keptMoves;                   // Turns of moveHistory the last UpdateNetworkGame did not take back; a record of the game keeps these and drops the rest
+    RollbackRing rollback;              // Positions after the recent turns of moveHistory
+    bool resyncing;                     // SYNC sent; turns are ignored until the POSITION answer
+    int resyncs;                        // Times the position had to be fetched again
+    const char *failure;                // Why this side dropped the connection, or nullptr
+    uint64_t nextPingAt;                // ProfilerNow() time of the next PING
+};
+
+bool StartNetClient(NetClient &client, const std::string &host, int port, std::string &error); // Resolves host and starts the reader thread, which connects and asks for a game.
+bool UpdateNetworkGame(NetClient &client, GameState &gameState); // Applies the server's messages, sends the turns completed since the last call and pings. Returns true when the move history was replaced: a new game started, or the position was fetched again.
+bool NetworkMayMove(const NetClient &client, const GameState &gameState); // True if clicks on the board may play a turn now.
+void RequestNetworkGame(NetClient &client); // Asks for another game after the last one ended.
+void CloseNetClient(NetClient &client); // Leaves any game, closes the connection and waits for the reader.
+void DrawNetworkPanel(const RenderBackend &backend, const NetClient &client, const GameState &gameState); // Status and latency, over the key hints.
+
+#endif
@@ -0,0 +1,426 @@
+// @file pdn.cpp
+// @brief Portable Draughts Notation (PDN) export and a streaming PDN reader.
+
+#include "pdn.h"
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+
+using namespace std;
+
+const int PDN_LINE_WIDTH = 79;          // Move text is wrapped before this column
+
+// ---------------------------------------------------------------------------------------------
+// Writing
+// ---------------------------------------------------------------------------------------------
+
+const char *PdnResultString(PdnResult result) {
+    switch (result) {
+        case PDN_RESULT_PLAYER1: return "0-1";
+        case PDN_RESULT_PLAYER2: return "1-0";
+        case PDN_RESULT_DRAW: return "1/2-1/2";
+        default: return "*";
+    }
+}
+
+
+string FormatPdnMove(const Move &move) {
+    string text = to_string(move.from + 1);
+    char separator = move.captured ? 'x' : '-';
+    for (int i = 0; i < move.length; i++) {
+        text += separator;
+        text += to_string(move.path[i] + 1);
+    }
+    return text;
+}
+
+
+static void AppendFenSide(string &fen, char colour, uint32_t pieces, uint32_t kings) {
+    fen += ':';
+    fen += colour;
+    bool first = true;
+    for (uint32_t remaining = pieces; remaining != 0; remaining &= remaining - 1) {
+        int square = __builtin_ctz(remaining);
+        if (!first) fen += ',';
+        if (kings & SquareBit(square)) fen += 'K';
+        fen += to_string(square + 1);
+        first = false;
+    }
+}
+
+
+string FormatPdnFen(const Bitboards &pos) {
+    string fen(1, pos.sideToMove == 0 ? 'B' : 'W');
+    AppendFenSide(fen, 'W', pos.pieces[1], pos.kings);
+    AppendFenSide(fen, 'B', pos.pieces[0], pos.kings);
+    return fen;
+}
+
+
+static void WriteTag(ostream &out, const string &name, const string &value) {
+    out << '[' << name << " \"";
+    for (size_t i = 0; i < value.size(); i++) {
+        if (value[i] == '"' || value[i] == '\\') out << '\\';
+        out << value[i];
+    }
+    out << "\"]\n";
+}
+
+
+void WritePdnGame(ostream &out, const GameRecord &record, PdnResult result, const PdnTags &tags) {
+    for (size_t i = 0; i < tags.size(); i++) {
+        if (tags[i].first != "Result" && tags[i].first != "FEN" && tags[i].first != "SetUp") {
+            WriteTag(out, tags[i].first, tags[i].second);
+        }
+    }
+    WriteTag(out, "Result", PdnResultString(result));
+
+    Bitboards initial;
+    InitialBitboards(initial);
+    if (memcmp(&record.start, &initial, sizeof(Bitboards)) != 0) {
+        WriteTag(out, "SetUp", "1");
+        WriteTag(out, "FEN", FormatPdnFen(record.start));
+    }
+    out << '\n';
+
+    // Move text, numbered on PLAYER1's turns and wrapped to a fixed width
+    string line;
+    uint32_t side = record.start.sideToMove;
+    int moveNumber = 1;
+    for (size_t i = 0; i < record.moves.size(); i++) {
+        string token;
+        if (side == 0) {
+            token = to_string(moveNumber) + ". ";
+        } else if (i == 0) {
+            token = to_string(moveNumber) + "... ";
+        }
+        token += FormatPdnMove(record.moves[i]);
+
+        if (!line.empty() && line.size() + 1 + token.size() > (size_t)PDN_LINE_WIDTH) {
+            out << line << '\n';
+            line.clear();
+        }
+        if (!line.empty()) line += ' ';
+        line += token;
+
+        if (side == 1) moveNumber++;
+        side ^= 1;
+    }
+
+    string resultText = PdnResultString(result);
+    if (!line.empty() && line.size() + 1 + resultText.size() > (size_t)PDN_LINE_WIDTH) {
+        out << line << '\n';
+        line.clear();
+    }
+    if (!line.empty()) line += ' ';
+    out << line << resultText << "\n\n";
+}
+
+
+// ---------------------------------------------------------------------------------------------
+// Reading
+// ---------------------------------------------------------------------------------------------
+
+// Reads a square list such as "1,2,K3" or "1-12" into pieces/kings. Returns false on a malformed list.
+static bool ParseFenSquares(const string &text, uint32_t &pieces, uint32_t &kings) {
+    size_t pos = 0;
+    while (pos < text.size()) {
+        bool king = false;
+        if (text[pos] == 'K') {
+            king = true;
+            pos++;
+        }
+        if (pos >= text.size() || !isdigit((unsigned char)text[pos])) return false;
+        int first = atoi(text.c_str() + pos);
+        while (pos < text.size() && isdigit((unsigned char)text[pos])) pos++;
+        int last = first;
+        if (pos < text.size() && text[pos] == '-') {
+            pos++;
+            if (pos >= text.size() || !isdigit((unsigned char)text[pos])) return false;
+            last = atoi(text.c_str() + pos);
+            while (pos < text.size() && isdigit((unsigned char)text[pos])) pos++;
+        }
+        if (first < 1 || last > BOARD_SQUARES || first > last) return false;
+
+        for (int square = first; square <= last; square++) {
+            pieces |= SquareBit(square - 1);
+            if (king) kings |= SquareBit(square - 1);
+        }
+        if (pos < text.size() && text[pos] == ',') pos++;
+        else if (pos < text.size() && text[pos] != '.') return false;
+        else if (pos < text.size()) pos = text.size(); // Trailing "." ends the FEN
+    }
+    return true;
+}
+
+
+bool ParsePdnFen(const string &fen, Bitboards &pos) {
+    if (fen.empty() || (fen[0] != 'B' && fen[0] != 'W')) return false;
+
+    pos.pieces[0] = 0;
+    pos.pieces[1] = 0;
+    pos.kings = 0;
+    pos.sideToMove = (fen[0] == 'B') ? 0 : 1;
+
+    size_t start = 1;
+    while (start < fen.size()) {
+        if (fen[start] != ':') return false;
+        size_t end = fen.find(':', start + 1);
+        if (end == string::npos) end = fen.size();
+        if (end == start + 1) return false;
+
+        char colour = fen[start + 1];
+        if (colour != 'B' && colour != 'W') return false;
+        if (!ParseFenSquares(fen.substr(start + 2, end - start - 2), pos.pieces[colour == 'B' ? 0 : 1], pos.kings)) {
+            return false;
+        }
+        start = end;
+    }
+    return IsValidPosition(pos);
+}
+
+
+void InitPdnReader(PdnReader &reader, istream &input) {
+    reader.input = &input;
+    reader.bufferLength = 0;
+    reader.bufferPos = 0;
+    reader.line = 1;
+    reader.gameLine = 1;
+    reader.error.clear();
+}
+
+
+static int PeekChar(PdnReader &reader) {
+    if (reader.bufferPos >= reader.bufferLength) {
+        reader.input->read(reader.buffer, PDN_BUFFER_SIZE);
+        reader.bufferLength = (int)reader.input->gcount();
+        reader.bufferPos = 0;
+        if (reader.bufferLength <= 0) return EOF;
+    }
+    return (unsigned char)reader.buffer[reader.bufferPos];
+}
+
+
+static int NextChar(PdnReader &reader) {
+    int c = PeekChar(reader);
+    if (c != EOF) {
+        reader.bufferPos++;
+        if (c == '\n') reader.line++;
+    }
+    return c;
+}
+
+
+static void SkipUntil(PdnReader &reader, char stop) {
+    int c;
+    do {
+        c = NextChar(reader);
+    } while (c != EOF && c != stop);
+}
+
+
+static void SkipVariation(PdnReader &reader) {
+    int depth = 0;
+    int c;
+    while ((c = NextChar(reader)) != EOF) {
+        if (c == '(') depth++;
+        else if (c == '{') SkipUntil(reader, '}');
+        else if (c == ')' && --depth == 0) return;
+    }
+}
+
+
+static bool IsDelimiter(int c) {
+    return c == EOF || isspace(c) || c == '[' || c == ']' || c == '{' || c == '}' || c == '(' || c == ')' || c == ';';
+}
+
+
+// Reads '[Name "Value"]'. Returns false on a malformed tag.
+static bool ReadTag(PdnReader &reader, string &name, string &value) {
+    name.clear();
+    value.clear();
+    NextChar(reader); // '['
+
+    int c;
+    while ((c = PeekChar(reader)) != EOF && isspace(c)) NextChar(reader);
+    while ((c = PeekChar(reader)) != EOF && !isspace(c) && c != '"' && c != ']') {
+        if (name.size() < (size_t)PDN_MAX_TOKEN) name += (char)c;
+        NextChar(reader);
+    }
+    while ((c = PeekChar(reader)) != EOF && isspace(c)) NextChar(reader);
+    if (NextChar(reader) != '"') {
+        SkipUntil(reader, ']');
+        return false;
+    }
+    while ((c = NextChar(reader)) != EOF && c != '"') {
+        if (c == '\\') c = NextChar(reader);
+        if (c == EOF) return false;
+        if (value.size() < (size_t)PDN_MAX_TOKEN) value += (char)c;
+    }
+    SkipUntil(reader, ']');
+    return !name.empty();
+}
+
+
+static bool ParseResultToken(const string &token, PdnResult &result) {
+    if (token == "0-1" || token == "0-2") result = PDN_RESULT_PLAYER1;
+    else if (token == "1-0" || token == "2-0") result = PDN_RESULT_PLAYER2;
+    else if (token == "1/2-1/2" || token == "1-1") result = PDN_RESULT_DRAW;
+    else if (token == "*" || token == "0-0") result = PDN_RESULT_UNKNOWN;
+    else return false;
+    return true;
+}
+
+
+// Finds the legal turn written as `token` in pos. Captures may list every landing square or only the last one.
+bool MatchPdnMove(const Bitboards &pos, const string &token, Move &move, string &error) {
+    int squares[MAX_CAPTURES + 1];
+    int count = 0;
+    size_t i = 0;
+    while (i < token.size()) {
+        if (!isdigit((unsigned char)token[i]) || count > MAX_CAPTURES) {
+            error = "malformed move '" + token + "'";
+            return false;
+        }
+        int square = atoi(token.c_str() + i);
+        while (i < token.size() && isdigit((unsigned char)token[i])) i++;
+        if (square < 1 || square > BOARD_SQUARES) {
+            error = "square out of range in '" + token + "'";
+            return false;
+        }
+        squares[count++] = square - 1;
+        if (i < token.size()) {
+            if (token[i] != '-' && token[i] != 'x' && token[i] != 'X' && token[i] != ':') {
+                error = "malformed move '" + token + "'";
+                return false;
+            }
+            i++;
+        }
+    }
+    if (count < 2) {
+        error = "malformed move '" + token + "'";
+        return false;
+    }
+
+    MoveList list;
+    GenerateMoves(pos, list);
+    const Move *shortMatch = nullptr;
+    int shortMatches = 0;
+    for (int m = 0; m < list.count; m++) {
+        const Move &candidate = list.moves[m];
+        if (candidate.from != squares[0]) continue;
+
+        bool exact = candidate.length == count - 1;
+        for (int step = 0; exact && step < candidate.length; step++) {
+            exact = candidate.path[step] == squares[step + 1];
+        }
+        if (exact) {
+            move = candidate;
+            return true;
+        }
+        if (count == 2 && candidate.to == squares[1]) {
+            shortMatch = &candidate;
+            shortMatches++;
+        }
+    }
+
+    if (shortMatches == 1) {
+        move = *shortMatch;
+        return true;
+    }
+    error = (shortMatches > 1) ? "ambiguous move '" + token + "'" : "illegal move '" + token + "'";
+    return false;
+}
+
+
+PdnStatus ReadPdnGame(PdnReader &reader, PdnGame &game) {
+    game.tags.clear();
+    InitialBitboards(game.record.start);
+    game.record.moves.clear();
+    game.result = PDN_RESULT_UNKNOWN;
+    game.finalPos = game.record.start;
+    reader.error.clear();
+
+    bool started = false;       // Anything belonging to this game has been read
+    bool inMoveText = false;    // A tag now would start the next game
+    bool invalid = false;
+    string token;
+    token.reserve(PDN_MAX_TOKEN);
+
+    while (true) {
+        int c = PeekChar(reader);
+        if (c == EOF) break;
+
+        if (isspace(c)) {
+            NextChar(reader);
+        } else if (c == '[') {
+            if (inMoveText) break;  // Next game's tags; this game ended without a result
+            if (!started) reader.gameLine = reader.line;
+            started = true;
+
+            string name, value;
+            if (!ReadTag(reader, name, value)) {
+                if (!invalid) reader.error = "malformed tag";
+                invalid = true;
+                continue;
+            }
+            if (name == "FEN" && !invalid) {
+                if (!ParsePdnFen(value, game.record.start)) {
+                    reader.error = "invalid FEN '" + value + "'";
+                    invalid = true;
+                }
+                game.finalPos = game.record.start;
+            }
+            game.tags.push_back(make_pair(name, value));
+        } else if (c == '{') {
+            SkipUntil(reader, '}');
+        } else if (c == '(') {
+            SkipVariation(reader);
+        } else if (c == ';' || c == '%') {
+            SkipUntil(reader, '\n');
+        } else {
+            token.clear();
+            while (!IsDelimiter(PeekChar(reader))) {
+                int next = NextChar(reader);
+                if (token.size() < (size_t)PDN_MAX_TOKEN) token += (char)next;
+            }
+            if (token.empty()) {
+                NextChar(reader); // Stray ']', '}' or ')'
+                continue;
+            }
+            if (!started) reader.gameLine = reader.line;
+            started = true;
+            inMoveText = true;
+
+            if (ParseResultToken(token, game.result)) {
+                break;
+            }
+            if (token[0] == '$') continue; // Numeric annotation glyph
+
+            // Drop a move number prefix ("12." or "12...") and trailing annotations ("!", "?")
+            size_t begin = 0;
+            while (begin < token.size() && isdigit((unsigned char)token[begin])) begin++;
+            if (begin < token.size() && token[begin] == '.') {
+                while (begin < token.size() && token[begin] == '.') begin++;
+            } else {
+                begin = 0;
+            }
+            size_t end = token.size();
+            while (end > begin && (token[end - 1] == '!' || token[end - 1] == '?')) end--;
+            if (end == begin || invalid) continue;
+
+            Move move;
+            string error;
+            if (MatchPdnMove(game.finalPos, token.substr(begin, end - begin), move, error)) {
+                game.record.moves.push_back(move);
+                MakeMove(game.finalPos, move);
+            } else {
+                reader.error = error + " at turn " + to_string(game.record.moves.size() + 1);
+                invalid = true;
+            }
+        }
+    }
+
+    if (!started) return PDN_END;
+    return invalid ? PDN_GAME_INVALID : PDN_GAME_OK;
+}
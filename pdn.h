@@ -0,0 +1,61 @@
+// @file pdn.h
+// @brief Portable Draughts Notation (PDN) export and a streaming PDN reader.
+//
+// Squares are numbered 1-32 row by row from PLAYER1's side (square = bit index + 1), as in English
+// draughts. PLAYER1 moves first and is written as "Black", PLAYER2 as "White"; a "0-1" result is a
+// PLAYER1 win. Plain moves are written "11-15" and captures list every landing square: "15x24x31".
+
+#ifndef PDN_H
+#define PDN_H
+
+#include "savefile.h"
+#include <istream>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+const int PDN_BUFFER_SIZE = 64 * 1024;  // Bytes read from the stream at a time
+const int PDN_MAX_TOKEN = 256;          // Longer tokens (and tag values) are cut to this length
+
+enum PdnResult { PDN_RESULT_UNKNOWN, PDN_RESULT_PLAYER1, PDN_RESULT_PLAYER2, PDN_RESULT_DRAW };
+
+enum PdnStatus {
+    PDN_GAME_OK,        // A valid game was read
+    PDN_GAME_INVALID,   // A game was read but breaks the rules or the syntax; see PdnReader::error
+    PDN_END             // No more games
+};
+
+typedef std::vector<std::pair<std::string, std::string> > PdnTags;
+
+// One game as read from a PDN file.
+struct PdnGame {
+    PdnTags tags;           // Every tag pair in file order
+    GameRecord record;      // Start position and validated turns
+    Bitboards finalPos;     // Position after the last turn
+    PdnResult result;       // Result given in the move text
+};
+
+// Streaming reader state. Memory use is one read buffer plus the game being read.
+struct PdnReader {
+    std::istream *input;
+    char buffer[PDN_BUFFER_SIZE];
+    int bufferLength;
+    int bufferPos;
+    long long line;         // Current line (1-based), for error messages
+    long long gameLine;     // Line where the game being read started
+    std::string error;      // Why the last game was invalid
+};
+
+void InitPdnReader(PdnReader &reader, std::istream &input);
+PdnStatus ReadPdnGame(PdnReader &reader, PdnGame &game); // Reads the next game; invalid games are skipped up to their result.
+
+bool ParsePdnFen(const std::string &fen, Bitboards &pos); // Parses a FEN tag such as "B:W21,22,K30:B1,2".
+std::string FormatPdnFen(const Bitboards &pos);
+std::string FormatPdnMove(const Move &move); // "11-15" or "15x24x31"
+bool MatchPdnMove(const Bitboards &pos, const std::string &token, Move &move, std::string &error); // Finds the legal turn written as token.
+const char *PdnResultString(PdnResult result);
+
+void WritePdnGame(std::ostream &out, const GameRecord &record, PdnResult result, const PdnTags &tags); // Writes tags, FEN for custom starts and the move text.
+
+#endif
@@ -0,0 +1,189 @@
+// @file profiler.cpp
+// @brief Frame profiler: sliding window of per-phase frame timings and the profiler overlay.
+
+#include "profiler.h"
+#include "trace.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+
+using namespace std;
+
+const float FRAME_HISTOGRAM_LIMITS_MS[FRAME_HISTOGRAM_BUCKETS - 1] = { 4.0f, 8.0f, 12.0f, 17.0f, 20.0f, 33.0f, 50.0f };
+
+const char *const PHASE_NAMES[PHASE_COUNT] = { "Input", " game over", "Animation", "Draw", "EndDrawing" };
+const char *const THREAD_NAMES[PROFILE_THREAD_COUNT] = { "AI thread", "Journal thread", "Network thread" };
+const RenderColor OVERLAY_TEXT_COLOR = {0, 0, 0, 255};
+const RenderColor OVERLAY_BAR_COLOR = {0, 121, 241, 255};
+const RenderColor OVERLAY_SLOW_BAR_COLOR = {230, 41, 55, 255};   // Buckets slower than one frame at 60 FPS, and phases over budget
+
+// Busy time reported by each worker thread since the program started
+static atomic<uint64_t> threadBusyTotal[PROFILE_THREAD_COUNT];
+
+// The window: one slot per frame, written by the main thread only
+static uint32_t phaseTimes[PHASE_COUNT][PROFILE_WINDOW];
+static uint32_t frameTimes[PROFILE_WINDOW];                     // 0 for frames that started after an idle wait
+static uint64_t frameStarts[PROFILE_WINDOW];
+static uint64_t threadBusyAtStart[PROFILE_THREAD_COUNT][PROFILE_WINDOW];
+static int nextFrame = 0;      // Slot of the frame in progress
+static int framesStored = 0;   // Completed frames in the window
+static uint64_t lastFrameStart = 0;
+
+
+uint64_t ProfilerNow() {
+    return (uint64_t)chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+void ProfilerBeginFrame(bool afterIdleWait) {
+    uint64_t now = ProfilerNow();
+    uint64_t interval = (lastFrameStart == 0 || afterIdleWait) ? 0 : now - lastFrameStart;
+    lastFrameStart = now;
+
+    for (int phase = 0; phase < PHASE_COUNT; phase++) {
+        phaseTimes[phase][nextFrame] = 0;
+    }
+    frameTimes[nextFrame] = (uint32_t)min<uint64_t>(interval, UINT32_MAX);
+    frameStarts[nextFrame] = now;
+    for (int thread = 0; thread < PROFILE_THREAD_COUNT; thread++) {
+        threadBusyAtStart[thread][nextFrame] = threadBusyTotal[thread].load(memory_order_relaxed);
+    }
+}
+
+
+// With tracing compiled in, every phase and frame is also a trace event.
+void ProfilerAddPhase(ProfilePhase phase, uint64_t startTime) {
+    uint64_t now = ProfilerNow();
+    uint64_t total = phaseTimes[phase][nextFrame] + (now - startTime);
+    phaseTimes[phase][nextFrame] = (uint32_t)min<uint64_t>(total, UINT32_MAX);
+    TRACE_EVENT(PHASE_NAMES[phase], startTime, now);
+}
+
+
+void ProfilerEndFrame() {
+    TRACE_EVENT("Frame", frameStarts[nextFrame], ProfilerNow());
+    nextFrame = (nextFrame + 1) % PROFILE_WINDOW;
+    framesStored = min(framesStored + 1, PROFILE_WINDOW);
+}
+
+
+void ProfilerAddThreadBusy(ProfileThread thread, uint64_t nanoseconds) {
+    threadBusyTotal[thread].fetch_add(nanoseconds, memory_order_relaxed);
+}
+
+
+// Min, mean and 99th percentile of `count` samples in nanoseconds. Reorders the samples.
+static PhaseSummary Summarise(uint32_t *samples, int count) {
+    PhaseSummary summary = { 0.0f, 0.0f, 0.0f };
+    if (count == 0) return summary;
+
+    uint64_t sum = 0;
+    uint32_t minimum = samples[0];
+    for (int i = 0; i < count; i++) {
+        sum += samples[i];
+        minimum = min(minimum, samples[i]);
+    }
+    int p99 = (count - 1) * 99 / 100;
+    nth_element(samples, samples + p99, samples + count);
+
+    summary.minMs = minimum / 1e6f;
+    summary.avgMs = (float)(sum / (double)count / 1e6);
+    summary.p99Ms = samples[p99] / 1e6f;
+    return summary;
+}
+
+
+void GetProfilerReport(ProfilerReport &report) {
+    uint32_t samples[PROFILE_WINDOW];
+    int oldest = (nextFrame - framesStored + PROFILE_WINDOW) % PROFILE_WINDOW;
+    report.frames = framesStored;
+
+    for (int phase = 0; phase < PHASE_COUNT; phase++) {
+        for (int i = 0; i < framesStored; i++) {
+            samples[i] = phaseTimes[phase][(oldest + i) % PROFILE_WINDOW];
+        }
+        report.phases[phase] = Summarise(samples, framesStored);
+    }
+
+    int counted = 0;
+    report.idleWakeups = 0;
+    fill(report.histogram, report.histogram + FRAME_HISTOGRAM_BUCKETS, 0);
+    for (int i = 0; i < framesStored; i++) {
+        uint32_t frameTime = frameTimes[(oldest + i) % PROFILE_WINDOW];
+        if (frameTime == 0) {
+            report.idleWakeups++;
+            continue;
+        }
+        int bucket = 0;
+        while (bucket < FRAME_HISTOGRAM_BUCKETS - 1 && frameTime / 1e6f >= FRAME_HISTOGRAM_LIMITS_MS[bucket]) bucket++;
+        report.histogram[bucket]++;
+        samples[counted++] = frameTime;
+    }
+    report.frameTime = Summarise(samples, counted);
+
+    // Busy time over the wall time since the oldest frame in the window started
+    uint64_t now = ProfilerNow();
+    for (int thread = 0; thread < PROFILE_THREAD_COUNT; thread++) {
+        uint64_t busyNow = threadBusyTotal[thread].load(memory_order_relaxed);
+        uint64_t elapsed = (framesStored > 0) ? now - frameStarts[oldest] : 0;
+        uint64_t busy = (framesStored > 0) ? busyNow - threadBusyAtStart[thread][oldest] : 0;
+        report.threadBusy[thread] = (elapsed > 0) ? min(1.0f, (float)((double)busy / elapsed)) : 0.0f;
+        report.threadSeen[thread] = busyNow > 0;
+    }
+}
+
+
+// Everything is formatted into a stack buffer, so drawing the overlay does not allocate either.
+void DrawProfilerOverlay(const RenderBackend &backend, const ProfilerReport &report) {
+    int x = BOARD_WIDTH + 15;
+    int y = PROFILER_OVERLAY_Y;
+    char text[64];
+
+    snprintf(text, sizeof(text), "%-11s %6s %6s %6s", "ms", "min", "avg", "p99");
+    backend.drawText(backend.context, text, x, y, 10, OVERLAY_TEXT_COLOR);
+    for (int phase = 0; phase < PHASE_COUNT; phase++) {
+        const PhaseSummary &summary = report.phases[phase];
+        y += 12;
+        bool overBudget = phase == PHASE_ANIMATION && summary.p99Ms > ANIMATION_BUDGET_MS;
+        snprintf(text, sizeof(text), "%-11s %6.2f %6.2f %6.2f", PHASE_NAMES[phase], summary.minMs, summary.avgMs, summary.p99Ms);
+        backend.drawText(backend.context, text, x, y, 10, overBudget ? OVERLAY_SLOW_BAR_COLOR : OVERLAY_TEXT_COLOR);
+    }
+    y += 12;
+    snprintf(text, sizeof(text), "%-11s %6.2f %6.2f %6.2f", "Frame", report.frameTime.minMs, report.frameTime.avgMs, report.frameTime.p99Ms);
+    backend.drawText(backend.context, text, x, y, 10, OVERLAY_TEXT_COLOR);
+
+    // Histogram: one bar per bucket, scaled to the fullest bucket
+    const int barWidth = 24;
+    const int barHeight = 50;
+    int fullest = 1;
+    for (int bucket = 0; bucket < FRAME_HISTOGRAM_BUCKETS; bucket++) {
+        fullest = max(fullest, report.histogram[bucket]);
+    }
+    y += 16 + barHeight;
+    for (int bucket = 0; bucket < FRAME_HISTOGRAM_BUCKETS; bucket++) {
+        int height = report.histogram[bucket] * barHeight / fullest;
+        bool slow = bucket > 0 && FRAME_HISTOGRAM_LIMITS_MS[bucket - 1] >= 17.0f;
+        backend.drawRectangle(backend.context, x + bucket * (barWidth + 2), y - height, barWidth, height,
+                              slow ? OVERLAY_SLOW_BAR_COLOR : OVERLAY_BAR_COLOR);
+        if (bucket < FRAME_HISTOGRAM_BUCKETS - 1) {
+            snprintf(text, sizeof(text), "%d", (int)FRAME_HISTOGRAM_LIMITS_MS[bucket]);
+        } else {
+            snprintf(text, sizeof(text), "+");
+        }
+        backend.drawText(backend.context, text, x + bucket * (barWidth + 2) + 6, y + 2, 10, OVERLAY_TEXT_COLOR);
+    }
+
+    y += 16;
+    snprintf(text, sizeof(text), "%d frames, %d after idle", report.frames, report.idleWakeups);
+    backend.drawText(backend.context, text, x, y, 10, OVERLAY_TEXT_COLOR);
+    for (int thread = 0; thread < PROFILE_THREAD_COUNT; thread++) {
+        y += 12;
+        if (report.threadSeen[thread]) {
+            snprintf(text, sizeof(text), "%s: %.1f%% busy", THREAD_NAMES[thread], report.threadBusy[thread] * 100.0f);
+        } else {
+            snprintf(text, sizeof(text), "%s: not running", THREAD_NAMES[thread]);
+        }
+        backend.drawText(backend.context, text, x, y, 10, OVERLAY_TEXT_COLOR);
+    }
+}
@@ -0,0 +1,63 @@
+// @file profiler.h
+// @brief Frame profiler: per-phase CPU time of the main loop over a sliding window of frames, a frame time
+// histogram and the utilisation of the worker threads, drawn as an overlay in the info panel.
+//
+// Phases are timed on the main thread only and kept in fixed arrays, so profiling never allocates. Worker
+// threads report the time they spend busy through atomic counters, which the main thread samples once per
+// frame; neither side ever takes a lock.
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "render.h"
+#include <cstdint>
+
+const int PROFILE_WINDOW = 240;             // Frames kept for the statistics (4 seconds at 60 FPS)
+const int FRAME_HISTOGRAM_BUCKETS = 8;      // Buckets of the frame time histogram, the last one has no upper limit
+const int PROFILER_OVERLAY_Y = 400;         // Top of the overlay in the info panel, below the key hints
+const float ANIMATION_BUDGET_MS = 1.0f;     // Animation time a frame may take; a p99 above it is shown in red
+
+enum ProfilePhase {
+    PHASE_INPUT,        // Mouse and key handling, including the turns it plays and journals
+    PHASE_GAME_OVER,    // UpdateGameOver (runs inside PHASE_INPUT, so it is also counted there)
+    PHASE_ANIMATION,    // Stepping, starting and drawing animations (drawing is also counted in PHASE_DRAW)
+    PHASE_DRAW,         // DrawBoard: scene redraws and blits
+    PHASE_PRESENT,      // EndDrawing: buffer swap, frame rate limiting and waiting for events
+    PHASE_COUNT
+};
+
+enum ProfileThread {
+    PROFILE_THREAD_AI,          // A computer player searching off the main thread (nothing reports this yet)
+    PROFILE_THREAD_JOURNAL,     // The journal writer
+    PROFILE_THREAD_NETWORK,     // The network reader, only while playing online
+    PROFILE_THREAD_COUNT
+};
+
+// Statistics of one phase over the window, in milliseconds.
+struct PhaseSummary {
+    float minMs;
+    float avgMs;
+    float p99Ms;
+};
+
+struct ProfilerReport {
+    int frames;                                 // Frames in the window
+    PhaseSummary phases[PHASE_COUNT];
+    PhaseSummary frameTime;                     // Start-to-start time of frames drawn back to back
+    int histogram[FRAME_HISTOGRAM_BUCKETS];     // Frames drawn back to back, by frame time
+    int idleWakeups;                            // Frames that started after waiting for input; not in the histogram
+    float threadBusy[PROFILE_THREAD_COUNT];     // Fraction of the window each worker thread was busy
+    bool threadSeen[PROFILE_THREAD_COUNT];      // False until the thread has reported any work
+};
+
+extern const float FRAME_HISTOGRAM_LIMITS_MS[FRAME_HISTOGRAM_BUCKETS - 1]; // Upper limit of every bucket but the last
+
+uint64_t ProfilerNow(); // Monotonic high resolution clock, in nanoseconds.
+void ProfilerBeginFrame(bool afterIdleWait); // Starts a frame; pass true if the loop slept waiting for input since the last one.
+void ProfilerAddPhase(ProfilePhase phase, uint64_t startTime); // Adds the time since startTime (from ProfilerNow) to a phase of this frame.
+void ProfilerEndFrame();
+void ProfilerAddThreadBusy(ProfileThread thread, uint64_t nanoseconds); // Safe to call from any thread.
+void GetProfilerReport(ProfilerReport &report); // Summarises the window. Only needed while the overlay is shown.
+void DrawProfilerOverlay(const RenderBackend &backend, const ProfilerReport &report);
+
+#endif
@@ -0,0 +1,103 @@
+// @file protocol.cpp
+// @brief Framing and payload encoding of the binary server protocol. Nothing here allocates.
+
+#include "protocol.h"
+#include "savefile.h"
+#include <cstring>
+
+const uint8_t LAST_LANDING_FLAG = 0x80;    // Marks the last landing square of a turn, as in the save file
+
+const char *const COMMAND_NAMES[PROTOCOL_UNKNOWN] = {
+    "?", "PLAY", "MOVE", "PING", "QUIT", "SYNC", "WAIT", "START", "END", "PONG", "ERROR", "POSITION", "WATCH", "SNAPSHOT"
+};
+
+// Smallest and largest payload of each command
+const uint8_t PAYLOAD_MIN[PROTOCOL_UNKNOWN] = { 0, 0, 2, 4, 0, 0, 0, 5 + PROTOCOL_POSITION_SIZE, 1, 4, 1, 2 + PROTOCOL_POSITION_SIZE, 4, 6 + PROTOCOL_POSITION_SIZE };
+const uint8_t PAYLOAD_MAX[PROTOCOL_UNKNOWN] = { 0, 0, PROTOCOL_MAX_TURN, 4, 0, 0, 0, 5 + PROTOCOL_POSITION_SIZE, 1, 4, 1, 2 + PROTOCOL_POSITION_SIZE, 4, 6 + PROTOCOL_POSITION_SIZE };
+
+const char *const ERROR_NAMES[] = { "?", "not in a game", "not your turn", "illegal move", "already in a game", "bad message", "no such game" };
+
+
+const char *ProtocolCommandName(ProtocolCommand command) {
+    return (command > 0 && command < PROTOCOL_UNKNOWN) ? COMMAND_NAMES[command] : "?";
+}
+
+
+const char *ProtocolErrorName(int error) {
+    return (error > 0 && error <= PROTOCOL_ERROR_NO_SUCH_GAME) ? ERROR_NAMES[error] : "?";
+}
+
+
+int FindProtocolMessage(const uint8_t *data, int length) {
+    if (length < PROTOCOL_HEADER_SIZE) return 0;
+    if (data[0] == 0 || data[0] >= PROTOCOL_UNKNOWN || data[1] > PROTOCOL_MAX_PAYLOAD) return -1;
+    int messageLength = PROTOCOL_HEADER_SIZE + data[1];
+    return (messageLength <= length) ? messageLength : 0;
+}
+
+
+bool ParseProtocolMessage(const uint8_t *data, int length, ProtocolMessage &message) {
+    message.command = (ProtocolCommand)data[0];
+    message.payload = data + PROTOCOL_HEADER_SIZE;
+    message.payloadLength = length - PROTOCOL_HEADER_SIZE;
+    return message.payloadLength >= PAYLOAD_MIN[data[0]] && message.payloadLength <= PAYLOAD_MAX[data[0]];
+}
+
+
+int WriteProtocolMessage(uint8_t *buffer, int size, ProtocolCommand command, const uint8_t *payload, int payloadLength) {
+    int length = PROTOCOL_HEADER_SIZE + payloadLength;
+    if (length > size || payloadLength > PROTOCOL_MAX_PAYLOAD) return 0;
+    buffer[0] = (uint8_t)command;
+    buffer[1] = (uint8_t)payloadLength;
+    if (payloadLength > 0) memcpy(buffer + PROTOCOL_HEADER_SIZE, payload, payloadLength);
+    return length;
+}
+
+
+int EncodeProtocolTurn(const Move &move, uint8_t *payload) {
+    payload[0] = move.from;
+    for (int step = 0; step < move.length; step++) {
+        payload[1 + step] = move.path[step];
+    }
+    payload[move.length] |= LAST_LANDING_FLAG;
+    return 1 + move.length;
+}
+
+
+bool DecodeProtocolTurn(const Bitboards &pos, const uint8_t *payload, int length, Move &move) {
+    int landings = length - 1;
+    if (landings < 1 || landings > MAX_CAPTURES || !(payload[length - 1] & LAST_LANDING_FLAG)) return false;
+    uint8_t path[MAX_CAPTURES];
+    for (int step = 0; step < landings; step++) {
+        path[step] = payload[1 + step] & (uint8_t)~LAST_LANDING_FLAG;
+    }
+
+    // Only a turn the rules allow here is accepted; that also fills in the captures and promotion
+    MoveList list;
+    GenerateMoves(pos, list);
+    for (int i = 0; i < list.count; i++) {
+        const Move &candidate = list.moves[i];
+        if (candidate.from == payload[0] && candidate.length == landings && memcmp(candidate.path, path, landings) == 0) {
+            move = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+void EncodeProtocolPosition(const Bitboards &pos, uint8_t *payload) {
+    PutProtocolU32(payload, pos.pieces[0]);
+    PutProtocolU32(payload + 4, pos.pieces[1]);
+    PutProtocolU32(payload + 8, pos.kings);
+    PutProtocolU32(payload + 12, pos.sideToMove);
+}
+
+
+bool DecodeProtocolPosition(const uint8_t *payload, Bitboards &pos) {
+    pos.pieces[0] = GetProtocolU32(payload);
+    pos.pieces[1] = GetProtocolU32(payload + 4);
+    pos.kings = GetProtocolU32(payload + 8);
+    pos.sideToMove = GetProtocolU32(payload + 12);
+    return pos.sideToMove <= 1 && IsValidPosition(pos);
+}
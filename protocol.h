@@ -0,0 +1,97 @@
+// @file protocol.h
+// @brief Binary messages between the game server (tools/gameserver) and its clients.
+//
+// Every message is a 2-byte header, [u8 command][u8 payload length], followed by the payload; integers are
+// little-endian. The length is always in the header, so a receiver can cut messages straight out of its
+// receive buffer and read the payload where it lies without copying or decoding anything else first.
+//
+// Client to server:
+//   PLAY                   -                       take the free seat of a waiting game, or open a new game and wait
+//   MOVE                   turn (2-13 bytes)       play a turn
+//   PING                   u32 token               answered with PONG and the same token
+//   QUIT                   -                       leave the game; the opponent wins
+//   SYNC                   -                       ask for the current position of the game
+//   WATCH                  u32 game                watch a running game as a spectator; 0 picks the most watched one
+// Server to client:
+//   WAIT                   -                       seated, waiting for an opponent
+//   START                  u32 game, u8 side, position (21 bytes)   the game begins; side 0 is PLAYER1, who moves first
+//   MOVE                   turn (2-13 bytes)       a turn was played, sent to both players (the mover's copy confirms it)
+//   END                    u8 winner               the game is over; winner is the side that won
+//   PONG                   u32 token
+//   ERROR                  u8 ProtocolError        the last command was rejected and nothing changed
+//   POSITION               u16 plies, position (18 bytes)   the answer to SYNC
+//   SNAPSHOT               u32 game, u16 plies, position (22 bytes)   a watched game's position, sent on WATCH
+//                                                  and periodically to watchers that fell behind
+//
+// A watcher gets SNAPSHOT and then the same MOVE and END messages as the players, until the game ends or it
+// sends QUIT.
+//
+// A turn is encoded as in the save file (savefile.h): its starting square, then each landing square, one byte
+// each, with bit 7 set on the last one; a plain move is 2 bytes. A position is the 16-byte Bitboards: pieces
+// of PLAYER1, pieces of PLAYER2, kings and side to move as four u32. Positions are only sent when a game
+// starts and on resync; after that both sides follow the game turn by turn.
+
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include "rules.h"
+#include <cstdint>
+
+const int PROTOCOL_PORT = 7777;             // Default TCP port of the server
+const int PROTOCOL_HEADER_SIZE = 2;
+const int PROTOCOL_MAX_PAYLOAD = 32;        // Longer payloads are a protocol error (the longest valid one is SNAPSHOT)
+const int PROTOCOL_MAX_MESSAGE = PROTOCOL_HEADER_SIZE + PROTOCOL_MAX_PAYLOAD;
+const int PROTOCOL_POSITION_SIZE = 16;
+const int PROTOCOL_MAX_TURN = 1 + MAX_CAPTURES;  // Longest encoded turn
+
+// The command byte of each message; 0 is never sent, so a zeroed buffer is not mistaken for a message.
+enum ProtocolCommand {
+    PROTOCOL_PLAY = 1,
+    PROTOCOL_MOVE,
+    PROTOCOL_PING,
+    PROTOCOL_QUIT,
+    PROTOCOL_SYNC,
+    PROTOCOL_WAIT,
+    PROTOCOL_START,
+    PROTOCOL_END,
+    PROTOCOL_PONG,
+    PROTOCOL_ERROR,
+    PROTOCOL_POSITION,
+    PROTOCOL_WATCH,
+    PROTOCOL_SNAPSHOT,
+    PROTOCOL_UNKNOWN
+};
+
+enum ProtocolError {
+    PROTOCOL_ERROR_NOT_IN_GAME = 1,
+    PROTOCOL_ERROR_NOT_YOUR_TURN,
+    PROTOCOL_ERROR_ILLEGAL_MOVE,
+    PROTOCOL_ERROR_ALREADY_IN_GAME,
+    PROTOCOL_ERROR_BAD_MESSAGE,     // Unknown command, or a payload of the wrong size
+    PROTOCOL_ERROR_NO_SUCH_GAME     // WATCH named a game that is not running
+};
+
+// One message as it lies in a buffer. The payload points into that buffer.
+struct ProtocolMessage {
+    ProtocolCommand command;
+    const uint8_t *payload;
+    int payloadLength;
+};
+
+int FindProtocolMessage(const uint8_t *data, int length); // Length of the first complete message, 0 if it has not fully arrived, -1 if the header is invalid.
+bool ParseProtocolMessage(const uint8_t *data, int length, ProtocolMessage &message); // data as found by FindProtocolMessage. False if the payload size does not fit the command.
+int WriteProtocolMessage(uint8_t *buffer, int size, ProtocolCommand command, const uint8_t *payload, int payloadLength); // Bytes written, 0 if it does not fit.
+const char *ProtocolCommandName(ProtocolCommand command);
+const char *ProtocolErrorName(int error);
+
+int EncodeProtocolTurn(const Move &move, uint8_t *payload); // Writes at most PROTOCOL_MAX_TURN bytes and returns how many.
+bool DecodeProtocolTurn(const Bitboards &pos, const uint8_t *payload, int length, Move &move); // Finds the legal turn the payload describes.
+void EncodeProtocolPosition(const Bitboards &pos, uint8_t *payload); // Writes PROTOCOL_POSITION_SIZE bytes.
+bool DecodeProtocolPosition(const uint8_t *payload, Bitboards &pos); // False if it is not a possible position.
+
+inline void PutProtocolU16(uint8_t *out, uint16_t value) { out[0] = (uint8_t)value; out[1] = (uint8_t)(value >> 8); }
+inline void PutProtocolU32(uint8_t *out, uint32_t value) { for (int i = 0; i < 4; i++) out[i] = (uint8_t)(value >> (8 * i)); }
+inline uint16_t GetProtocolU16(const uint8_t *in) { return (uint16_t)(in[0] | (in[1] << 8)); }
+inline uint32_t GetProtocolU32(const uint8_t *in) { return in[0] | (in[1] << 8) | (in[2] << 16) | ((uint32_t)in[3] << 24); }
+
+#endif
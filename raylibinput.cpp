@@ -0,0 +1,26 @@
+// @file raylibinput.cpp
+// @brief InputSource that reads the mouse and keyboard through raylib.
+
+#include "raylib.h"
+#include "input.h"
+
+const int RAYLIB_KEYS[INPUT_KEY_COUNT] = { KEY_Z, KEY_Y, KEY_S, KEY_L, KEY_P, KEY_T, KEY_Q, KEY_R }; // Same order as InputKey
+
+static bool ReadRaylibFrame(void *, InputFrame &frame) {
+    frame.clicked = IsMouseButtonPressed(MOUSE_LEFT_BUTTON);
+    frame.mouseX = GetMouseX();
+    frame.mouseY = GetMouseY();
+    frame.keysPressed = 0;
+    for (int key = 0; key < INPUT_KEY_COUNT; key++) {
+        if (IsKeyPressed(RAYLIB_KEYS[key])) {
+            frame.keysPressed |= 1u << key;
+        }
+    }
+    return true;
+}
+
+
+void InitRaylibInput(InputSource &source) {
+    source.context = nullptr;
+    source.readFrame = ReadRaylibFrame;
+}
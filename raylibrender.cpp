@@ -0,0 +1,61 @@
+// @file raylibrender.cpp
+// @brief RenderBackend that draws with raylib.
+
+#include "raylib.h"
+#include "render.h"
+#include <vector>
+
+using namespace std;
+
+static Texture2D pieceAtlas; // The pre-rendered piece sprites; raylib batches consecutive draws from it into one draw call
+
+static Color ToRaylibColor(RenderColor color) {
+    return (Color){ color.r, color.g, color.b, color.a };
+}
+
+
+static void RaylibRectangle(void *, int x, int y, int width, int height, RenderColor color) {
+    DrawRectangle(x, y, width, height, ToRaylibColor(color));
+}
+
+
+static void RaylibCircle(void *, int centerX, int centerY, float radius, RenderColor color) {
+    DrawCircle(centerX, centerY, radius, ToRaylibColor(color));
+}
+
+
+static void RaylibText(void *, const char *text, int x, int y, int fontSize, RenderColor color) {
+    DrawText(text, x, y, fontSize, ToRaylibColor(color));
+}
+
+
+static int RaylibMeasureText(void *, const char *text, int fontSize) {
+    return MeasureText(text, fontSize);
+}
+
+
+// Every sprite is drawn at 1:1 scale, so the anti-aliasing baked into the atlas reaches the screen unchanged.
+static void RaylibSprite(void *, int sprite, int x, int y, uint8_t alpha) {
+    Rectangle source = { (float)(sprite * CELL_SIZE), 0, (float)CELL_SIZE, (float)CELL_SIZE };
+    DrawTextureRec(pieceAtlas, source, (Vector2){ (float)x, (float)y }, (Color){ 255, 255, 255, alpha });
+}
+
+
+void InitRaylibBackend(RenderBackend &backend) {
+    vector<uint8_t> pixels((size_t)ATLAS_WIDTH * ATLAS_HEIGHT * 4);
+    BuildPieceAtlas(pixels.data());
+    Image atlas = { pixels.data(), ATLAS_WIDTH, ATLAS_HEIGHT, 1, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8 };
+    pieceAtlas = LoadTextureFromImage(atlas);
+
+    backend.context = nullptr;
+    backend.drawRectangle = RaylibRectangle;
+    backend.drawCircle = RaylibCircle;
+    backend.drawText = RaylibText;
+    backend.measureText = RaylibMeasureText;
+    backend.drawSprite = RaylibSprite;
+}
+
+
+void UnloadRaylibBackend(RenderBackend &) {
+    UnloadTexture(pieceAtlas);
+}
@@ -0,0 +1,228 @@
+// @file render.cpp
+// @brief Draws the board scene through a RenderBackend, and the recording backend used by the headless tools.
+
+#include "render.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+using namespace std;
+
+// raylib's palette, so the scene looks the same whichever backend draws it
+const RenderColor COLOR_GREEN = {0, 228, 48, 255};
+const RenderColor COLOR_YELLOW = {253, 249, 0, 255};
+const RenderColor COLOR_RED = {230, 41, 55, 255};
+const RenderColor COLOR_BLUE = {0, 121, 241, 255};
+const RenderColor COLOR_DARKGRAY = {80, 80, 80, 255};
+const RenderColor COLOR_BLACK = {0, 0, 0, 255};
+const RenderColor PLAYER1_COLOR = {200, 0, 0, 255};   // Deep red for Player1
+const RenderColor PLAYER2_COLOR = {0, 0, 255, 255};   // Blue for Player2
+const RenderColor KING_COLOR = {255, 215, 0, 255};    // Gold king marker
+
+
+void DrawBoardSquares(const RenderBackend &backend) {
+    for (int y = 0; y < BOARD_HEIGHT / CELL_SIZE; y++) {
+        for (int x = 0; x < BOARD_WIDTH / CELL_SIZE; x++) {
+            // Draw cells with high contrast
+            RenderColor cellColor = ((x + y) % 2 == 0) ? LIGHT_SQUARE_COLOR : DARK_SQUARE_COLOR;
+            backend.drawRectangle(backend.context, x * CELL_SIZE, y * CELL_SIZE, CELL_SIZE, CELL_SIZE, cellColor);
+        }
+    }
+
+    // Draw the parts of the player info panel that never change
+    int infoPanelX = BOARD_WIDTH;// where the info panal starts
+    backend.drawRectangle(backend.context, infoPanelX, 0, INFO_PANEL_WIDTH, BOARD_HEIGHT, LIGHT_SQUARE_COLOR); // Info panel background
+    backend.drawText(backend.context, "SCOREBOARD", infoPanelX + 15, 10, 30, DARK_SQUARE_COLOR); // Dark color for title
+    backend.drawText(backend.context, "Player1", infoPanelX + 15, 50, 22, COLOR_BLACK); // Dark black for player names
+    backend.drawText(backend.context, "Player2", infoPanelX + 15, 150, 22, COLOR_BLACK);
+    backend.drawText(backend.context, "Turn: ", infoPanelX + 15, 250, 22, COLOR_BLACK); // Dark black for turn label
+
+    // Draw save/load instructions
+    backend.drawText(backend.context, "To Save Press 'S'", infoPanelX + 15, 280, 22, COLOR_DARKGRAY);
+    backend.drawText(backend.context, "To Load Press 'L'", infoPanelX + 15, 310, 22, COLOR_DARKGRAY);
+    backend.drawText(backend.context, "Undo 'Z'  Redo 'Y'", infoPanelX + 15, 340, 22, COLOR_DARKGRAY);
+    backend.drawText(backend.context, "Profiler 'P'", infoPanelX + 15, 370, 22, COLOR_DARKGRAY);
+}
+
+
+// Draws the scores, piece counts and turn indicator. Text is formatted into stack buffers, so nothing is allocated.
+static void DrawInfoPanel(const RenderBackend &backend, const BoardView &view) {
+    int infoPanelX = BOARD_WIDTH;// where the info panal starts
+    RenderColor scoreTextColor = {0, 100, 0, 255}; // Dark green for scores
+    RenderColor turnIndicatorColor = (view.position.sideToMove == 0) ? PLAYER1_COLOR : PLAYER2_COLOR;
+    char text[32];
+
+    // Draw Player 1's info
+    snprintf(text, sizeof(text), "Score: %d", view.player1Score);
+    backend.drawText(backend.context, text, infoPanelX + 15, 80, 22, scoreTextColor);
+    snprintf(text, sizeof(text), "Pieces: %d", PopCount(view.position.pieces[0]));
+    backend.drawText(backend.context, text, infoPanelX + 15, 110, 22, scoreTextColor);
+
+    // Draw Player 2's info
+    snprintf(text, sizeof(text), "Score: %d", view.player2Score);
+    backend.drawText(backend.context, text, infoPanelX + 15, 180, 22, scoreTextColor);
+    snprintf(text, sizeof(text), "Pieces: %d", PopCount(view.position.pieces[1]));
+    backend.drawText(backend.context, text, infoPanelX + 15, 210, 22, scoreTextColor);
+
+    // Draw turn indicator
+    backend.drawRectangle(backend.context, infoPanelX + 90, 250, 20, 20, turnIndicatorColor); // Small colored box to indicate whose turn it is
+}
+
+
+// Draws a line of text centred on the board, in bold: dark copies at small offsets first, then the text itself.
+static void DrawBoldText(const RenderBackend &backend, const char *text, int y, int fontSize, RenderColor color) {
+    int x = BOARD_WIDTH / 2 - backend.measureText(backend.context, text, fontSize) / 2;
+    for (int offsetX = -3; offsetX <= 3; offsetX += 2) {
+        for (int offsetY = -3; offsetY <= 3; offsetY += 2) {
+            backend.drawText(backend.context, text, x + offsetX, y + offsetY, fontSize, COLOR_DARKGRAY);
+        }
+    }
+    backend.drawText(backend.context, text, x, y, fontSize, color);
+}
+
+
+// Blends `color` over the RGBA pixel with the given coverage (straight alpha).
+static void BlendPixel(uint8_t *pixel, RenderColor color, float coverage) {
+    float srcAlpha = coverage * color.a / 255.0f;
+    float dstAlpha = pixel[3] / 255.0f;
+    float outAlpha = srcAlpha + dstAlpha * (1.0f - srcAlpha);
+    if (outAlpha <= 0.0f) return;
+
+    uint8_t source[3] = { color.r, color.g, color.b };
+    for (int i = 0; i < 3; i++) {
+        pixel[i] = (uint8_t)((source[i] * srcAlpha + pixel[i] * dstAlpha * (1.0f - srcAlpha)) / outAlpha + 0.5f);
+    }
+    pixel[3] = (uint8_t)(outAlpha * 255.0f + 0.5f);
+}
+
+
+// Draws a filled circle into one sprite cell, with edge pixels weighted by how much of them the circle covers.
+static void RasterizeCircle(uint8_t *pixels, int sprite, float radius, RenderColor color) {
+    float center = CELL_SIZE / 2.0f;
+    for (int y = 0; y < CELL_SIZE; y++) {
+        for (int x = 0; x < CELL_SIZE; x++) {
+            float distance = sqrtf((x + 0.5f - center) * (x + 0.5f - center) + (y + 0.5f - center) * (y + 0.5f - center));
+            float coverage = min(1.0f, max(0.0f, radius + 0.5f - distance));
+            if (coverage > 0.0f) {
+                BlendPixel(pixels + 4 * (y * ATLAS_WIDTH + sprite * CELL_SIZE + x), color, coverage);
+            }
+        }
+    }
+}
+
+
+void BuildPieceAtlas(uint8_t *pixels) {
+    memset(pixels, 0, (size_t)ATLAS_WIDTH * ATLAS_HEIGHT * 4);
+    for (int sprite = 0; sprite < SPRITE_COUNT; sprite++) {
+        bool player1 = sprite == SPRITE_PLAYER1_MAN || sprite == SPRITE_PLAYER1_KING;
+        RasterizeCircle(pixels, sprite, CELL_SIZE / 2 - 10, player1 ? PLAYER1_COLOR : PLAYER2_COLOR);
+        if (sprite == SPRITE_PLAYER1_KING || sprite == SPRITE_PLAYER2_KING) {
+            RasterizeCircle(pixels, sprite, QORKI_SIZE, KING_COLOR);
+        }
+    }
+}
+
+
+void DrawBoardScene(const RenderBackend &backend, const BoardView &view) {
+    // Highlight selected piece and valid moves (all shapes first, so the pieces below form one atlas batch)
+    if (view.selectedSquare >= 0) {
+        int x = SquareX(view.selectedSquare);
+        int y = SquareY(view.selectedSquare);
+        backend.drawRectangle(backend.context, x * CELL_SIZE, y * CELL_SIZE, CELL_SIZE, CELL_SIZE, COLOR_GREEN);
+    }
+    for (uint32_t remaining = view.targetSquares; remaining != 0; remaining &= remaining - 1) {
+        int square = __builtin_ctz(remaining);
+        backend.drawRectangle(backend.context, SquareX(square) * CELL_SIZE, SquareY(square) * CELL_SIZE, CELL_SIZE, CELL_SIZE, COLOR_YELLOW);
+    }
+
+    // Draw pieces from the atlas
+    for (int side = 0; side < 2; side++) {
+        for (uint32_t remaining = view.position.pieces[side] & ~view.hiddenSquares; remaining != 0; remaining &= remaining - 1) {
+            int square = __builtin_ctz(remaining);
+            bool isKing = (view.position.kings & SquareBit(square)) != 0;
+            int sprite = (side == 0) ? (isKing ? SPRITE_PLAYER1_KING : SPRITE_PLAYER1_MAN)
+                                     : (isKing ? SPRITE_PLAYER2_KING : SPRITE_PLAYER2_MAN);
+            backend.drawSprite(backend.context, sprite, SquareX(square) * CELL_SIZE, SquareY(square) * CELL_SIZE, 255);
+        }
+    }
+
+    DrawInfoPanel(backend, view);
+
+    // The winner message and the restart/quit hints
+    if (view.gameOver) {
+        if (view.winner == 0) {
+            DrawBoldText(backend, "Player 1 Wins!", BOARD_HEIGHT / 2 - 30, 60, COLOR_RED);
+        } else {
+            DrawBoldText(backend, "Player 2 Wins!", BOARD_HEIGHT / 2 - 30, 60, COLOR_BLUE);
+        }
+        DrawBoldText(backend, "Press 'R' to restart", BOARD_HEIGHT / 2 + 100, 30, COLOR_BLACK);
+        DrawBoldText(backend, "Press 'Q' to quit", BOARD_HEIGHT / 2 + 50, 30, COLOR_BLACK);
+    }
+}
+
+
+// Recording backend: every call only adds to the RenderStats passed as the context.
+
+static void RecordBatch(RenderStats *stats, int texture) {
+    stats->drawCalls++;
+    if (stats->batchTexture != texture) {
+        stats->batches++;
+        stats->batchTexture = texture;
+    }
+}
+
+
+static void RecordRectangle(void *context, int, int, int width, int height, RenderColor) {
+    RenderStats *stats = (RenderStats *)context;
+    RecordBatch(stats, 0);
+    stats->rectangles++;
+    stats->pixelsCovered += (uint64_t)width * height;
+}
+
+
+static void RecordCircle(void *context, int, int, float radius, RenderColor) {
+    RenderStats *stats = (RenderStats *)context;
+    RecordBatch(stats, 0);
+    stats->circles++;
+    stats->pixelsCovered += (uint64_t)(3.14159265f * radius * radius);
+}
+
+
+// Estimate for raylib's default font: about half the font size per character.
+static int MeasureRecordedText(void *, const char *text, int fontSize) {
+    return (int)strlen(text) * fontSize / 2;
+}
+
+
+static void RecordText(void *context, const char *text, int, int, int fontSize, RenderColor) {
+    RenderStats *stats = (RenderStats *)context;
+    RecordBatch(stats, 0);
+    stats->texts++;
+    stats->pixelsCovered += (uint64_t)MeasureRecordedText(context, text, fontSize) * fontSize;
+}
+
+
+static void RecordSprite(void *context, int, int, int, uint8_t) {
+    RenderStats *stats = (RenderStats *)context;
+    RecordBatch(stats, 1);
+    stats->sprites++;
+    stats->pixelsCovered += (uint64_t)CELL_SIZE * CELL_SIZE;
+}
+
+
+void InitRecordingBackend(RenderBackend &backend, RenderStats &stats) {
+    ResetRenderStats(stats);
+    backend.context = &stats;
+    backend.drawRectangle = RecordRectangle;
+    backend.drawCircle = RecordCircle;
+    backend.drawText = RecordText;
+    backend.measureText = MeasureRecordedText;
+    backend.drawSprite = RecordSprite;
+}
+
+
+void ResetRenderStats(RenderStats &stats) {
+    memset(&stats, 0, sizeof(stats));
+    stats.batchTexture = -1;
+}
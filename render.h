@@ -0,0 +1,78 @@
+// @file render.h
+// @brief Board drawing through a small backend interface, so it can run with raylib or headless.
+//
+// The board and info panel are drawn from a BoardView (the position plus what is highlighted) into a
+// RenderBackend. The raylib backend (raylibrender.cpp) draws on screen; the recording backend only
+// counts what would have been drawn, which lets the tools measure rendering work without a display.
+
+#ifndef RENDER_H
+#define RENDER_H
+
+#include "rules.h"
+
+// Constants for the board and pieces
+const int BOARD_WIDTH = 600;            // Adjusted width for the board
+const int BOARD_HEIGHT = 600;           // Adjusted height to fit the screen
+const int CELL_SIZE = 75;               // Size of each square in pixels
+const int QORKI_SIZE = 20;              // Size of king markers
+const int INFO_PANEL_WIDTH = 250;       // Width of the panel for player info(The extra space on the side for player information)
+const int SCREEN_WIDTH = BOARD_WIDTH + INFO_PANEL_WIDTH;
+
+// Same layout as raylib's Color, so the raylib backend can pass colors straight through.
+struct RenderColor {
+    uint8_t r, g, b, a;
+};
+
+const RenderColor LIGHT_SQUARE_COLOR = {255, 255, 204, 255}; // Off-white for light squares (and the info panel)
+const RenderColor DARK_SQUARE_COLOR = {0, 51, 0, 255};       // Deep green for dark squares
+
+// Pieces are pre-rendered once into an atlas of CELL_SIZE squares, one per sprite, side by side.
+enum PieceSprite { SPRITE_PLAYER1_MAN, SPRITE_PLAYER1_KING, SPRITE_PLAYER2_MAN, SPRITE_PLAYER2_KING, SPRITE_COUNT };
+const int ATLAS_WIDTH = SPRITE_COUNT * CELL_SIZE;
+const int ATLAS_HEIGHT = CELL_SIZE;
+
+// The drawing operations the board needs. A backend fills in every function; `context` is passed back to them.
+struct RenderBackend {
+    void *context;
+    void (*drawRectangle)(void *context, int x, int y, int width, int height, RenderColor color);
+    void (*drawCircle)(void *context, int centerX, int centerY, float radius, RenderColor color);
+    void (*drawText)(void *context, const char *text, int x, int y, int fontSize, RenderColor color);
+    int (*measureText)(void *context, const char *text, int fontSize);
+    void (*drawSprite)(void *context, int sprite, int x, int y, uint8_t alpha); // Draws a PieceSprite with its top-left corner at (x, y), 255 opaque
+};
+
+// Everything the board scene shows.
+struct BoardView {
+    Bitboards position;         // Pieces, and whose turn it is
+    int selectedSquare;         // Square of the selected piece, or -1
+    uint32_t targetSquares;     // Squares the selected piece can move to, highlighted yellow
+    uint32_t hiddenSquares;     // Pieces left out because an animation is drawing them
+    int player1Score;
+    int player2Score;
+    bool gameOver;
+    int winner;                 // 0 PLAYER1, 1 PLAYER2, only used once the game is over
+};
+
+// Totals kept by the recording backend. Areas are in pixels; text area is estimated from MeasureRecordedText.
+struct RenderStats {
+    uint64_t drawCalls;         // Every call made through the backend
+    uint64_t rectangles;
+    uint64_t circles;
+    uint64_t texts;
+    uint64_t sprites;
+    uint64_t batches;           // GPU batches: a new one starts whenever drawing switches to or from the piece atlas
+    uint64_t pixelsCovered;     // Sum of every shape's area, so pixelsCovered / screen area is the overdraw
+    int batchTexture;           // Texture of the current batch while recording (1 for the atlas, 0 otherwise, -1 none yet)
+};
+
+void DrawBoardSquares(const RenderBackend &backend); // The checkerboard and the fixed parts of the info panel.
+void DrawBoardScene(const RenderBackend &backend, const BoardView &view); // Highlights, pieces, panel text and the game over message.
+
+void BuildPieceAtlas(uint8_t *pixels); // Fills ATLAS_WIDTH x ATLAS_HEIGHT RGBA pixels with the anti-aliased piece sprites.
+
+void InitRaylibBackend(RenderBackend &backend); // Draws on screen (raylibrender.cpp, the game only). Needs an open window for the atlas.
+void UnloadRaylibBackend(RenderBackend &backend);
+void InitRecordingBackend(RenderBackend &backend, RenderStats &stats); // Counts into `stats` instead of drawing.
+void ResetRenderStats(RenderStats &stats);
+
+#endif
@@ -0,0 +1,53 @@
+// @file rollback.h
+// @brief Positions by turn number in a fixed ring, so a game can be put back to an earlier turn at once.
+//
+// The online client shows its own turns before the server has confirmed them. It saves the position after
+// every turn under the number of turns played, and going back to the last confirmed turn is then a single
+// 16-byte copy however many turns are taken back, instead of unmaking them one at a time. Saving a turn
+// forgets any saved after it, so the ring always holds one line of play: the last ROLLBACK_SIZE positions.
+// Everything is inline, so saving and restoring stay a few instructions (see the rollback benchmarks in
+// tools/rulesbench).
+
+#ifndef ROLLBACK_H
+#define ROLLBACK_H
+
+#include "rules.h"
+#include <cstdint>
+
+const int ROLLBACK_SIZE = 16;           // Positions kept (a power of two); far more than can wait for confirmation
+
+static_assert((ROLLBACK_SIZE & (ROLLBACK_SIZE - 1)) == 0, "ROLLBACK_SIZE must be a power of two");
+
+struct RollbackRing {
+    Bitboards positions[ROLLBACK_SIZE]; // The position after `ply` turns is at ply % ROLLBACK_SIZE
+    uint32_t first;                     // Oldest turn number still held
+    uint32_t last;                      // Newest turn number saved
+};
+
+// Forgets everything and holds only pos, after `ply` turns.
+inline void ResetRollback(RollbackRing &ring, uint32_t ply, const Bitboards &pos) {
+    ring.positions[ply & (ROLLBACK_SIZE - 1)] = pos;
+    ring.first = ply;
+    ring.last = ply;
+}
+
+// Saves the position after `ply` turns and forgets every later one. A ply that does not follow on from
+// what is held starts the ring over.
+inline void SaveRollback(RollbackRing &ring, uint32_t ply, const Bitboards &pos) {
+    ring.positions[ply & (ROLLBACK_SIZE - 1)] = pos;
+    if (ply < ring.first || ply > ring.last + 1) {
+        ring.first = ply;
+    } else if (ply - ring.first >= (uint32_t)ROLLBACK_SIZE) {
+        ring.first = ply - (ROLLBACK_SIZE - 1);  // Overwrote the oldest
+    }
+    ring.last = ply;
+}
+
+// The position after `ply` turns. Returns false if the ring does not hold it.
+inline bool RestoreRollback(const RollbackRing &ring, uint32_t ply, Bitboards &pos) {
+    if (ply < ring.first || ply > ring.last) return false;
+    pos = ring.positions[ply & (ROLLBACK_SIZE - 1)];
+    return true;
+}
+
+#endif
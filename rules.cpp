@@ -0,0 +1,318 @@
+// @file rules.cpp
+// @brief Full-turn move generation, make/unmake and Zobrist keys for the headless rules.
+//
+// The rules mirror what FindValidMoves and ApplyClick in gamestate.cpp allow (tools/rulesfuzz checks this):
+//  - regular pieces step and capture forward only, one square at a time;
+//  - kings slide any distance and capture at range, landing on the square right after the captured piece;
+//  - after a capture a regular piece keeps capturing (forward) while it can;
+//  - after a capture a king keeps capturing only if a short (adjacent) capture is available, and may then take any capture;
+//  - a piece that is promoted ends the turn immediately.
+
+#include "rules.h"
+
+const int DIRECTIONS[4][2] = { {1, 1}, {-1, 1}, {1, -1}, {-1, -1} }; // Same order FindValidMoves uses (down-right, down-left, up-right, up-left)
+
+// Precomputed diagonals: for every square and direction, the squares along the ray, nearest first.
+struct RayTable {
+    int8_t squares[BOARD_SQUARES][4][7];
+    uint8_t length[BOARD_SQUARES][4];
+
+    RayTable() {
+        for (int square = 0; square < BOARD_SQUARES; square++) {
+            for (int d = 0; d < 4; d++) {
+                int x = SquareX(square) + DIRECTIONS[d][0];
+                int y = SquareY(square) + DIRECTIONS[d][1];
+                length[square][d] = 0;
+                while (x >= 0 && x < 8 && y >= 0 && y < 8) {
+                    squares[square][d][length[square][d]++] = (int8_t)SquareIndex(x, y);
+                    x += DIRECTIONS[d][0];
+                    y += DIRECTIONS[d][1];
+                }
+            }
+        }
+    }
+};
+
+static const RayTable rays;
+
+
+// Zobrist keys for [PLAYER1 man, PLAYER1 king, PLAYER2 man, PLAYER2 king][square] and for PLAYER2 to move.
+struct ZobristTable {
+    uint64_t pieces[4][BOARD_SQUARES];
+    uint64_t side;
+
+    ZobristTable() {
+        uint64_t state = 0x45434845434B5253ull; // Fixed seed: keys must never change, they are stored in databases
+        for (int kind = 0; kind < 4; kind++) {
+            for (int square = 0; square < BOARD_SQUARES; square++) {
+                pieces[kind][square] = SplitMix64(state);
+            }
+        }
+        side = SplitMix64(state);
+    }
+
+    static uint64_t SplitMix64(uint64_t &state) {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+};
+
+static const ZobristTable zobrist;
+
+
+// Working copy of the board used while walking a capture chain.
+struct ChainState {
+    uint32_t own;     // Mover's pieces, including the moving piece at its current square
+    uint32_t opp;     // Opponent pieces still on the board
+    uint32_t kings;   // Kings at the start of the turn (captured squares are never visited again)
+    int side;         // 0 or 1, the side making the move
+    bool isKing;      // Whether the moving piece is a king
+};
+
+
+static bool IsPromotionSquare(int side, int square) {
+    return (side == 0) ? SquareY(square) == 7 : SquareY(square) == 0;
+}
+
+
+static void PushMove(MoveList &list, const Move &move) {
+    if (list.count < MAX_MOVES) {
+        list.moves[list.count++] = move;
+    }
+}
+
+
+// True if the piece on `square` has a capture over an adjacent opponent in any of the four directions.
+// ApplyClick only lets a king continue a capture sequence when this holds.
+static bool HasAdjacentCapture(const ChainState &state, int square) {
+    uint32_t occupied = state.own | state.opp;
+    for (int d = 0; d < 4; d++) {
+        if (rays.length[square][d] >= 2 &&
+            (state.opp & SquareBit(rays.squares[square][d][0])) &&
+            !(occupied & SquareBit(rays.squares[square][d][1]))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+// Lists the captures available from `square`: the landing square and the captured piece of each one.
+static int FindCaptures(const ChainState &state, int square, uint8_t landings[], uint8_t victims[]) {
+    uint32_t occupied = state.own | state.opp;
+    int count = 0;
+
+    if (state.isKing) {
+        for (int d = 0; d < 4; d++) {
+            int victim = -1;
+            for (int i = 0; i < rays.length[square][d]; i++) {
+                int next = rays.squares[square][d][i];
+                if (!(occupied & SquareBit(next))) {
+                    if (victim >= 0) {
+                        landings[count] = (uint8_t)next;
+                        victims[count] = (uint8_t)victim;
+                        count++;
+                        break;  // Land immediately after the captured piece
+                    }
+                } else if ((state.opp & SquareBit(next)) && victim < 0) {
+                    victim = next;
+                } else {
+                    break;  // Own piece, or a second opponent piece in a row
+                }
+            }
+        }
+    } else {
+        int firstDirection = (state.side == 0) ? 0 : 2; // Forward only
+        for (int d = firstDirection; d < firstDirection + 2; d++) {
+            if (rays.length[square][d] >= 2 &&
+                (state.opp & SquareBit(rays.squares[square][d][0])) &&
+                !(occupied & SquareBit(rays.squares[square][d][1]))) {
+                landings[count] = (uint8_t)rays.squares[square][d][1];
+                victims[count] = (uint8_t)rays.squares[square][d][0];
+                count++;
+            }
+        }
+    }
+
+    return count;
+}
+
+
+// Called after the piece has just captured and landed on `square`; follows every way the chain can continue.
+static void ExtendCaptures(const ChainState &state, Move &move, int square, MoveList &list) {
+    uint8_t landings[4];
+    uint8_t victims[4];
+    int captureCount = 0;
+
+    if (!state.isKing || HasAdjacentCapture(state, square)) {
+        captureCount = FindCaptures(state, square, landings, victims);
+    }
+
+    if (captureCount == 0 || move.length == MAX_CAPTURES) {
+        PushMove(list, move);
+        return;
+    }
+
+    for (int i = 0; i < captureCount; i++) {
+        ChainState next = state;
+        next.own ^= SquareBit(square) | SquareBit(landings[i]);
+        next.opp ^= SquareBit(victims[i]);
+
+        Move extended = move;
+        extended.path[extended.length++] = landings[i];
+        extended.to = landings[i];
+        extended.captured |= SquareBit(victims[i]);
+        extended.capturedKings |= state.kings & SquareBit(victims[i]);
+
+        if (!state.isKing && IsPromotionSquare(state.side, landings[i])) {
+            extended.promotes = 1;  // Promotion ends the turn
+            PushMove(list, extended);
+        } else {
+            ExtendCaptures(next, extended, landings[i], list);
+        }
+    }
+}
+
+
+void InitialBitboards(Bitboards &pos) {
+    pos.pieces[0] = 0x00000FFFu; // Rows 0-2
+    pos.pieces[1] = 0xFFF00000u; // Rows 5-7
+    pos.kings = 0;
+    pos.sideToMove = 0;
+}
+
+
+void GenerateMoves(const Bitboards &pos, MoveList &list) {
+    list.count = 0;
+
+    int side = (int)pos.sideToMove;
+    uint32_t own = pos.pieces[side];
+    uint32_t occupied = pos.pieces[0] | pos.pieces[1];
+
+    for (uint32_t remaining = own; remaining != 0; remaining &= remaining - 1) {
+        int from = __builtin_ctz(remaining);
+
+        ChainState state;
+        state.own = own;
+        state.opp = pos.pieces[side ^ 1];
+        state.kings = pos.kings;
+        state.side = side;
+        state.isKing = (pos.kings & SquareBit(from)) != 0;
+
+        Move move;
+        move.from = (uint8_t)from;
+        move.length = 1;
+        move.promotes = 0;
+        move.captured = 0;
+        move.capturedKings = 0;
+
+        // Plain (non-capturing) moves
+        if (state.isKing) {
+            for (int d = 0; d < 4; d++) {
+                for (int i = 0; i < rays.length[from][d]; i++) {
+                    int next = rays.squares[from][d][i];
+                    if (occupied & SquareBit(next)) break;
+                    move.to = move.path[0] = (uint8_t)next;
+                    PushMove(list, move);
+                }
+            }
+        } else {
+            int firstDirection = (side == 0) ? 0 : 2;
+            for (int d = firstDirection; d < firstDirection + 2; d++) {
+                if (rays.length[from][d] >= 1 && !(occupied & SquareBit(rays.squares[from][d][0]))) {
+                    move.to = move.path[0] = (uint8_t)rays.squares[from][d][0];
+                    move.promotes = IsPromotionSquare(side, move.to) ? 1 : 0;
+                    PushMove(list, move);
+                    move.promotes = 0;
+                }
+            }
+        }
+
+        // Captures, followed through the whole chain
+        uint8_t landings[4];
+        uint8_t victims[4];
+        int captureCount = FindCaptures(state, from, landings, victims);
+        for (int i = 0; i < captureCount; i++) {
+            ChainState next = state;
+            next.own ^= SquareBit(from) | SquareBit(landings[i]);
+            next.opp ^= SquareBit(victims[i]);
+
+            Move capture = move;
+            capture.to = capture.path[0] = landings[i];
+            capture.captured = SquareBit(victims[i]);
+            capture.capturedKings = pos.kings & SquareBit(victims[i]);
+
+            if (!state.isKing && IsPromotionSquare(side, landings[i])) {
+                capture.promotes = 1;
+                PushMove(list, capture);
+            } else {
+                ExtendCaptures(next, capture, landings[i], list);
+            }
+        }
+    }
+}
+
+
+void MakeMove(Bitboards &pos, const Move &move) {
+    int side = (int)pos.sideToMove;
+    uint32_t fromTo = SquareBit(move.from) ^ SquareBit(move.to); // Zero when a king's chain ends where it started
+
+    if (pos.kings & SquareBit(move.from)) {
+        pos.kings ^= fromTo;
+    }
+    pos.pieces[side] ^= fromTo;
+    pos.pieces[side ^ 1] ^= move.captured;
+    pos.kings ^= move.capturedKings;
+    if (move.promotes) {
+        pos.kings |= SquareBit(move.to);
+    }
+    pos.sideToMove ^= 1;
+}
+
+
+void UnmakeMove(Bitboards &pos, const Move &move) {
+    pos.sideToMove ^= 1;
+    int side = (int)pos.sideToMove;
+    uint32_t fromTo = SquareBit(move.from) ^ SquareBit(move.to);
+
+    if (move.promotes) {
+        pos.kings &= ~SquareBit(move.to);
+    }
+    if (pos.kings & SquareBit(move.to)) {
+        pos.kings ^= fromTo;
+    }
+    pos.kings ^= move.capturedKings;
+    pos.pieces[side ^ 1] ^= move.captured;
+    pos.pieces[side] ^= fromTo;
+}
+
+
+uint64_t ZobristHash(const Bitboards &pos) {
+    uint64_t hash = pos.sideToMove ? zobrist.side : 0;
+    for (int side = 0; side < 2; side++) {
+        for (uint32_t remaining = pos.pieces[side]; remaining != 0; remaining &= remaining - 1) {
+            int square = __builtin_ctz(remaining);
+            int kind = 2 * side + ((pos.kings & SquareBit(square)) ? 1 : 0);
+            hash ^= zobrist.pieces[kind][square];
+        }
+    }
+    return hash;
+}
+
+
+uint64_t ZobristAfterMove(uint64_t hash, const Bitboards &pos, const Move &move) {
+    int side = (int)pos.sideToMove;
+    bool isKing = (pos.kings & SquareBit(move.from)) != 0;
+    int moverKind = 2 * side + (isKing ? 1 : 0);
+    int landedKind = 2 * side + ((isKing || move.promotes) ? 1 : 0);
+
+    hash ^= zobrist.pieces[moverKind][move.from] ^ zobrist.pieces[landedKind][move.to];
+    for (uint32_t remaining = move.captured; remaining != 0; remaining &= remaining - 1) {
+        int square = __builtin_ctz(remaining);
+        int kind = 2 * (side ^ 1) + ((move.capturedKings & SquareBit(square)) ? 1 : 0);
+        hash ^= zobrist.pieces[kind][square];
+    }
+    return hash ^ zobrist.side;
+}
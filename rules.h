@@ -0,0 +1,51 @@
+// @file rules.h
+// @brief Headless Ethiopian checkers rules on bitboards, shared by the game and the tools.
+
+#ifndef RULES_H
+#define RULES_H
+
+#include <cstdint>
+
+const int BOARD_SQUARES = 32;           // Number of dark (playable) squares on the 8x8 board
+const int MAX_CAPTURES = 12;            // The most landing squares a single turn can have (one per captured piece)
+const int MAX_MOVES = 256;              // Upper bound on the number of full turns available in one position
+
+// Compact position. Every dark square has one bit, numbered row by row: index = y * 4 + x / 2.
+struct Bitboards {
+    uint32_t pieces[2]; // Squares occupied by PLAYER1 (index 0) and PLAYER2 (index 1) pieces
+    uint32_t kings;     // Squares occupied by kings of either side
+    uint32_t sideToMove; // 0 when PLAYER1 is to move, 1 when PLAYER2 is to move
+};
+
+// One complete turn: where the piece started, every square it landed on and everything it removed.
+struct Move {
+    uint8_t from;                 // Starting square
+    uint8_t to;                   // Final landing square (same as path[length - 1])
+    uint8_t length;               // Number of landing squares in path
+    uint8_t promotes;             // 1 if the piece becomes a king at the end of the turn
+    uint8_t path[MAX_CAPTURES];   // Landing squares in the order they were visited
+    uint32_t captured;            // Squares of every captured piece
+    uint32_t capturedKings;       // The captured squares that held kings (needed to unmake the move)
+};
+
+// Fixed-size list of the full turns available to the side to move.
+struct MoveList {
+    Move moves[MAX_MOVES];
+    int count;
+};
+
+inline uint32_t SquareBit(int square) { return 1u << square; }
+inline int PopCount(uint32_t mask) { return __builtin_popcount(mask); }
+inline int SquareY(int square) { return square >> 2; }
+inline int SquareX(int square) { return 2 * (square & 3) + ((SquareY(square) & 1) ^ 1); }
+inline int SquareIndex(int x, int y) { return y * 4 + x / 2; } // Only meaningful for dark squares ((x + y) odd)
+
+void InitialBitboards(Bitboards &pos); // Sets up the starting position with PLAYER1 to move.
+void GenerateMoves(const Bitboards &pos, MoveList &list); // Lists every full turn (including complete capture chains) for the side to move.
+void MakeMove(Bitboards &pos, const Move &move); // Applies a move generated for pos and passes the turn.
+void UnmakeMove(Bitboards &pos, const Move &move); // Exactly reverses MakeMove.
+
+uint64_t ZobristHash(const Bitboards &pos); // 64-bit position key. The keys come from a fixed seed, so they are stable across builds and can be stored in files.
+uint64_t ZobristAfterMove(uint64_t hash, const Bitboards &pos, const Move &move); // Key after move, computed incrementally from the key of pos (the position before the move).
+
+#endif
@@ -0,0 +1,246 @@
+// @file savefile.cpp
+// @brief Versioned, portable binary save format: a start position plus the list of turns played.
+
+#include "savefile.h"
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+using namespace std;
+
+const uint8_t SAVE_MAGIC[4] = { 'E', 'C', 'H', 'K' };
+const uint8_t LAST_LANDING_FLAG = 0x80; // Marks the final landing square of a turn
+
+// CRC-32 lookup table, built once at startup.
+struct CrcTable {
+    uint32_t entries[256];
+
+    CrcTable() {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t value = i;
+            for (int bit = 0; bit < 8; bit++) {
+                value = (value & 1) ? (value >> 1) ^ 0xEDB88320u : value >> 1;
+            }
+            entries[i] = value;
+        }
+    }
+};
+
+static const CrcTable crcTable;
+
+
+static void PutU16(vector<uint8_t> &out, uint16_t value) {
+    out.push_back((uint8_t)(value & 0xFF));
+    out.push_back((uint8_t)(value >> 8));
+}
+
+
+static void PutU32(vector<uint8_t> &out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out.push_back((uint8_t)((value >> (8 * i)) & 0xFF));
+    }
+}
+
+
+static uint16_t GetU16(const uint8_t *data) {
+    return (uint16_t)(data[0] | (data[1] << 8));
+}
+
+
+static uint32_t GetU32(const uint8_t *data) {
+    return (uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+
+static void SetU32(vector<uint8_t> &out, size_t offset, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out[offset + i] = (uint8_t)((value >> (8 * i)) & 0xFF);
+    }
+}
+
+
+const char *SaveStatusMessage(SaveStatus status) {
+    switch (status) {
+        case SAVE_OK: return "ok";
+        case SAVE_IO_ERROR: return "could not read or write the file";
+        case SAVE_BAD_MAGIC: return "not a checkers save file";
+        case SAVE_BAD_VERSION: return "save file has an unknown version";
+        case SAVE_TRUNCATED: return "save file is truncated or has trailing data";
+        case SAVE_BAD_CHECKSUM: return "save file is corrupted (checksum mismatch)";
+        case SAVE_BAD_POSITION: return "save file contains an impossible position";
+        case SAVE_ILLEGAL_MOVE: return "save file contains an illegal move";
+    }
+    return "unknown error";
+}
+
+
+uint32_t Crc32(const uint8_t *data, size_t size) {
+    return Crc32Update(0, data, size);
+}
+
+
+uint32_t Crc32Update(uint32_t crc, const uint8_t *data, size_t size) {
+    crc ^= 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; i++) {
+        crc = crcTable.entries[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+
+bool IsValidPosition(const Bitboards &pos) {
+    return (pos.pieces[0] & pos.pieces[1]) == 0 &&
+           (pos.kings & ~(pos.pieces[0] | pos.pieces[1])) == 0 &&
+           PopCount(pos.pieces[0]) <= 12 && PopCount(pos.pieces[1]) <= 12 &&
+           pos.sideToMove <= 1;
+}
+
+
+void EncodeMoves(const vector<Move> &moves, vector<uint8_t> &out) {
+    for (size_t i = 0; i < moves.size(); i++) {
+        const Move &move = moves[i];
+        out.push_back(move.from);
+        for (int step = 0; step < move.length; step++) {
+            uint8_t landing = move.path[step];
+            if (step == move.length - 1) {
+                landing |= LAST_LANDING_FLAG;
+            }
+            out.push_back(landing);
+        }
+    }
+}
+
+
+SaveStatus DecodeMoves(const uint8_t *data, size_t size, uint32_t count, const Bitboards &start, vector<Move> &moves, Bitboards &finalPos) {
+    Bitboards pos = start;
+    MoveList list;
+    size_t offset = 0;
+
+    // The count is checked against the data before anything is allocated for it
+    moves.clear();
+    if (count > size / SAVE_MIN_TURN_SIZE) return SAVE_TRUNCATED;
+    moves.reserve(count);
+
+    for (uint32_t turn = 0; turn < count; turn++) {
+        // Read the starting square and landing squares of one turn
+        if (offset >= size) return SAVE_TRUNCATED;
+        uint8_t from = data[offset++];
+        uint8_t path[MAX_CAPTURES];
+        int length = 0;
+        bool finished = false;
+        while (!finished) {
+            if (offset >= size) return SAVE_TRUNCATED;
+            if (length == MAX_CAPTURES) return SAVE_ILLEGAL_MOVE;
+            uint8_t landing = data[offset++];
+            finished = (landing & LAST_LANDING_FLAG) != 0;
+            path[length++] = landing & (uint8_t)~LAST_LANDING_FLAG;
+        }
+
+        // The turn must be one the rules allow in the current position
+        GenerateMoves(pos, list);
+        const Move *match = nullptr;
+        for (int i = 0; i < list.count && match == nullptr; i++) {
+            const Move &candidate = list.moves[i];
+            if (candidate.from == from && candidate.length == length && memcmp(candidate.path, path, length) == 0) {
+                match = &candidate;
+            }
+        }
+        if (match == nullptr) return SAVE_ILLEGAL_MOVE;
+
+        moves.push_back(*match);
+        MakeMove(pos, *match);
+    }
+
+    if (offset != size) return SAVE_TRUNCATED;
+
+    finalPos = pos;
+    return SAVE_OK;
+}
+
+
+// CRC-32 of the 16 header bytes before the checksum and then the payload, so a damaged turn count or flag
+// is caught as well.
+static uint32_t SaveChecksum(const uint8_t *data, size_t size) {
+    uint32_t crc = Crc32(data, SAVE_HEADER_SIZE - 4);
+    return Crc32Update(crc, data + SAVE_HEADER_SIZE, size - SAVE_HEADER_SIZE);
+}
+
+
+void EncodeGameRecord(const GameRecord &record, vector<uint8_t> &out) {
+    Bitboards initial;
+    InitialBitboards(initial);
+    bool customStart = memcmp(&record.start, &initial, sizeof(Bitboards)) != 0;
+
+    out.assign(SAVE_MAGIC, SAVE_MAGIC + 4);
+    PutU16(out, SAVE_VERSION);
+    PutU16(out, customStart ? SAVE_FLAG_CUSTOM_START : 0);
+    PutU32(out, (uint32_t)record.moves.size());
+    PutU32(out, 0); // Payload size, filled in below
+    PutU32(out, 0); // Checksum, filled in below
+
+    if (customStart) {
+        PutU32(out, record.start.pieces[0]);
+        PutU32(out, record.start.pieces[1]);
+        PutU32(out, record.start.kings);
+        out.push_back((uint8_t)record.start.sideToMove);
+    }
+    EncodeMoves(record.moves, out);
+
+    SetU32(out, 12, (uint32_t)(out.size() - SAVE_HEADER_SIZE));
+    SetU32(out, 16, SaveChecksum(out.data(), out.size()));
+}
+
+
+SaveStatus DecodeGameRecord(const uint8_t *data, size_t size, GameRecord &record, Bitboards &finalPos) {
+    if (size < 4 || memcmp(data, SAVE_MAGIC, 4) != 0) return SAVE_BAD_MAGIC;
+    if (size < (size_t)SAVE_HEADER_SIZE) return SAVE_TRUNCATED;
+
+    uint16_t version = GetU16(data + 4);
+    uint16_t flags = GetU16(data + 6);
+    uint32_t count = GetU32(data + 8);
+    uint32_t payloadSize = GetU32(data + 12);
+    uint32_t checksum = GetU32(data + 16);
+
+    if (version == 0 || version > SAVE_VERSION) return SAVE_BAD_VERSION;
+    if (payloadSize != size - SAVE_HEADER_SIZE) return SAVE_TRUNCATED;
+
+    const uint8_t *payload = data + SAVE_HEADER_SIZE;
+    uint32_t expected = (version >= 2) ? SaveChecksum(data, size) : Crc32(payload, payloadSize);
+    if (expected != checksum) return SAVE_BAD_CHECKSUM;
+
+    size_t offset = 0;
+    if (flags & SAVE_FLAG_CUSTOM_START) {
+        if (payloadSize < 13) return SAVE_TRUNCATED;
+        record.start.pieces[0] = GetU32(payload);
+        record.start.pieces[1] = GetU32(payload + 4);
+        record.start.kings = GetU32(payload + 8);
+        record.start.sideToMove = payload[12];
+        offset = 13;
+        if (!IsValidPosition(record.start)) return SAVE_BAD_POSITION;
+    } else {
+        InitialBitboards(record.start);
+    }
+
+    return DecodeMoves(payload + offset, payloadSize - offset, count, record.start, record.moves, finalPos);
+}
+
+
+SaveStatus WriteGameRecordFile(const GameRecord &record, const string &filename) {
+    vector<uint8_t> bytes;
+    EncodeGameRecord(record, bytes);
+
+    ofstream outFile(filename, ios::binary);
+    if (!outFile.is_open()) return SAVE_IO_ERROR;
+    outFile.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+    return outFile.good() ? SAVE_OK : SAVE_IO_ERROR;
+}
+
+
+SaveStatus ReadGameRecordFile(const string &filename, GameRecord &record, Bitboards &finalPos) {
+    ifstream inFile(filename, ios::binary);
+    if (!inFile.is_open()) return SAVE_IO_ERROR;
+
+    vector<uint8_t> bytes((istreambuf_iterator<char>(inFile)), istreambuf_iterator<char>());
+    if (inFile.bad()) return SAVE_IO_ERROR;
+    return DecodeGameRecord(bytes.data(), bytes.size(), record, finalPos);
+}
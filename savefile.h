@@ -0,0 +1,55 @@
+// @file savefile.h
+// @brief Versioned, portable binary save format: a start position plus the list of turns played.
+//
+// Layout (all integers little-endian):
+//   header  (16 bytes): "ECHK", u16 version, u16 flags, u32 turn count, u32 payload size
+//   checksum (4 bytes): CRC-32 of the header followed by the payload (version 1: of the payload only)
+//   payload:            [start position if SAVE_FLAG_CUSTOM_START: u32 PLAYER1, u32 PLAYER2, u32 kings, u8 side]
+//                       then every turn as its starting square followed by its landing squares,
+//                       one byte each, with bit 7 set on the last landing square of the turn.
+
+#ifndef SAVEFILE_H
+#define SAVEFILE_H
+
+#include "rules.h"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+const uint16_t SAVE_VERSION = 2;        // Current version of the save format
+const int SAVE_MIN_TURN_SIZE = 2;       // Bytes of the shortest encoded turn: the starting square and one landing
+const uint16_t SAVE_FLAG_CUSTOM_START = 1; // The game does not start from the initial position
+const int SAVE_HEADER_SIZE = 20;        // Header plus checksum
+
+enum SaveStatus {
+    SAVE_OK,
+    SAVE_IO_ERROR,
+    SAVE_BAD_MAGIC,
+    SAVE_BAD_VERSION,
+    SAVE_TRUNCATED,
+    SAVE_BAD_CHECKSUM,
+    SAVE_BAD_POSITION,
+    SAVE_ILLEGAL_MOVE
+};
+
+// A game as it is stored: where it started and every completed turn since.
+struct GameRecord {
+    Bitboards start;
+    std::vector<Move> moves;
+};
+
+const char *SaveStatusMessage(SaveStatus status); // Human readable description of a status.
+uint32_t Crc32(const uint8_t *data, size_t size); // Standard CRC-32 (as used by zip and png).
+uint32_t Crc32Update(uint32_t crc, const uint8_t *data, size_t size); // Continues a CRC-32 over more data: Crc32Update(Crc32(a), b) is the CRC of a followed by b.
+
+bool IsValidPosition(const Bitboards &pos); // Checks that a position could exist (no overlaps, at most 12 pieces a side).
+void EncodeMoves(const std::vector<Move> &moves, std::vector<uint8_t> &out); // Appends the compact turn encoding.
+SaveStatus DecodeMoves(const uint8_t *data, size_t size, uint32_t count, const Bitboards &start, std::vector<Move> &moves, Bitboards &finalPos); // Replays and validates encoded turns.
+
+void EncodeGameRecord(const GameRecord &record, std::vector<uint8_t> &out); // Serializes a whole save file into out.
+SaveStatus DecodeGameRecord(const uint8_t *data, size_t size, GameRecord &record, Bitboards &finalPos); // Parses and validates a save file.
+
+SaveStatus WriteGameRecordFile(const GameRecord &record, const std::string &filename);
+SaveStatus ReadGameRecordFile(const std::string &filename, GameRecord &record, Bitboards &finalPos);
+
+#endif
@@ -0,0 +1,169 @@
+// @file benchstats.cpp
+// @brief Summary statistics for repeated benchmark timings.
+
+#include "benchstats.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+
+using namespace std;
+
+const double CONFIDENCE_95 = 1.959963984540054; // Two-sided 95% quantile of the normal distribution
+
+// Two-sided 95% critical values of Student's t for 1 to 30 degrees of freedom
+const double STUDENT_T95[30] = {
+    12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+    2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+    2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+};
+
+
+double StudentT95(int degreesOfFreedom) {
+    if (degreesOfFreedom < 1) return 0.0;
+    if (degreesOfFreedom <= 30) return STUDENT_T95[degreesOfFreedom - 1];
+    return CONFIDENCE_95 + 2.5 / degreesOfFreedom; // Within 0.01 of the exact value above 30
+}
+
+
+BenchSummary SummariseSamples(vector<double> samples) {
+    BenchSummary summary;
+    summary.samples = (int)samples.size();
+    sort(samples.begin(), samples.end());
+
+    double sum = 0.0;
+    for (double sample : samples) sum += sample;
+    summary.mean = sum / summary.samples;
+
+    double squares = 0.0;
+    for (double sample : samples) squares += (sample - summary.mean) * (sample - summary.mean);
+    summary.stddev = (summary.samples > 1) ? sqrt(squares / (summary.samples - 1)) : 0.0;
+    summary.ci95 = StudentT95(summary.samples - 1) * summary.stddev / sqrt((double)summary.samples);
+
+    int middle = summary.samples / 2;
+    summary.median = (summary.samples % 2 == 1) ? samples[middle] : (samples[middle - 1] + samples[middle]) / 2.0;
+    summary.min = samples[0];
+    return summary;
+}
+
+
+// Quantile of sorted values, interpolating between neighbours.
+static double Quantile(const vector<double> &sorted, double fraction) {
+    double position = fraction * (sorted.size() - 1);
+    size_t below = (size_t)position;
+    if (below + 1 >= sorted.size()) return sorted.back();
+    return sorted[below] + (sorted[below + 1] - sorted[below]) * (position - below);
+}
+
+
+BenchRuns SummariseRuns(vector<double> runMedians) {
+    BenchRuns runs;
+    sort(runMedians.begin(), runMedians.end());
+    runs.medians = runMedians;
+    runs.median = Quantile(runMedians, 0.5);
+    runs.spread = (Quantile(runMedians, 0.75) - Quantile(runMedians, 0.25)) / runs.median;
+    return runs;
+}
+
+
+// U counts the pairs (x from lower, y from higher) with y above x, ties counting half. Its exact distribution
+// when both come from the same distribution is the number of orderings of the n and m values with each count
+// of such pairs, built up one value at a time. A half from a tie is rounded down, which errs towards no change.
+double MannWhitneyP(const vector<double> &lower, const vector<double> &higher) {
+    int n = (int)lower.size();
+    int m = (int)higher.size();
+    if (n == 0 || m == 0) return 1.0;
+
+    double u = 0.0;
+    for (double x : lower) {
+        for (double y : higher) {
+            u += (y > x) ? 1.0 : (y == x) ? 0.5 : 0.0;
+        }
+    }
+
+    // previous[j][k] and current[j][k]: orderings of i - 1 and i lower values with j higher ones and k pairs
+    vector<vector<double>> previous(m + 1), current(m + 1);
+    for (int j = 0; j <= m; j++) previous[j].assign(1, 1.0);   // No lower values: U is 0
+    for (int i = 1; i <= n; i++) {
+        current[0].assign(1, 1.0);
+        for (int j = 1; j <= m; j++) {
+            // The smallest value is a lower one, below all j higher ones, or a higher one, which adds no pair
+            current[j].assign(i * j + 1, 0.0);
+            for (int k = 0; k <= i * j; k++) {
+                if (k - j >= 0 && k - j < (int)previous[j].size()) current[j][k] += previous[j][k - j];
+                if (k < (int)current[j - 1].size()) current[j][k] += current[j - 1][k];
+            }
+        }
+        swap(previous, current);
+    }
+
+    const vector<double> &counts = previous[m];
+    double total = 0.0, atLeast = 0.0;
+    for (int k = 0; k < (int)counts.size(); k++) {
+        total += counts[k];
+        if (k >= (int)floor(u)) atLeast += counts[k];
+    }
+    return atLeast / total;
+}
+
+
+bool ReadBenchResults(const string &path, vector<BenchResult> &results) {
+    ifstream file(path);
+    if (!file.is_open()) return false;
+
+    string line;
+    getline(file, line); // Column names
+    while (getline(file, line)) {
+        if (line.empty()) continue;
+        size_t comma = line.find(',');
+        if (comma == string::npos) return false;
+
+        BenchResult result;
+        result.name = line.substr(0, comma);
+        BenchSummary &summary = result.summary;
+        int runCount = 0;
+        double runMedian = 0.0, runSpread = 0.0;
+        int used = 0;
+        if (sscanf(line.c_str() + comma + 1, "%d,%lf,%lf,%lf,%lf,%lf,%d,%lf,%lf,%n", &summary.samples, &summary.mean,
+                   &summary.stddev, &summary.ci95, &summary.median, &summary.min, &runCount, &runMedian, &runSpread,
+                   &used) != 9 || used == 0 || runCount < 1) {
+            return false;  // Also files from before every run median was kept, which cannot be tested against
+        }
+
+        vector<double> medians;
+        const char *cursor = line.c_str() + comma + 1 + used;
+        for (int run = 0; run < runCount; run++) {
+            char *end;
+            double value = strtod(cursor, &end);
+            if (end == cursor) return false;
+            medians.push_back(value);
+            cursor = end;
+        }
+        result.runs = SummariseRuns(medians);
+        results.push_back(result);
+    }
+    return true;
+}
+
+
+const BenchResult *FindBenchResult(const vector<BenchResult> &results, const string &name) {
+    for (const BenchResult &result : results) {
+        if (result.name == name) return &result;
+    }
+    return nullptr;
+}
+
+
+BenchVerdict CompareWithBaseline(const BenchRuns &baseline, const BenchRuns &current, double threshold) {
+    const double significance = 0.05;
+    double change = current.median / baseline.median - 1.0;
+    if (change > threshold && MannWhitneyP(baseline.medians, current.medians) < significance) return BENCH_SLOWER;
+    if (change < -threshold && MannWhitneyP(current.medians, baseline.medians) < significance) return BENCH_FASTER;
+    return BENCH_UNCHANGED;
+}
+
+
+bool BenchRunsTooNoisy(const BenchRuns &runs, double threshold) {
+    return runs.spread > threshold;
+}
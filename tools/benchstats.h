@@ -0,0 +1,54 @@
+// @file benchstats.h
+// @brief Summary statistics for repeated benchmark timings.
+
+#ifndef BENCHSTATS_H
+#define BENCHSTATS_H
+
+#include <string>
+#include <vector>
+
+// Nanoseconds per operation over the samples of one benchmark.
+struct BenchSummary {
+    int samples;
+    double mean;
+    double stddev;      // Sample standard deviation
+    double ci95;        // Half-width of the 95% confidence interval of the mean (Student's t)
+    double median;
+    double min;
+};
+
+// The same benchmark measured in several runs of the whole suite, by the median of each run. Timings drift
+// from one run to the next (frequency scaling, other programs, where the code landed in memory) far more than
+// the samples within a run vary, so runs are what a comparison has to look at.
+struct BenchRuns {
+    std::vector<double> medians;    // Median of every run, sorted
+    double median;                  // Median of the run medians
+    double spread;                  // Interquartile range of the run medians, as a fraction of their median
+};
+
+// One line of a results file: name,samples,mean_ns,stddev_ns,ci95_ns,median_ns,min_ns,runs,run_median_ns,
+// run_spread,run_medians_ns. The sample columns cover the samples of all runs together; the last column lists
+// every run median, separated by spaces.
+struct BenchResult {
+    std::string name;
+    BenchSummary summary;
+    BenchRuns runs;
+};
+
+enum BenchVerdict { BENCH_UNCHANGED, BENCH_FASTER, BENCH_SLOWER };
+
+double StudentT95(int degreesOfFreedom); // Two-sided 95% critical value of Student's t distribution.
+BenchSummary SummariseSamples(std::vector<double> samples); // Samples in ns/op; needs at least one.
+BenchRuns SummariseRuns(std::vector<double> runMedians); // Needs at least one run.
+double MannWhitneyP(const std::vector<double> &lower, const std::vector<double> &higher); // One-sided exact p-value that `higher` tends to lie above `lower`.
+
+bool ReadBenchResults(const std::string &path, std::vector<BenchResult> &results); // Reads a file written with --csv.
+const BenchResult *FindBenchResult(const std::vector<BenchResult> &results, const std::string &name);
+
+// A change counts only if the median run moved by more than `threshold` (0.05 for 5%) and the Mann-Whitney U
+// test on the run medians says the shift is not noise at the 95% level. A test on the run medians reaches any
+// threshold as long as both sides vary less than it between runs, which is what BenchRunsTooNoisy checks.
+BenchVerdict CompareWithBaseline(const BenchRuns &baseline, const BenchRuns &current, double threshold);
+bool BenchRunsTooNoisy(const BenchRuns &runs, double threshold); // The run medians spread wider than `threshold`, so a change of that size cannot be told from noise.
+
+#endif
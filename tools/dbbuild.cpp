@@ -0,0 +1,69 @@
+// @file dbbuild.cpp
+// @brief Builds a memory-mapped game database (see gamedb.h) from PDN files.
+//
+// Usage: dbbuild [--run-entries N] out.ecdb games.pdn [more.pdn ...]
+
+#include "../gamedb.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+
+int main(int argc, char **argv) {
+    size_t runEntries = DB_DEFAULT_RUN_ENTRIES;
+    int arg = 1;
+    if (arg + 1 < argc && strcmp(argv[arg], "--run-entries") == 0) {
+        runEntries = (size_t)strtoull(argv[arg + 1], nullptr, 10);
+        arg += 2;
+    }
+    if (argc - arg < 2) {
+        cerr << "Usage: dbbuild [--run-entries N] out.ecdb games.pdn [more.pdn ...]\n";
+        return 2;
+    }
+
+    string error;
+    GameDatabaseWriter writer;
+    if (!BeginGameDatabase(writer, argv[arg], runEntries, error)) {
+        cerr << "Error: " << error << "\n";
+        return 1;
+    }
+
+    auto started = chrono::steady_clock::now();
+    long long skipped = 0;
+    PdnReader *reader = new PdnReader; // Holds the read buffer, too large for the stack
+    PdnGame game;
+
+    for (int i = arg + 1; i < argc; i++) {
+        ifstream file(argv[i], ios::binary);
+        if (!file.is_open()) {
+            cerr << "Error: Could not open " << argv[i] << "\n";
+            return 1;
+        }
+
+        InitPdnReader(*reader, file);
+        PdnStatus status;
+        while ((status = ReadPdnGame(*reader, game)) != PDN_END) {
+            if (status != PDN_GAME_OK) {
+                cerr << argv[i] << ":" << reader->gameLine << ": skipped: " << reader->error << "\n";
+                skipped++;
+            } else if (!AddDatabaseGame(writer, game.record, game.result, error)) {
+                cerr << argv[i] << ":" << reader->gameLine << ": skipped: " << error << "\n";
+                skipped++;
+            }
+        }
+    }
+    delete reader;
+
+    size_t games = writer.games.size();
+    if (!FinishGameDatabase(writer, error)) {
+        cerr << "Error: " << error << "\n";
+        return 1;
+    }
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+    cout << "Stored " << games << " games (" << skipped << " skipped) in " << argv[arg] << " in " << seconds << " s\n";
+    return 0;
+}
@@ -0,0 +1,96 @@
+// @file dbquery.cpp
+// @brief Looks up which games in a database reached a position.
+//
+// Usage: dbquery db.ecdb (--fen "B:W21,22:B1,2" | --moves "11-15 24-19") [--limit N] [--verify]
+
+#include "../gamedb.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+
+int main(int argc, char **argv) {
+    if (argc < 4) {
+        cerr << "Usage: dbquery db.ecdb (--fen FEN | --moves \"11-15 24-19\") [--limit N] [--verify]\n";
+        return 2;
+    }
+
+    Bitboards pos;
+    size_t limit = 20;
+    bool verify = false;
+    bool havePosition = false;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--fen") == 0 && i + 1 < argc) {
+            if (!ParsePdnFen(argv[++i], pos)) {
+                cerr << "Error: invalid FEN\n";
+                return 2;
+            }
+            havePosition = true;
+        } else if (strcmp(argv[i], "--moves") == 0 && i + 1 < argc) {
+            // Reuse the PDN reader to replay the moves from the start
+            istringstream text(string(argv[++i]) + " *");
+            PdnReader *reader = new PdnReader;
+            PdnGame game;
+            InitPdnReader(*reader, text);
+            PdnStatus status = ReadPdnGame(*reader, game);
+            if (status == PDN_GAME_INVALID) {
+                cerr << "Error: " << reader->error << "\n";
+                delete reader;
+                return 2;
+            }
+            delete reader;
+            pos = game.finalPos;
+            havePosition = true;
+        } else if (strcmp(argv[i], "--limit") == 0 && i + 1 < argc) {
+            limit = (size_t)strtoull(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--verify") == 0) {
+            verify = true;
+        } else {
+            cerr << "Unknown option " << argv[i] << "\n";
+            return 2;
+        }
+    }
+    if (!havePosition) {
+        cerr << "Error: give a position with --fen or --moves\n";
+        return 2;
+    }
+
+    GameDatabase db;
+    string error;
+    if (!OpenGameDatabase(db, argv[1], error)) {
+        cerr << "Error: " << error << "\n";
+        return 1;
+    }
+
+    uint64_t key = ZobristHash(pos);
+    auto started = chrono::steady_clock::now();
+    const DbIndexEntry *first = nullptr;
+    size_t count = FindPosition(db, key, first);
+    double micros = chrono::duration<double, micro>(chrono::steady_clock::now() - started).count();
+
+    cout << FormatPdnFen(pos) << ": " << count << " of " << db.header->gameCount << " games (" << micros << " us)\n";
+    for (size_t i = 0; i < count && i < limit; i++) {
+        const DbIndexEntry &entry = first[i];
+        cout << "  game " << entry.game << "  ply " << entry.ply << "  result " << PdnResultString((PdnResult)db.games[entry.game].result);
+
+        // Rule out key collisions by replaying the game up to the ply
+        if (verify) {
+            GameRecord record;
+            Bitboards finalPos;
+            bool same = false;
+            if (ReadDatabaseGame(db, entry.game, record, finalPos)) {
+                Bitboards replay = record.start;
+                for (int ply = 0; ply < entry.ply; ply++) MakeMove(replay, record.moves[ply]);
+                same = memcmp(&replay, &pos, sizeof(Bitboards)) == 0;
+            }
+            cout << (same ? "  verified" : "  KEY COLLISION");
+        }
+        cout << "\n";
+    }
+
+    CloseGameDatabase(db);
+    return 0;
+}
@@ -0,0 +1,92 @@
+// @file gameserver.cpp
+// @brief Headless game server: pairs up players who send PLAY and relays their checked moves (protocol.h).
+//
+// Runs until interrupted and prints a line of statistics every --stats seconds, and the totals on exit
+// with the CPU time used, so throughput per core can be read off directly.
+//
+// Listens on 127.0.0.1 unless --bind names another address, such as 0.0.0.0 for every interface.
+//
+// Usage: gameserver [--bind ADDRESS] [--port P] [--stats SECONDS]
+
+#include "server.h"
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sys/resource.h>
+
+using namespace std;
+
+static volatile sig_atomic_t stopRequested = 0;
+
+static void RequestStop(int) {
+    stopRequested = 1;
+}
+
+
+static double CpuSeconds() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+
+static void PrintStats(const GameServer &server, double seconds) {
+    const ServerStats &stats = server.stats;
+    cout << seconds << " s: " << stats.connectionsOpen << " connections, "
+         << (stats.gamesStarted - stats.gamesFinished) << " games running (" << server.store.games.size() << " slots), "
+         << stats.gamesFinished << " finished, " << stats.movesPlayed << " moves, " << stats.movesRejected << " rejected, " << stats.resyncs << " resyncs, "
+         << stats.slowDisconnects << " slow clients dropped, " << stats.bytesIn << " bytes in, " << stats.bytesOut << " out\n"
+         << "  " << stats.watchers << " watchers, " << stats.feedMessages << " feed messages, " << stats.snapshots << " snapshots, "
+         << stats.watchersBehind << " times a watcher fell behind, " << server.chunks.size() << " feed chunks\n";
+}
+
+
+int main(int argc, char **argv) {
+    const char *bindAddress = "127.0.0.1";
+    int port = PROTOCOL_PORT;
+    double statsSeconds = 10.0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--bind") == 0 && i + 1 < argc) {
+            bindAddress = argv[++i];
+        } else if (strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
+            port = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--stats") == 0 && i + 1 < argc) {
+            statsSeconds = atof(argv[++i]);
+        } else {
+            cerr << "Usage: gameserver [--bind ADDRESS] [--port P] [--stats SECONDS]\n";
+            return 2;
+        }
+    }
+
+    GameServer server;
+    string error;
+    if (!StartServer(server, bindAddress, port, error)) {
+        cerr << "Error: Could not listen on " << bindAddress << " port " << port << ": " << error << "\n";
+        return 1;
+    }
+    signal(SIGINT, RequestStop);
+    signal(SIGTERM, RequestStop);
+    cout << "Listening on " << bindAddress << " port " << server.port << "\n" << flush;
+
+    auto start = chrono::steady_clock::now();
+    double nextStats = statsSeconds;
+    while (!stopRequested) {
+        PollServer(server, 100);
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        if (statsSeconds > 0.0 && seconds >= nextStats) {
+            PrintStats(server, seconds);
+            cout << flush;
+            nextStats += statsSeconds;
+        }
+    }
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    double cpu = CpuSeconds();
+    PrintStats(server, seconds);
+    cout << "CPU time " << cpu << " s, " << (long long)(server.stats.movesPlayed / max(cpu, 1e-9)) << " moves per CPU second\n";
+    StopServer(server);
+    return 0;
+}
@@ -0,0 +1,173 @@
+// @file inputreplay.cpp
+// @brief Replays recorded input sessions (input.h) without a window, as fast as the rules allow, and checks
+// that every session still ends in the position it was recorded with.
+//
+// Each frame is handled the way the main loop in checkers.cpp handles it: a click goes to ApplyClick, Z and Y
+// undo and redo, R restarts and Q quits once the game is over. Saving and loading use an in-memory slot
+// instead of checkers_save.dat, so a load only works after a save earlier in the same session. Frames
+// without input are skipped. The exit status is 1 if any session could not be read or ended elsewhere.
+//
+// Usage: inputreplay [--repeat N] [--quiet] session.txt [more.txt ...]
+
+#include "../gamestate.h"
+#include "../input.h"
+#include "../pdn.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+struct ReplayTotals {
+    long long sessions;
+    long long frames;       // Frames with input
+    long long clicks;
+    long long turns;        // Turns completed, including redone ones
+    long long failures;
+};
+
+// The state of one session being replayed.
+struct ReplaySession {
+    GameState gameState;
+    GameRecord saved;       // What S saved, for L
+    bool hasSaved;
+    int unmatchedLoads;     // L pressed before anything was saved in this session
+};
+
+
+// One frame of checkers.cpp's main loop, minus drawing, journaling and files. Returns false on quit.
+static bool ReplayFrame(ReplaySession &session, const InputFrame &input, ReplayTotals &totals) {
+    GameState &gameState = session.gameState;
+    size_t turnsBefore = gameState.moveHistory.size();
+
+    if (!gameState.gameOver) {
+        if (input.clicked) {
+            ApplyClick(gameState, input.mouseX / CELL_SIZE, input.mouseY / CELL_SIZE);
+            totals.clicks++;
+        }
+        if (InputKeyPressed(input, INPUT_KEY_Z)) {
+            UndoMove(gameState);
+        }
+        if (InputKeyPressed(input, INPUT_KEY_Y)) {
+            RedoMove(gameState);
+        }
+        if (InputKeyPressed(input, INPUT_KEY_S)) {
+            session.saved.start = gameState.startPosition;
+            session.saved.moves = gameState.moveHistory;
+            session.hasSaved = true;
+        }
+        if (InputKeyPressed(input, INPUT_KEY_L)) {
+            if (session.hasSaved) {
+                GameRecordToGameState(session.saved, gameState);
+            } else {
+                session.unmatchedLoads++;
+            }
+        }
+    }
+    if (gameState.moveHistory.size() > turnsBefore) {
+        totals.turns += gameState.moveHistory.size() - turnsBefore;
+    }
+
+    if (gameState.gameOver) {
+        if (InputKeyPressed(input, INPUT_KEY_Q)) {
+            return false;
+        }
+        if (InputKeyPressed(input, INPUT_KEY_R)) {
+            InitializeGame(gameState);
+        }
+    }
+    return true;
+}
+
+
+// Plays the whole script and returns the position it ends in.
+static string ReplayScript(const InputScript &script, ReplaySession &session, ReplayTotals &totals) {
+    InitializeGame(session.gameState);
+    if (script.hasStart) {
+        GameRecordToGameState(script.start, session.gameState);
+    }
+    session.hasSaved = false;
+    session.unmatchedLoads = 0;
+
+    InputSource source;
+    ScriptedInput scripted;
+    InitScriptedInput(source, scripted, script, true);
+    InputFrame input;
+    while (source.readFrame(source.context, input)) {
+        totals.frames++;
+        if (!ReplayFrame(session, input, totals)) break;
+    }
+
+    Bitboards pos;
+    GameStateToBitboards(session.gameState, pos);
+    return FormatPdnFen(pos);
+}
+
+
+int main(int argc, char **argv) {
+    int repeat = 1;
+    bool quiet = false;
+    int firstFile = 1;
+    while (firstFile < argc && argv[firstFile][0] == '-' && argv[firstFile][1] == '-') {
+        if (strcmp(argv[firstFile], "--repeat") == 0 && firstFile + 1 < argc) {
+            repeat = atoi(argv[firstFile + 1]);
+            firstFile += 2;
+        } else if (strcmp(argv[firstFile], "--quiet") == 0) {
+            quiet = true;
+            firstFile++;
+        } else {
+            cerr << "Unknown option " << argv[firstFile] << "\n";
+            return 2;
+        }
+    }
+    if (firstFile >= argc || repeat < 1) {
+        cerr << "Usage: inputreplay [--repeat N] [--quiet] session.txt [more.txt ...]\n";
+        return 2;
+    }
+
+    // Read everything first, so the timing below is only the replay
+    vector<InputScript> scripts(argc - firstFile);
+    vector<bool> readable(argc - firstFile);
+    ReplayTotals totals = {};
+    for (int i = firstFile; i < argc; i++) {
+        string error;
+        readable[i - firstFile] = ReadInputScript(argv[i], scripts[i - firstFile], error);
+        if (!readable[i - firstFile]) {
+            cout << argv[i] << ": " << error << "\n";
+            totals.failures++;
+        }
+    }
+
+    ReplaySession session;
+    auto startTime = chrono::steady_clock::now();
+    for (int round = 0; round < repeat; round++) {
+        for (int i = firstFile; i < argc; i++) {
+            if (!readable[i - firstFile]) continue;
+            const InputScript &script = scripts[i - firstFile];
+
+            string endFen = ReplayScript(script, session, totals);
+            totals.sessions++;
+            if (round > 0) continue;
+
+            bool matches = script.endFen.empty() || endFen == script.endFen;
+            if (!matches) totals.failures++;
+            if (!matches || !quiet) {
+                cout << argv[i] << ": " << script.events.size() << " frames with input, ended in " << endFen;
+                if (!matches) cout << ", recorded " << script.endFen << "  MISMATCH";
+                if (script.endFen.empty()) cout << " (no end position recorded)";
+                if (session.unmatchedLoads > 0) cout << " (" << session.unmatchedLoads << " loads of a game saved before the session)";
+                cout << "\n";
+            }
+        }
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+
+    cout << totals.sessions << " sessions replayed, " << totals.failures << " failed: " << totals.frames << " frames, "
+         << totals.clicks << " clicks, " << totals.turns << " turns in " << seconds * 1000.0 << " ms ("
+         << (long long)(totals.frames / max(seconds, 1e-9)) << " frames/s)\n";
+    return (totals.failures > 0) ? 1 : 0;
+}
@@ -0,0 +1,171 @@
+// @file match.cpp
+// @brief Self-play match runner: plays paired openings between two engine settings and stops early with an SPRT.
+//
+// Usage: match [--depth-a N] [--depth-b N] [--no-advancement-b] [--elo0 E] [--elo1 E]
+//              [--alpha A] [--beta B] [--max-pairs N] [--opening-plies N] [--max-plies N] [--seed S]
+
+#include "../rules.h"
+#include "../engine.h"
+#include "sprt.h"
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <iomanip>
+#include <random>
+
+using namespace std;
+
+const int MAX_OPENING_ATTEMPTS = 1000;  // Random openings tried in a row before giving up on finding one that is still open
+
+// Everything the runner can be told on the command line.
+struct MatchOptions {
+    EngineConfig engineA;   // The engine under test
+    EngineConfig engineB;   // The reference engine
+    SprtConfig sprt;
+    long long maxPairs;     // Stop after this many game pairs even without an SPRT decision
+    int openingPlies;       // Random plies played before the engines take over
+    int maxPlies;           // Games longer than this are adjudicated as draws
+    unsigned seed;          // Seed for the random openings
+};
+
+
+static bool ParseOptions(int argc, char **argv, MatchOptions &options) {
+    options.engineA.depth = 4;
+    options.engineA.useAdvancement = true;
+    options.engineB.depth = 3;
+    options.engineB.useAdvancement = true;
+    options.sprt.elo0 = 0.0;
+    options.sprt.elo1 = 10.0;
+    options.sprt.alpha = 0.05;
+    options.sprt.beta = 0.05;
+    options.maxPairs = 20000;
+    options.openingPlies = 4;
+    options.maxPlies = 200;
+    options.seed = 1;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+        bool takesValue = true;
+
+        if (strcmp(arg, "--no-advancement-a") == 0) { options.engineA.useAdvancement = false; takesValue = false; }
+        else if (strcmp(arg, "--no-advancement-b") == 0) { options.engineB.useAdvancement = false; takesValue = false; }
+        else if (value == nullptr) { cerr << "Missing value for " << arg << "\n"; return false; }
+        else if (strcmp(arg, "--depth-a") == 0) options.engineA.depth = atoi(value);
+        else if (strcmp(arg, "--depth-b") == 0) options.engineB.depth = atoi(value);
+        else if (strcmp(arg, "--elo0") == 0) options.sprt.elo0 = atof(value);
+        else if (strcmp(arg, "--elo1") == 0) options.sprt.elo1 = atof(value);
+        else if (strcmp(arg, "--alpha") == 0) options.sprt.alpha = atof(value);
+        else if (strcmp(arg, "--beta") == 0) options.sprt.beta = atof(value);
+        else if (strcmp(arg, "--max-pairs") == 0) options.maxPairs = atoll(value);
+        else if (strcmp(arg, "--opening-plies") == 0) options.openingPlies = atoi(value);
+        else if (strcmp(arg, "--max-plies") == 0) options.maxPlies = atoi(value);
+        else if (strcmp(arg, "--seed") == 0) options.seed = (unsigned)strtoul(value, nullptr, 10);
+        else { cerr << "Unknown option " << arg << "\n"; return false; }
+
+        if (takesValue) i++;
+    }
+
+    if (options.sprt.elo1 <= options.sprt.elo0 || options.sprt.alpha <= 0.0 || options.sprt.beta <= 0.0 ||
+        options.sprt.alpha >= 1.0 || options.sprt.beta >= 1.0) {
+        cerr << "Invalid SPRT settings: need elo0 < elo1 and 0 < alpha, beta < 1\n";
+        return false;
+    }
+    return true;
+}
+
+
+// Plays random moves from the start to get a varied opening. Returns false if the game ended during the opening.
+static bool RandomOpening(mt19937 &random, int plies, Bitboards &pos) {
+    InitialBitboards(pos);
+    MoveList list;
+    for (int ply = 0; ply < plies; ply++) {
+        GenerateMoves(pos, list);
+        if (list.count == 0) return false;
+        MakeMove(pos, list.moves[random() % list.count]);
+    }
+    GenerateMoves(pos, list);
+    return list.count > 0;
+}
+
+
+// Plays one game from `start`. Returns the result for `first` (the side to move at the start) in half points.
+static int PlayGame(const Bitboards &start, const EngineConfig &first, const EngineConfig &second, int maxPlies) {
+    Bitboards pos = start;
+    uint32_t firstSide = start.sideToMove;
+
+    for (int ply = 0; ply < maxPlies; ply++) {
+        const EngineConfig &engine = (pos.sideToMove == firstSide) ? first : second;
+        Move move;
+        if (!FindBestMove(pos, engine, move)) {
+            return (pos.sideToMove == firstSide) ? 0 : 2;  // The side to move has no moves and loses
+        }
+        MakeMove(pos, move);
+    }
+    return 1;  // Adjudicated draw
+}
+
+
+int main(int argc, char **argv) {
+    MatchOptions options;
+    if (!ParseOptions(argc, argv, options)) {
+        return 2;
+    }
+
+    MatchStats stats;
+    ResetMatchStats(stats);
+    mt19937 random(options.seed);
+    SprtResult result = SPRT_CONTINUE;
+    double llr = 0.0, lower, upper;
+    SprtBounds(options.sprt, lower, upper);
+
+    cout << fixed << setprecision(2);
+    cout << "Engine A depth " << options.engineA.depth << " vs engine B depth " << options.engineB.depth
+         << ", SPRT elo0=" << options.sprt.elo0 << " elo1=" << options.sprt.elo1
+         << " alpha=" << options.sprt.alpha << " beta=" << options.sprt.beta
+         << " bounds [" << lower << ", " << upper << "]\n";
+
+    long long pairs = 0;
+    while (pairs < options.maxPairs && result == SPRT_CONTINUE) {
+        Bitboards opening;
+        int attempts = 1;
+        while (!RandomOpening(random, options.openingPlies, opening)) {
+            if (++attempts > MAX_OPENING_ATTEMPTS) {
+                cerr << "Error: " << MAX_OPENING_ATTEMPTS << " random openings of " << options.openingPlies
+                     << " plies in a row ended the game; try fewer --opening-plies\n";
+                return 2;
+            }
+        }
+
+        // Same opening twice with colours swapped, both results from engine A's point of view
+        int firstGame = PlayGame(opening, options.engineA, options.engineB, options.maxPlies);
+        int secondGame = 2 - PlayGame(opening, options.engineB, options.engineA, options.maxPlies);
+        AddGamePair(stats, firstGame, secondGame);
+        pairs++;
+
+        result = SprtDecide(stats, options.sprt, llr);
+        if (pairs % 50 == 0) {
+            cout << "Pairs " << pairs << "  LLR " << llr << "\n";
+        }
+    }
+
+    EloEstimate trinomial = EstimateEloTrinomial(stats);
+    EloEstimate pentanomial = EstimateEloPentanomial(stats);
+
+    cout << "Games: " << 2 * pairs << "  W/D/L: " << stats.wins << "/" << stats.draws << "/" << stats.losses << "\n";
+    cout << "Pentanomial [0, 0.5, 1, 1.5, 2]: [" << stats.pentanomial[0] << ", " << stats.pentanomial[1] << ", "
+         << stats.pentanomial[2] << ", " << stats.pentanomial[3] << ", " << stats.pentanomial[4] << "]\n";
+    cout << "Elo (trinomial):   " << trinomial.elo << " +/- " << trinomial.margin << "  LOS " << 100.0 * trinomial.los << "%\n";
+    cout << "Elo (pentanomial): " << pentanomial.elo << " +/- " << pentanomial.margin << "  LOS " << 100.0 * pentanomial.los << "%\n";
+    cout << "LLR " << llr << " [" << lower << ", " << upper << "]: ";
+
+    if (result == SPRT_ACCEPT_H1) {
+        cout << "H1 accepted\n";
+        return 0;
+    } else if (result == SPRT_ACCEPT_H0) {
+        cout << "H0 accepted\n";
+        return 1;
+    }
+    cout << "inconclusive after " << pairs << " pairs\n";
+    return 3;
+}
@@ -0,0 +1,260 @@
+// @file netplay.cpp
+// @brief End-to-end test of online play: pairs of network clients (netclient.h) play each other through a
+// game server, clicking their turns on the board the way the window does.
+//
+// Every client runs the game's own frame loop without drawing: it clicks through a random legal turn with
+// ApplyClick when NetworkMayMove allows it, then calls UpdateNetworkGame, which sends the turn and applies
+// the opponent's. A frame is run every millisecond. When a game ends, both players must have the same
+// position and move history, and the next game is asked for with RequestNetworkGame. Each player also keeps
+// the turns a move journal would hold, taking back what UpdateNetworkGame takes back the way checkers.cpp
+// does, and these must always match its move history.
+//
+// To exercise rollback, --out-of-turn-rate clicks that fraction of turns a second turn straight after, before
+// the opponent has answered, which the server refuses; --corrupt-rate alters that fraction of sent turns that
+// are not confirmed yet, so the server's echo differs and the client must go back to its confirmed position.
+// The exit status is 1 if a client disconnected, had a turn rejected without either rate set, the journal
+// of a client went wrong, or the two sides of a game disagree.
+//
+// Usage: netplay [--host ADDRESS] [--port P] [--pairs N] [--games G] [--seed S] [--out-of-turn-rate R]
+//                [--corrupt-rate R]
+
+#include "../gamestate.h"
+#include "../netclient.h"
+#include "../pdn.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+struct NetPlayer {
+    NetClient client;
+    GameState gameState;
+    int gamesFinished;      // Games this player has finished and compared with its opponent's
+    vector<Move> journal;   // Turns of the current game a move journal would hold
+};
+
+struct NetPlayTotals {
+    long long turns;            // Turns clicked by the clients
+    long long games;            // Games both players saw end
+    long long failures;
+    long long outOfTurn;        // Extra turns clicked out of turn
+    long long corrupted;        // Unconfirmed turns altered after sending
+    long long rejected;         // Turns the server refused
+    long long rollbacks;        // Times a client went back to its last confirmed turn
+    long long resyncs;          // Times a client fetched the position again
+    vector<int32_t> latencies;  // PING round trips sampled once per game, in microseconds
+};
+
+
+// True with probability `rate`; draws nothing when the rate is 0, so runs without faults keep their seed.
+static bool Chance(mt19937 &random, double rate) {
+    return rate > 0.0 && uniform_real_distribution<double>(0.0, 1.0)(random) < rate;
+}
+
+
+// Clicks a random legal turn: the piece, then every landing square, as a player would.
+static void ClickRandomTurn(GameState &gameState, mt19937 &random) {
+    Bitboards pos;
+    GameStateToBitboards(gameState, pos);
+    MoveList list;
+    GenerateMoves(pos, list);
+    if (list.count == 0) return;
+
+    const Move &move = list.moves[random() % list.count];
+    ApplyClick(gameState, SquareX(move.from), SquareY(move.from));
+    for (int i = 0; i < move.length; i++) {
+        ApplyClick(gameState, SquareX(move.path[i]), SquareY(move.path[i]));
+    }
+}
+
+
+// Alters the last landing square of the first unconfirmed turn, as a client with a bug or a stale copy of
+// the game would, so the server's echo of it differs.
+static void CorruptSentTurn(NetPlayer &player) {
+    Move &move = player.gameState.moveHistory[player.client.confirmedMoves];
+    move.path[move.length - 1] ^= 1;
+    if (move.length == 1) move.to = move.path[0];
+}
+
+
+// Follows the journal after an UpdateNetworkGame, as checkers.cpp does: starts over when the history was
+// replaced, takes back the turns the client did not keep, then logs the new ones. False if it no longer
+// matches the move history.
+static bool MirrorJournal(NetPlayer &player, bool replaced) {
+    vector<Move> &journal = player.journal;
+    const vector<Move> &history = player.gameState.moveHistory;
+    if (replaced) journal.clear();
+    while (journal.size() > player.client.keptMoves) journal.pop_back();
+    while (journal.size() < history.size()) journal.push_back(history[journal.size()]);
+
+    if (journal.size() != history.size()) return false;
+    for (size_t i = 0; i < journal.size(); i++) {
+        if (memcmp(&journal[i], &history[i], sizeof(Move)) != 0) return false;
+    }
+    return true;
+}
+
+
+// Both players of a finished game must agree on everything that was played.
+static bool SameGame(const GameState &a, const GameState &b) {
+    Bitboards posA, posB;
+    GameStateToBitboards(a, posA);
+    GameStateToBitboards(b, posB);
+    if (FormatPdnFen(posA) != FormatPdnFen(posB) || a.winner != b.winner || a.moveHistory.size() != b.moveHistory.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.moveHistory.size(); i++) {
+        if (FormatPdnMove(a.moveHistory[i]) != FormatPdnMove(b.moveHistory[i])) return false;
+    }
+    return true;
+}
+
+
+int main(int argc, char **argv) {
+    string host = "127.0.0.1";
+    int port = PROTOCOL_PORT;
+    int pairs = 4;
+    int games = 10;
+    unsigned seed = 1;
+    double outOfTurnRate = 0.0;
+    double corruptRate = 0.0;
+    for (int i = 1; i < argc; i++) {
+        const char *value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+        if (value == nullptr) { cerr << "Missing value for " << argv[i] << "\n"; return 2; }
+        else if (strcmp(argv[i], "--host") == 0) host = value;
+        else if (strcmp(argv[i], "--port") == 0) port = atoi(value);
+        else if (strcmp(argv[i], "--pairs") == 0) pairs = atoi(value);
+        else if (strcmp(argv[i], "--games") == 0) games = atoi(value);
+        else if (strcmp(argv[i], "--seed") == 0) seed = (unsigned)strtoul(value, nullptr, 10);
+        else if (strcmp(argv[i], "--out-of-turn-rate") == 0) outOfTurnRate = atof(value);
+        else if (strcmp(argv[i], "--corrupt-rate") == 0) corruptRate = atof(value);
+        else {
+            cerr << "Usage: netplay [--host ADDRESS] [--port P] [--pairs N] [--games G] [--seed S] "
+                 << "[--out-of-turn-rate R] [--corrupt-rate R]\n";
+            return 2;
+        }
+        i++;
+    }
+    if (pairs < 1 || games < 1 || outOfTurnRate < 0.0 || outOfTurnRate > 1.0 || corruptRate < 0.0 || corruptRate > 1.0) return 2;
+    bool faults = outOfTurnRate > 0.0 || corruptRate > 0.0;   // Rejected turns are then expected
+
+    // Connect everyone before the first frame, so the first games are between players that are all running
+    vector<NetPlayer> players(2 * pairs);
+    for (NetPlayer &player : players) {
+        string error;
+        InitializeGame(player.gameState);
+        player.gamesFinished = 0;
+        if (!StartNetClient(player.client, host, port, error)) {
+            cerr << "Error: " << error << "\n";
+            return 1;
+        }
+        while (!player.client.connected && !player.client.closed) {
+            this_thread::sleep_for(chrono::milliseconds(1));
+        }
+    }
+    cout << "Connected " << players.size() << " clients to " << host << ":" << port << "\n" << flush;
+
+    // Any two waiting players may be seated together, so the players of a game are found by its number
+    mt19937 random(seed);
+    NetPlayTotals totals = {};
+    auto startTime = chrono::steady_clock::now();
+    auto lastProgress = startTime;
+    bool running = true;
+    while (running) {
+        for (size_t i = 0; i < players.size(); i++) {
+            NetPlayer &player = players[i];
+            if (player.client.status == NET_DISCONNECTED) continue;
+
+            size_t turnsBefore = player.gameState.moveHistory.size();
+            if (NetworkMayMove(player.client, player.gameState)) {
+                ClickRandomTurn(player.gameState, random);
+                if (Chance(random, outOfTurnRate) && !player.gameState.gameOver) {
+                    ClickRandomTurn(player.gameState, random);
+                    totals.outOfTurn++;
+                }
+                totals.turns += player.gameState.moveHistory.size() - turnsBefore;
+            }
+            if (player.client.sentMoves > player.client.confirmedMoves && Chance(random, corruptRate)) {
+                CorruptSentTurn(player);
+                totals.corrupted++;
+            }
+            bool replaced = UpdateNetworkGame(player.client, player.gameState);
+            if (!MirrorJournal(player, replaced)) {
+                cerr << "Client " << i << ": journal differs from the move history\n";
+                totals.failures++;
+                player.journal = player.gameState.moveHistory;
+            }
+
+            totals.rejected += player.client.rejectedMoves;
+            if (player.client.status == NET_DISCONNECTED || (!faults && player.client.rejectedMoves > 0)) {
+                cerr << "Client " << i << ": " << ((player.client.failure != nullptr) ? player.client.failure : player.client.error)
+                     << ", " << player.client.rejectedMoves << " turns rejected\n";
+                totals.failures++;
+            }
+            player.client.rejectedMoves = 0;
+        }
+
+        // A game is done once both its players have seen END; then both ask for the next one
+        running = false;
+        for (size_t i = 0; i < players.size(); i++) {
+            NetPlayer &player = players[i];
+            if (player.gamesFinished >= games) continue;
+            if (player.client.status != NET_GAME_OVER) {
+                running = running || player.client.status != NET_DISCONNECTED;
+                continue;
+            }
+            for (size_t j = i + 1; j < players.size(); j++) {
+                NetPlayer &opponent = players[j];
+                if (opponent.gamesFinished >= games || opponent.client.status != NET_GAME_OVER ||
+                    opponent.client.gameNumber != player.client.gameNumber) continue;
+
+                totals.games++;
+                if (!SameGame(player.gameState, opponent.gameState)) {
+                    cerr << "Game " << player.client.gameNumber << " ended differently for the two players\n";
+                    totals.failures++;
+                }
+                for (NetPlayer *finished : { &player, &opponent }) {
+                    int32_t latencyUs = finished->client.latencyUs.load();
+                    if (latencyUs >= 0) totals.latencies.push_back(latencyUs);
+                    if (++finished->gamesFinished < games) RequestNetworkGame(finished->client);
+                }
+                lastProgress = chrono::steady_clock::now();
+                break;
+            }
+            running = running || player.gamesFinished < games;
+        }
+
+        if (chrono::steady_clock::now() - lastProgress > chrono::seconds(10)) {
+            cerr << "Error: No game finished for 10 seconds\n";
+            totals.failures++;
+            break;
+        }
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+
+    for (NetPlayer &player : players) {
+        totals.rollbacks += player.client.rollbacks;
+        totals.resyncs += player.client.resyncs;
+        CloseNetClient(player.client);
+    }
+
+    sort(totals.latencies.begin(), totals.latencies.end());
+    cout << totals.games << " games, " << totals.turns << " turns in " << seconds << " s, " << totals.failures << " failures\n";
+    if (!totals.latencies.empty()) {
+        cout << "Latency: median " << totals.latencies[totals.latencies.size() / 2] / 1000.0 << " ms, max "
+             << totals.latencies.back() / 1000.0 << " ms\n";
+    }
+    cout << "Rollback: " << totals.rollbacks << " rollbacks, " << totals.resyncs << " resyncs, " << totals.rejected
+         << " turns rejected";
+    if (faults) cout << " (" << totals.outOfTurn << " clicked out of turn, " << totals.corrupted << " altered)";
+    cout << "\n";
+    return (totals.failures > 0 || totals.games == 0) ? 1 : 0;
+}
@@ -0,0 +1,85 @@
+// @file pdncheck.cpp
+// @brief Streams PDN files game by game, validates every move and optionally rewrites the valid games.
+//
+// Usage: pdncheck [--rewrite out.pdn] [--quiet] file.pdn [more.pdn ...]   ("-" reads standard input)
+
+#include "../pdn.h"
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+
+int main(int argc, char **argv) {
+    const char *rewritePath = nullptr;
+    bool quiet = false;
+    int firstFile = 1;
+    while (firstFile < argc && argv[firstFile][0] == '-' && argv[firstFile][1] == '-') {
+        if (strcmp(argv[firstFile], "--rewrite") == 0 && firstFile + 1 < argc) {
+            rewritePath = argv[firstFile + 1];
+            firstFile += 2;
+        } else if (strcmp(argv[firstFile], "--quiet") == 0) {
+            quiet = true;
+            firstFile++;
+        } else {
+            cerr << "Unknown option " << argv[firstFile] << "\n";
+            return 2;
+        }
+    }
+    if (firstFile >= argc) {
+        cerr << "Usage: pdncheck [--rewrite out.pdn] [--quiet] file.pdn [more.pdn ...]\n";
+        return 2;
+    }
+
+    ofstream rewrite;
+    if (rewritePath != nullptr) {
+        rewrite.open(rewritePath);
+        if (!rewrite.is_open()) {
+            cerr << "Error: Could not open " << rewritePath << " for writing.\n";
+            return 2;
+        }
+    }
+
+    long long validGames = 0, invalidGames = 0, turns = 0;
+    PdnReader *reader = new PdnReader; // Holds the read buffer, too large for the stack
+    PdnGame game;
+    auto started = chrono::steady_clock::now();
+
+    for (int i = firstFile; i < argc; i++) {
+        ifstream file;
+        istream *input = &cin;
+        if (strcmp(argv[i], "-") != 0) {
+            file.open(argv[i], ios::binary);
+            if (!file.is_open()) {
+                cerr << "Error: Could not open " << argv[i] << "\n";
+                invalidGames++;
+                continue;
+            }
+            input = &file;
+        }
+
+        InitPdnReader(*reader, *input);
+        PdnStatus status;
+        while ((status = ReadPdnGame(*reader, game)) != PDN_END) {
+            if (status == PDN_GAME_OK) {
+                validGames++;
+                turns += game.record.moves.size();
+                if (rewritePath != nullptr) {
+                    WritePdnGame(rewrite, game.record, game.result, game.tags);
+                }
+            } else {
+                invalidGames++;
+                if (!quiet) {
+                    cerr << argv[i] << ":" << reader->gameLine << ": " << reader->error << "\n";
+                }
+            }
+        }
+    }
+    delete reader;
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+    cout << "Valid games: " << validGames << "  invalid games: " << invalidGames << "  turns: " << turns
+         << "  (" << seconds << " s, " << (seconds > 0 ? (validGames + invalidGames) / seconds : 0.0) << " games/s)\n";
+    return invalidGames > 0 ? 1 : 0;
+}
@@ -0,0 +1,323 @@
+// @file protocolbench.cpp
+// @brief Bandwidth and parse cost of the server protocol (protocol.h), next to the PDN text lines it replaced.
+//
+// The message stream is every turn of a set of seeded random games, as the server relays it. The first table
+// gives the bytes each kind of message takes on the wire in binary and as the former text line ("MOVE 11-15\n",
+// "START 1 0 B:W21,...\n"), and what sending the game's whole GameState would take instead. The timed
+// benchmarks then give ns per message for cutting messages out of a receive buffer, encoding and decoding
+// turns, and encoding and decoding positions, each with its text counterpart. Decoding a turn includes the
+// legality check against GenerateMoves in both forms, as the server and the client both do it.
+//
+// Usage: protocolbench [--games N] [--seed S] [--samples K] [--min-sample-ms M] [--filter NAME]
+
+#include "../protocol.h"
+#include "../gamestate.h"
+#include "../pdn.h"
+#include "benchstats.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+struct BenchOptions {
+    int games;
+    unsigned seed;
+    int samples;
+    double minSampleMs;
+    const char *filter;     // Only benchmarks whose name contains this, or nullptr for all
+};
+
+// Every turn of the games with the position it was played in, and the same turns as both message streams.
+struct BenchSuite {
+    vector<Bitboards> positions;    // Before each turn
+    vector<Move> moves;
+    vector<uint8_t> binaryStream;   // One MOVE message per turn
+    vector<string> textLines;       // "MOVE <pdn>\n" per turn
+    string textStream;              // The same lines back to back
+    vector<string> fens;            // FormatPdnFen of every position
+};
+
+// One pass over the suite, as in rulesbench.
+typedef uint64_t (*BenchFunction)(const BenchSuite &suite, uint64_t &operations);
+
+struct Benchmark {
+    const char *name;
+    BenchFunction run;
+};
+
+static volatile uint64_t benchSink; // Receives every checksum
+
+
+static bool ParseOptions(int argc, char **argv, BenchOptions &options) {
+    options.games = 64;
+    options.seed = 1;
+    options.samples = 20;
+    options.minSampleMs = 20.0;
+    options.filter = nullptr;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+        if (value == nullptr) { cerr << "Missing value for " << arg << "\n"; return false; }
+        else if (strcmp(arg, "--games") == 0) options.games = atoi(value);
+        else if (strcmp(arg, "--seed") == 0) options.seed = (unsigned)strtoul(value, nullptr, 10);
+        else if (strcmp(arg, "--samples") == 0) options.samples = atoi(value);
+        else if (strcmp(arg, "--min-sample-ms") == 0) options.minSampleMs = atof(value);
+        else if (strcmp(arg, "--filter") == 0) options.filter = value;
+        else { cerr << "Unknown option " << arg << "\n"; return false; }
+        i++;
+    }
+    return options.games > 0 && options.samples > 1 && options.minSampleMs > 0.0;
+}
+
+
+// Plays random games of at most 200 plies; the same seed always gives the same stream.
+static void BuildSuite(const BenchOptions &options, BenchSuite &suite) {
+    mt19937 random(options.seed);
+    MoveList list;
+
+    for (int game = 0; game < options.games; game++) {
+        Bitboards pos;
+        InitialBitboards(pos);
+        for (int ply = 0; ply < 200; ply++) {
+            GenerateMoves(pos, list);
+            if (list.count == 0) break;
+            const Move &move = list.moves[random() % list.count];
+            suite.positions.push_back(pos);
+            suite.moves.push_back(move);
+            suite.fens.push_back(FormatPdnFen(pos));
+
+            uint8_t turn[PROTOCOL_MAX_TURN];
+            uint8_t message[PROTOCOL_MAX_MESSAGE];
+            int length = WriteProtocolMessage(message, sizeof(message), PROTOCOL_MOVE, turn, EncodeProtocolTurn(move, turn));
+            suite.binaryStream.insert(suite.binaryStream.end(), message, message + length);
+            suite.textLines.push_back("MOVE " + FormatPdnMove(move) + "\n");
+            suite.textStream += suite.textLines.back();
+
+            MakeMove(pos, move);
+        }
+    }
+}
+
+
+// Cuts every message out of the stream and reads its header, without looking at the turn.
+static uint64_t BenchFrame(const BenchSuite &suite, uint64_t &operations) {
+    uint64_t checksum = 0;
+    const uint8_t *data = suite.binaryStream.data();
+    int length = (int)suite.binaryStream.size();
+    ProtocolMessage message;
+    int messageLength;
+    for (int offset = 0; (messageLength = FindProtocolMessage(data + offset, length - offset)) > 0; offset += messageLength) {
+        if (ParseProtocolMessage(data + offset, messageLength, message)) checksum += message.payloadLength;
+    }
+    operations += suite.moves.size();
+    return checksum;
+}
+
+
+static uint64_t BenchTextFrame(const BenchSuite &suite, uint64_t &operations) {
+    uint64_t checksum = 0;
+    const char *data = suite.textStream.data();
+    const char *end = data + suite.textStream.size();
+    while (data < end) {
+        const char *newline = (const char *)memchr(data, '\n', end - data);
+        const char *space = (const char *)memchr(data, ' ', newline - data);
+        checksum += (space != nullptr) ? (uint64_t)(newline - space) : 0;
+        data = newline + 1;
+    }
+    operations += suite.moves.size();
+    return checksum;
+}
+
+
+static uint64_t BenchMoveEncode(const BenchSuite &suite, uint64_t &operations) {
+    uint64_t checksum = 0;
+    uint8_t turn[PROTOCOL_MAX_TURN];
+    uint8_t message[PROTOCOL_MAX_MESSAGE];
+    for (const Move &move : suite.moves) {
+        checksum += WriteProtocolMessage(message, sizeof(message), PROTOCOL_MOVE, turn, EncodeProtocolTurn(move, turn));
+    }
+    operations += suite.moves.size();
+    return checksum;
+}
+
+
+static uint64_t BenchTextMoveEncode(const BenchSuite &suite, uint64_t &operations) {
+    uint64_t checksum = 0;
+    for (const Move &move : suite.moves) {
+        string line = "MOVE " + FormatPdnMove(move) + "\n";
+        checksum += line.size();
+    }
+    operations += suite.moves.size();
+    return checksum;
+}
+
+
+static uint64_t BenchMoveDecode(const BenchSuite &suite, uint64_t &operations) {
+    uint64_t checksum = 0;
+    const uint8_t *data = suite.binaryStream.data();
+    ProtocolMessage message;
+    Move move;
+    for (size_t i = 0; i < suite.positions.size(); i++) {
+        int messageLength = PROTOCOL_HEADER_SIZE + data[1];
+        if (ParseProtocolMessage(data, messageLength, message) &&
+            DecodeProtocolTurn(suite.positions[i], message.payload, message.payloadLength, move)) {
+            checksum += move.captured;
+        }
+        data += messageLength;
+    }
+    operations += suite.moves.size();
+    return checksum;
+}
+
+
+static uint64_t BenchTextMoveDecode(const BenchSuite &suite, uint64_t &operations) {
+    uint64_t checksum = 0;
+    Move move;
+    string error;
+    for (size_t i = 0; i < suite.positions.size(); i++) {
+        const string &line = suite.textLines[i];
+        if (MatchPdnMove(suite.positions[i], line.substr(5, line.size() - 6), move, error)) checksum += move.captured;
+    }
+    operations += suite.moves.size();
+    return checksum;
+}
+
+
+static uint64_t BenchPositionEncode(const BenchSuite &suite, uint64_t &operations) {
+    uint64_t checksum = 0;
+    uint8_t payload[PROTOCOL_POSITION_SIZE];
+    for (const Bitboards &pos : suite.positions) {
+        EncodeProtocolPosition(pos, payload);
+        checksum += payload[0] ^ payload[5];
+    }
+    operations += suite.positions.size();
+    return checksum;
+}
+
+
+static uint64_t BenchTextPositionEncode(const BenchSuite &suite, uint64_t &operations) {
+    uint64_t checksum = 0;
+    for (const Bitboards &pos : suite.positions) {
+        checksum += FormatPdnFen(pos).size();
+    }
+    operations += suite.positions.size();
+    return checksum;
+}
+
+
+static uint64_t BenchPositionDecode(const BenchSuite &suite, uint64_t &operations) {
+    uint64_t checksum = 0;
+    uint8_t payload[PROTOCOL_POSITION_SIZE];
+    Bitboards pos;
+    for (size_t i = 0; i < suite.positions.size(); i++) {
+        EncodeProtocolPosition(suite.positions[i], payload);   // A few stores; keeps the suite small
+        if (DecodeProtocolPosition(payload, pos)) checksum += pos.kings;
+    }
+    operations += suite.positions.size();
+    return checksum;
+}
+
+
+static uint64_t BenchTextPositionDecode(const BenchSuite &suite, uint64_t &operations) {
+    uint64_t checksum = 0;
+    Bitboards pos;
+    for (const string &fen : suite.fens) {
+        if (ParsePdnFen(fen, pos)) checksum += pos.kings;
+    }
+    operations += suite.fens.size();
+    return checksum;
+}
+
+
+const Benchmark BENCHMARKS[] = {
+    { "frame", BenchFrame },
+    { "text-frame", BenchTextFrame },
+    { "move-encode", BenchMoveEncode },
+    { "text-move-encode", BenchTextMoveEncode },
+    { "move-decode", BenchMoveDecode },
+    { "text-move-decode", BenchTextMoveDecode },
+    { "position-encode", BenchPositionEncode },
+    { "text-position-encode", BenchTextPositionEncode },
+    { "position-decode", BenchPositionDecode },
+    { "text-position-decode", BenchTextPositionDecode },
+};
+
+
+// Times one benchmark: finds how many passes fill a sample, warms up, then takes the samples.
+static BenchSummary RunBenchmark(const Benchmark &benchmark, const BenchSuite &suite, const BenchOptions &options) {
+    int passes = 1;
+    while (true) {
+        uint64_t operations = 0;
+        auto start = chrono::steady_clock::now();
+        for (int pass = 0; pass < passes; pass++) benchSink = benchSink + benchmark.run(suite, operations);
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        if (ms >= options.minSampleMs || passes >= (1 << 24)) break;
+        passes *= 2;
+    }
+
+    vector<double> samples;
+    for (int sample = 0; sample < options.samples; sample++) {
+        uint64_t operations = 0;
+        auto start = chrono::steady_clock::now();
+        for (int pass = 0; pass < passes; pass++) benchSink = benchSink + benchmark.run(suite, operations);
+        double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+        samples.push_back(ns / operations);
+    }
+    return SummariseSamples(samples);
+}
+
+
+// Bytes on the wire per message kind, binary against the text lines of the earlier protocol.
+static void PrintBandwidth(const BenchSuite &suite) {
+    size_t textMoveBytes = 0;
+    size_t fenBytes = 0;
+    for (size_t i = 0; i < suite.moves.size(); i++) {
+        textMoveBytes += suite.textLines[i].size();
+        fenBytes += suite.fens[i].size();
+    }
+    double moves = (double)suite.moves.size();
+    double binaryMove = suite.binaryStream.size() / moves;
+    double textMove = textMoveBytes / moves;
+    double fen = fenBytes / moves;
+
+    cout << fixed << setprecision(1);
+    cout << "Bytes per message over " << suite.moves.size() << " turns:\n";
+    cout << "  " << left << setw(10) << "message" << right << setw(10) << "binary" << setw(10) << "text" << "\n";
+    cout << "  " << left << setw(10) << "MOVE" << right << setw(10) << binaryMove << setw(10) << textMove << "\n";
+    cout << "  " << left << setw(10) << "START" << right << setw(10) << (double)(PROTOCOL_HEADER_SIZE + 5 + PROTOCOL_POSITION_SIZE)
+         << setw(10) << (double)strlen("START 1 0 \n") + fen << "\n";
+    cout << "  " << left << setw(10) << "POSITION" << right << setw(10) << (double)(PROTOCOL_HEADER_SIZE + 2 + PROTOCOL_POSITION_SIZE)
+         << setw(10) << fen + 1 << "  (text: a FEN line)\n";
+    cout << "  Whole GameState instead of a turn: " << sizeof(GameState) << " bytes plus its move history\n\n";
+}
+
+
+int main(int argc, char **argv) {
+    BenchOptions options;
+    if (!ParseOptions(argc, argv, options)) {
+        cerr << "Usage: protocolbench [--games N] [--seed S] [--samples K] [--min-sample-ms M] [--filter NAME]\n";
+        return 2;
+    }
+
+    BenchSuite suite;
+    BuildSuite(options, suite);
+    PrintBandwidth(suite);
+
+    cout << left << setw(22) << "Benchmark" << right << setw(12) << "mean ns" << setw(10) << "+-95%"
+         << setw(12) << "median" << setw(12) << "min" << "  per message\n";
+    for (const Benchmark &benchmark : BENCHMARKS) {
+        if (options.filter != nullptr && strstr(benchmark.name, options.filter) == nullptr) continue;
+        BenchSummary summary = RunBenchmark(benchmark, suite, options);
+        cout << left << setw(22) << benchmark.name << right << setprecision(2)
+             << setw(12) << summary.mean << setw(10) << summary.ci95
+             << setw(12) << summary.median << setw(12) << summary.min << "\n" << flush;
+    }
+    return 0;
+}
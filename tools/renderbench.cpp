@@ -0,0 +1,164 @@
+// @file renderbench.cpp
+// @brief Headless rendering benchmark: draws the board scene of every position of random games into the
+// recording backend and reports draw calls, batches, text draws, overdraw and CPU time per scene.
+//
+// Usage: renderbench [--games N] [--max-plies N] [--seed S]
+
+#include "../rules.h"
+#include "../render.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <iomanip>
+#include <random>
+
+using namespace std;
+
+struct BenchOptions {
+    int games;
+    int maxPlies;
+    unsigned seed;
+};
+
+// Totals for one kind of scene.
+struct SceneTotals {
+    long long scenes;
+    RenderStats sum;
+    RenderStats max;
+    double seconds;
+};
+
+
+static bool ParseOptions(int argc, char **argv, BenchOptions &options) {
+    options.games = 200;
+    options.maxPlies = 200;
+    options.seed = 1;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+        if (value == nullptr) { cerr << "Missing value for " << arg << "\n"; return false; }
+        else if (strcmp(arg, "--games") == 0) options.games = atoi(value);
+        else if (strcmp(arg, "--max-plies") == 0) options.maxPlies = atoi(value);
+        else if (strcmp(arg, "--seed") == 0) options.seed = (unsigned)strtoul(value, nullptr, 10);
+        else { cerr << "Unknown option " << arg << "\n"; return false; }
+        i++;
+    }
+    return options.games > 0 && options.maxPlies > 0;
+}
+
+
+static void AddScene(SceneTotals &totals, const RenderStats &stats, double seconds) {
+    totals.scenes++;
+    totals.seconds += seconds;
+    totals.sum.drawCalls += stats.drawCalls;
+    totals.sum.rectangles += stats.rectangles;
+    totals.sum.circles += stats.circles;
+    totals.sum.sprites += stats.sprites;
+    totals.sum.batches += stats.batches;
+    totals.sum.texts += stats.texts;
+    totals.sum.pixelsCovered += stats.pixelsCovered;
+    totals.max.drawCalls = max(totals.max.drawCalls, stats.drawCalls);
+    totals.max.rectangles = max(totals.max.rectangles, stats.rectangles);
+    totals.max.circles = max(totals.max.circles, stats.circles);
+    totals.max.texts = max(totals.max.texts, stats.texts);
+    totals.max.pixelsCovered = max(totals.max.pixelsCovered, stats.pixelsCovered);
+}
+
+
+static void DrawAndRecord(const BoardView &view, SceneTotals &totals) {
+    RenderBackend backend;
+    RenderStats stats;
+    InitRecordingBackend(backend, stats);
+
+    auto start = chrono::steady_clock::now();
+    DrawBoardScene(backend, view);
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    AddScene(totals, stats, seconds);
+}
+
+
+static void PrintTotals(const char *name, const SceneTotals &totals) {
+    if (totals.scenes == 0) return;
+    double screenPixels = (double)SCREEN_WIDTH * BOARD_HEIGHT;
+    double scenes = (double)totals.scenes;
+
+    cout << left << setw(14) << name << right
+         << setw(9) << totals.scenes
+         << setw(9) << totals.sum.drawCalls / scenes << setw(6) << totals.max.drawCalls
+         << setw(9) << totals.sum.rectangles / scenes
+         << setw(9) << totals.sum.sprites / scenes
+         << setw(9) << totals.sum.batches / scenes
+         << setw(9) << totals.sum.texts / scenes << setw(6) << totals.max.texts
+         << setw(10) << totals.sum.pixelsCovered / scenes / screenPixels
+         << setw(10) << totals.seconds / scenes * 1e9 << "\n";
+}
+
+
+int main(int argc, char **argv) {
+    BenchOptions options;
+    if (!ParseOptions(argc, argv, options)) {
+        cerr << "Usage: renderbench [--games N] [--max-plies N] [--seed S]\n";
+        return 2;
+    }
+
+    SceneTotals idle, selected, gameOver;
+    memset(&idle, 0, sizeof(idle));
+    memset(&selected, 0, sizeof(selected));
+    memset(&gameOver, 0, sizeof(gameOver));
+    mt19937 random(options.seed);
+
+    // The fixed layer, drawn once per run by the game
+    RenderBackend backend;
+    RenderStats squares;
+    InitRecordingBackend(backend, squares);
+    DrawBoardSquares(backend);
+
+    MoveList list;
+    for (int game = 0; game < options.games; game++) {
+        BoardView view;
+        InitialBitboards(view.position);
+        view.gameOver = false;
+        view.winner = 0;
+
+        for (int ply = 0; ply <= options.maxPlies; ply++) {
+            GenerateMoves(view.position, list);
+            view.player1Score = 12 - PopCount(view.position.pieces[1]);
+            view.player2Score = 12 - PopCount(view.position.pieces[0]);
+            view.selectedSquare = -1;
+            view.targetSquares = 0;
+            view.hiddenSquares = 0;
+
+            if (list.count == 0) {
+                view.gameOver = true;
+                view.winner = (int)(view.position.sideToMove ^ 1);
+                DrawAndRecord(view, gameOver);
+                break;
+            }
+            DrawAndRecord(view, idle);
+
+            // The scene the player sees after clicking a piece that has moves
+            view.selectedSquare = list.moves[random() % list.count].from;
+            for (int i = 0; i < list.count; i++) {
+                if (list.moves[i].from == view.selectedSquare) {
+                    view.targetSquares |= SquareBit(list.moves[i].path[0]);
+                }
+            }
+            DrawAndRecord(view, selected);
+
+            MakeMove(view.position, list.moves[random() % list.count]);
+        }
+    }
+
+    cout << fixed << setprecision(2);
+    cout << "Fixed layer: " << squares.drawCalls << " draw calls (" << squares.texts << " text), drawn once\n";
+    cout << left << setw(14) << "Scene" << right << setw(9) << "count" << setw(9) << "calls" << setw(6) << "max"
+         << setw(9) << "rects" << setw(9) << "sprites" << setw(9) << "batches" << setw(9) << "texts" << setw(6) << "max"
+         << setw(10) << "overdraw" << setw(10) << "ns" << "\n";
+    PrintTotals("idle", idle);
+    PrintTotals("selected", selected);
+    PrintTotals("game over", gameOver);
+    return 0;
+}
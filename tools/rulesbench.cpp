@@ -0,0 +1,503 @@
+// @file rulesbench.cpp
+// @brief Microbenchmarks for the rules hot paths over a fixed suite of positions: move generation, per-piece
+// move queries, game over detection, make/unmake, hashing, evaluation, save encoding/decoding, rollback
+// snapshots and perft.
+//
+// Every benchmark is timed in repeated samples of at least --min-sample-ms each, in --runs runs of the whole
+// suite that take turns, so a slow stretch of the machine hits every benchmark a little instead of one a lot.
+// The report gives ns per operation as mean, 95% confidence interval, median and minimum over all samples, and
+// the median and spread (interquartile range) of the run medians. --csv also writes the results, with every
+// run median, in a form other tools can read back; the exit status is 1 if any benchmark spread wider than
+// --threshold, as such a file cannot serve as a baseline. With --baseline the runs are compared against such a
+// file, and the exit status is 1 if any benchmark got slower by more than --threshold percent and a
+// Mann-Whitney U test on the run medians says so too, or if the baseline itself spreads wider than the
+// threshold. The benchmarks that look slower are measured again up to --retries times before they count.
+//
+// Usage: rulesbench [--positions N] [--seed S] [--samples K] [--runs R] [--min-sample-ms M] [--filter NAME]
+//                   [--csv FILE] [--baseline FILE] [--threshold PERCENT] [--retries N]
+
+#include "../rules.h"
+#include "../engine.h"
+#include "../rollback.h"
+#include "../savefile.h"
+#include "benchstats.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+struct BenchOptions {
+    int positions;
+    unsigned seed;
+    int samples;            // Per run
+    int runs;
+    double minSampleMs;
+    const char *filter;     // Only benchmarks whose name contains this, or nullptr for all
+    const char *csvPath;    // Where to write the results, or nullptr
+    const char *baselinePath; // Results to compare against, or nullptr
+    double threshold;       // Smallest change in the median run that counts, as a fraction
+    int retries;            // Extra sets of runs of the benchmarks that look slower than the baseline
+};
+
+// The positions every benchmark runs over, with their moves generated once up front.
+struct BenchSuite {
+    vector<Bitboards> positions;
+    vector<MoveList> moves;
+    vector<uint64_t> hashes;                // ZobristHash of every position
+    vector<GameRecord> games;               // The games the positions were taken from
+    vector<vector<uint8_t>> encodedGames;   // The same games as save files
+};
+
+// One pass over the suite. Returns a checksum of the results so the compiler cannot drop the work, and adds
+// the number of operations done to `operations`.
+typedef uint64_t (*BenchFunction)(const BenchSuite &suite, uint64_t &operations);
+
+struct Benchmark {
+    const char *name;
+    const char *operation;  // What one operation is
+    BenchFunction run;
+};
+
+static volatile uint64_t benchSink; // Receives every checksum
+
+
+static bool ParseOptions(int argc, char **argv, BenchOptions &options) {
+    options.positions = 512;
+    options.seed = 1;
+    options.samples = 5;
+    options.runs = 10;
+    options.minSampleMs = 20.0;
+    options.filter = nullptr;
+    options.csvPath = nullptr;
+    options.baselinePath = nullptr;
+    options.threshold = 0.05;
+    options.retries = 2;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+        if (value == nullptr) { cerr << "Missing value for " << arg << "\n"; return false; }
+        else if (strcmp(arg, "--positions") == 0) options.positions = atoi(value);
+        else if (strcmp(arg, "--seed") == 0) options.seed = (unsigned)strtoul(value, nullptr, 10);
+        else if (strcmp(arg, "--samples") == 0) options.samples = atoi(value);
+        else if (strcmp(arg, "--runs") == 0) options.runs = atoi(value);
+        else if (strcmp(arg, "--min-sample-ms") == 0) options.minSampleMs = atof(value);
+        else if (strcmp(arg, "--filter") == 0) options.filter = value;
+        else if (strcmp(arg, "--csv") == 0) options.csvPath = value;
+        else if (strcmp(arg, "--baseline") == 0) options.baselinePath = value;
+        else if (strcmp(arg, "--threshold") == 0) options.threshold = atof(value) / 100.0;
+        else if (strcmp(arg, "--retries") == 0) options.retries = atoi(value);
+        else { cerr << "Unknown option " << arg << "\n"; return false; }
+        i++;
+    }
+    return options.positions > 0 && options.samples > 1 && options.runs > 0 && options.minSampleMs > 0.0 && options.threshold >= 0.0 && options.retries >= 0;
+}
+
+
+// Plays random games from the initial position and keeps every position that has a move, until there are
+// enough. The same seed always gives the same suite.
+static void BuildSuite(const BenchOptions &options, BenchSuite &suite) {
+    mt19937 random(options.seed);
+    MoveList list;
+
+    while ((int)suite.positions.size() < options.positions) {
+        GameRecord game;
+        InitialBitboards(game.start);
+        Bitboards pos = game.start;
+
+        for (int ply = 0; ply < 200 && (int)suite.positions.size() < options.positions; ply++) {
+            GenerateMoves(pos, list);
+            if (list.count == 0) break;
+            suite.positions.push_back(pos);
+            suite.moves.push_back(list);
+            suite.hashes.push_back(ZobristHash(pos));
+
+            const Move &move = list.moves[random() % list.count];
+            game.moves.push_back(move);
+            MakeMove(pos, move);
+        }
+
+        suite.games.push_back(game);
+        suite.encodedGames.emplace_back();
+        EncodeGameRecord(game, suite.encodedGames.back());
+    }
+}
+
+
+static uint64_t BenchGenerateMoves(const BenchSuite &suite, uint64_t &operations) {
+    uint64_t checksum = 0;
+    MoveList list;
+    for (const Bitboards &pos : suite.positions) {
+        GenerateMoves(pos, list);
+        checksum += list.count;
+    }
+    operations += suite.positions.size();
+    return checksum;
+}
+
+
+// What the game does when a piece is clicked (FindValidMoves): the landing squares of that one piece, here
+// taken from the full move list like the rules module would answer it.
+static uint64_t BenchPieceQueries(const BenchSuite &suite, uint64_t &operations) {
+    uint64_t checksum = 0;
+    MoveList list;
+    for (const Bitboards &pos : suite.positions) {
+        for (uint32_t pieces = pos.pieces[pos.sideToMove]; pieces != 0; pieces &= pieces - 1) {
+            int square = __builtin_ctz(pieces);
+            GenerateMoves(pos, list);
+            uint32_t targets = 0;
+            for (int i = 0; i < list.count; i++) {
+                if (list.moves[i].from == square) targets |= SquareBit(list.moves[i].path[0]);
+            }
+            checksum += targets;
+            operations++;
+        }
+    }
+    return checksum;
+}
+
+
+// The same test as UpdateGameOver in the game: no pieces or no legal move.
+static uint64_t BenchGameOver(const BenchSuite &suite, uint64_t &operations) {
+    uint64_t checksum = 0;
+    MoveList list;
+    for (const Bitboards &pos : suite.positions) {
+        GenerateMoves(pos, list);
+        checksum += (pos.pieces[pos.sideToMove] == 0 || list.count == 0) ? 1 : 0;
+    }
+    operations += suite.positions.size();
+    return checksum;
+}
+
+
+static uint64_t BenchMakeUnmake(const BenchSuite &suite, uint64_t &operations) {
+    uint64_t checksum = 0;
+    for (size_t i = 0; i < suite.positions.size(); i++) {
+        Bitboards pos = suite.positions[i];
+        const MoveList &list = suite.moves[i];
+        for (int m = 0; m < list.count; m++) {
+            MakeMove(pos, list.moves[m]);
+            checksum += pos.pieces[0] ^ pos.kings;
+            UnmakeMove(pos, list.moves[m]);
+        }
+        operations += list.count;
+    }
+    return checksum;
+}
+
+
+static uint64_t BenchZobristFull(const BenchSuite &suite, uint64_t &operations) {
+    uint64_t checksum = 0;
+    for (const Bitboards &pos : suite.positions) {
+        checksum ^= ZobristHash(pos);
+    }
+    operations += suite.positions.size();
+    return checksum;
+}
+
+
+static uint64_t BenchZobristIncremental(const BenchSuite &suite, uint64_t &operations) {
+    uint64_t checksum = 0;
+    for (size_t i = 0; i < suite.positions.size(); i++) {
+        const MoveList &list = suite.moves[i];
+        for (int m = 0; m < list.count; m++) {
+            checksum ^= ZobristAfterMove(suite.hashes[i], suite.positions[i], list.moves[m]);
+        }
+        operations += list.count;
+    }
+    return checksum;
+}
+
+
+static uint64_t BenchEvaluate(const BenchSuite &suite, uint64_t &operations) {
+    uint64_t checksum = 0;
+    for (const Bitboards &pos : suite.positions) {
+        checksum += (uint64_t)Evaluate(pos);
+    }
+    operations += suite.positions.size();
+    return checksum;
+}
+
+
+static uint64_t BenchSaveEncode(const BenchSuite &suite, uint64_t &operations) {
+    uint64_t checksum = 0;
+    vector<uint8_t> bytes;
+    for (const GameRecord &game : suite.games) {
+        bytes.clear();
+        EncodeGameRecord(game, bytes);
+        checksum += bytes.size();
+    }
+    operations += suite.games.size();
+    return checksum;
+}
+
+
+static uint64_t BenchSaveDecode(const BenchSuite &suite, uint64_t &operations) {
+    uint64_t checksum = 0;
+    GameRecord game;
+    Bitboards finalPos;
+    for (const vector<uint8_t> &bytes : suite.encodedGames) {
+        if (DecodeGameRecord(bytes.data(), bytes.size(), game, finalPos) == SAVE_OK) {
+            checksum += game.moves.size();
+        }
+    }
+    operations += suite.encodedGames.size();
+    return checksum;
+}
+
+
+// Saves every position of the suite in turn, as the online client does after each turn.
+static uint64_t BenchRollbackSave(const BenchSuite &suite, uint64_t &operations) {
+    RollbackRing ring;
+    ResetRollback(ring, 0, suite.positions[0]);
+    for (size_t i = 1; i < suite.positions.size(); i++) {
+        SaveRollback(ring, (uint32_t)i, suite.positions[i]);
+    }
+    operations += suite.positions.size();
+    return ring.first + ring.positions[ring.last & (ROLLBACK_SIZE - 1)].kings;
+}
+
+
+// Goes back to one of the last ROLLBACK_SIZE turns, a different one each time.
+static uint64_t BenchRollbackRestore(const BenchSuite &suite, uint64_t &operations) {
+    RollbackRing ring;
+    ResetRollback(ring, 0, suite.positions[0]);
+    for (int ply = 1; ply < ROLLBACK_SIZE; ply++) {
+        SaveRollback(ring, (uint32_t)ply, suite.positions[ply % suite.positions.size()]);
+    }
+    uint64_t checksum = 0;
+    Bitboards pos;
+    for (size_t i = 0; i < suite.positions.size(); i++) {
+        if (RestoreRollback(ring, (uint32_t)(i * 5) & (ROLLBACK_SIZE - 1), pos)) {
+            checksum += pos.pieces[0] ^ pos.kings;
+        }
+    }
+    operations += suite.positions.size();
+    return checksum;
+}
+
+
+static uint64_t Perft(Bitboards &pos, int depth) {
+    MoveList list;
+    GenerateMoves(pos, list);
+    if (depth == 1) return (uint64_t)list.count;
+
+    uint64_t nodes = 0;
+    for (int i = 0; i < list.count; i++) {
+        MakeMove(pos, list.moves[i]);
+        nodes += Perft(pos, depth - 1);
+        UnmakeMove(pos, list.moves[i]);
+    }
+    return nodes;
+}
+
+
+// Leaf nodes counted to PERFT_DEPTH from every PERFT_STRIDE-th suite position; one operation is one leaf.
+static uint64_t BenchPerft(const BenchSuite &suite, uint64_t &operations) {
+    const int PERFT_DEPTH = 4;
+    const size_t PERFT_STRIDE = 64;
+    uint64_t nodes = 0;
+    for (size_t i = 0; i < suite.positions.size(); i += PERFT_STRIDE) {
+        Bitboards pos = suite.positions[i];
+        nodes += Perft(pos, PERFT_DEPTH);
+    }
+    operations += max<uint64_t>(nodes, 1);
+    return nodes;
+}
+
+
+const Benchmark BENCHMARKS[] = {
+    { "generate", "position", BenchGenerateMoves },
+    { "piece-query", "piece", BenchPieceQueries },
+    { "game-over", "position", BenchGameOver },
+    { "make-unmake", "move", BenchMakeUnmake },
+    { "zobrist-full", "position", BenchZobristFull },
+    { "zobrist-incremental", "move", BenchZobristIncremental },
+    { "evaluate", "position", BenchEvaluate },
+    { "save-encode", "game", BenchSaveEncode },
+    { "save-decode", "game", BenchSaveDecode },
+    { "rollback-save", "position", BenchRollbackSave },
+    { "rollback-restore", "position", BenchRollbackRestore },
+    { "perft", "leaf", BenchPerft },
+};
+
+
+// Times one benchmark: finds how many passes fill a sample, warms up, then takes one run of samples.
+static vector<double> RunBenchmark(const Benchmark &benchmark, const BenchSuite &suite, const BenchOptions &options) {
+    int passes = 1;
+    while (true) {
+        uint64_t operations = 0;
+        auto start = chrono::steady_clock::now();
+        for (int pass = 0; pass < passes; pass++) benchSink = benchSink + benchmark.run(suite, operations);
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        if (ms >= options.minSampleMs || passes >= (1 << 24)) break;
+        passes *= 2;
+    }
+
+    vector<double> samples;
+    for (int sample = 0; sample < options.samples; sample++) {
+        uint64_t operations = 0;
+        auto start = chrono::steady_clock::now();
+        for (int pass = 0; pass < passes; pass++) benchSink = benchSink + benchmark.run(suite, operations);
+        double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+        samples.push_back(ns / operations);
+    }
+    return samples;
+}
+
+
+// Measures the benchmarks `selected` in options.runs runs, each run going through all of them once.
+// Replaces the samples and run medians of each.
+static void MeasureRuns(const vector<int> &selected, const BenchSuite &suite, const BenchOptions &options,
+                        vector<vector<double>> &samples, vector<vector<double>> &runMedians) {
+    for (int index : selected) {
+        samples[index].clear();
+        runMedians[index].clear();
+    }
+    for (int run = 0; run < options.runs; run++) {
+        for (int index : selected) {
+            vector<double> runSamples = RunBenchmark(BENCHMARKS[index], suite, options);
+            samples[index].insert(samples[index].end(), runSamples.begin(), runSamples.end());
+            runMedians[index].push_back(SummariseSamples(runSamples).median);
+        }
+    }
+}
+
+
+int main(int argc, char **argv) {
+    BenchOptions options;
+    if (!ParseOptions(argc, argv, options)) {
+        cerr << "Usage: rulesbench [--positions N] [--seed S] [--samples K] [--runs R] [--min-sample-ms M] [--filter NAME]\n"
+                "                  [--csv FILE] [--baseline FILE] [--threshold PERCENT] [--retries N]\n";
+        return 2;
+    }
+
+    vector<BenchResult> baseline;
+    if (options.baselinePath != nullptr && !ReadBenchResults(options.baselinePath, baseline)) {
+        cerr << "Error: Could not read baseline " << options.baselinePath << "\n";
+        return 2;
+    }
+
+    BenchSuite suite;
+    BuildSuite(options, suite);
+    cout << "Suite: " << suite.positions.size() << " positions from " << suite.games.size() << " games (seed " << options.seed << ")\n";
+
+    ofstream csv;
+    if (options.csvPath != nullptr) {
+        csv.open(options.csvPath);
+        if (!csv.is_open()) {
+            cerr << "Error: Could not open " << options.csvPath << "\n";
+            return 1;
+        }
+        csv << "name,samples,mean_ns,stddev_ns,ci95_ns,median_ns,min_ns,runs,run_median_ns,run_spread,run_medians_ns\n";
+    }
+
+    cout << fixed << setprecision(2);
+    cout << left << setw(22) << "Benchmark" << setw(10) << "per" << right << setw(12) << "mean ns" << setw(10) << "+-95%"
+         << setw(12) << "median" << setw(12) << "min" << setw(12) << "run median" << setw(8) << "spread";
+    if (!baseline.empty()) cout << setw(12) << "baseline" << setw(9) << "change";
+    cout << "\n";
+
+    const int benchmarkCount = sizeof(BENCHMARKS) / sizeof(BENCHMARKS[0]);
+    vector<int> selected;
+    for (int index = 0; index < benchmarkCount; index++) {
+        if (options.filter == nullptr || strstr(BENCHMARKS[index].name, options.filter) != nullptr) selected.push_back(index);
+    }
+
+    vector<vector<double>> samples(benchmarkCount);
+    vector<vector<double>> runMedians(benchmarkCount);
+    vector<BenchVerdict> verdicts(benchmarkCount, BENCH_UNCHANGED);
+    MeasureRuns(selected, suite, options, samples, runMedians);
+
+    // Only the benchmarks that still look slower are measured again, in runs of their own
+    vector<int> slower = selected;
+    for (int attempt = 0; attempt <= options.retries && !slower.empty(); attempt++) {
+        if (attempt > 0) MeasureRuns(slower, suite, options, samples, runMedians);
+        vector<int> stillSlower;
+        for (int index : slower) {
+            const BenchResult *previous = FindBenchResult(baseline, BENCHMARKS[index].name);
+            verdicts[index] = (previous != nullptr) ? CompareWithBaseline(previous->runs, SummariseRuns(runMedians[index]), options.threshold) : BENCH_UNCHANGED;
+            if (verdicts[index] == BENCH_SLOWER) stillSlower.push_back(index);
+        }
+        slower = stillSlower;
+    }
+
+    int regressions = 0;
+    int noisyBaselines = 0;     // Baseline rows too noisy to test against
+    int noisyRuns = 0;          // Rows measured too noisily here
+    for (int index : selected) {
+        const Benchmark &benchmark = BENCHMARKS[index];
+        const BenchResult *previous = FindBenchResult(baseline, benchmark.name);
+        BenchSummary summary = SummariseSamples(samples[index]);
+        BenchRuns runs = SummariseRuns(runMedians[index]);
+
+        cout << left << setw(22) << benchmark.name << setw(10) << benchmark.operation << right
+             << setw(12) << summary.mean << setw(10) << summary.ci95
+             << setw(12) << summary.median << setw(12) << summary.min
+             << setw(12) << runs.median << setw(7) << runs.spread * 100.0 << "%";
+
+        if (previous != nullptr) {
+            double change = (runs.median / previous->runs.median - 1.0) * 100.0;
+            cout << setw(12) << previous->runs.median << setw(8) << showpos << change << noshowpos << "%";
+            if (verdicts[index] == BENCH_SLOWER) {
+                cout << "  REGRESSION";
+                regressions++;
+            } else if (verdicts[index] == BENCH_FASTER) {
+                cout << "  faster";
+            }
+            if (BenchRunsTooNoisy(previous->runs, options.threshold)) {
+                cout << "  NOISY BASELINE (" << previous->runs.spread * 100.0 << "%)";
+                noisyBaselines++;
+            }
+        } else if (!baseline.empty()) {
+            cout << setw(12) << "-";
+        }
+        if (BenchRunsTooNoisy(runs, options.threshold)) {
+            cout << "  NOISY";
+            noisyRuns++;
+        }
+        cout << "\n";
+
+        if (csv.is_open()) {
+            csv << benchmark.name << "," << summary.samples << "," << summary.mean << "," << summary.stddev << ","
+                << summary.ci95 << "," << summary.median << "," << summary.min << "," << runs.medians.size() << ","
+                << runs.median << "," << runs.spread << ",";
+            for (size_t run = 0; run < runs.medians.size(); run++) {
+                csv << (run > 0 ? " " : "") << runs.medians[run];
+            }
+            csv << "\n";
+        }
+    }
+
+    // A spread wider than the threshold means a change of the threshold's size hides in the noise
+    if (noisyRuns > 0) {
+        cout << "WARNING: " << noisyRuns << " benchmark(s) varied by more than " << options.threshold * 100.0
+             << "% between runs here; the machine is too busy or unsteady to measure changes that small\n";
+    }
+    if (csv.is_open() && noisyRuns > 0) {
+        cout << "Not usable as a baseline: record it again on a quiet machine\n";
+        return 1;
+    }
+
+    if (!baseline.empty()) {
+        if (regressions > 0) {
+            cout << regressions << " benchmark(s) slower than the baseline by more than " << options.threshold * 100.0 << "%\n";
+        }
+        if (noisyBaselines > 0) {
+            cout << noisyBaselines << " benchmark(s) in " << options.baselinePath << " varied by more than "
+                 << options.threshold * 100.0 << "% between runs, so the check cannot pass; record the baseline again "
+                 << "on a quiet machine\n";
+        }
+        if (regressions > 0 || noisyBaselines > 0) return 1;
+        cout << "No regressions against " << options.baselinePath << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,279 @@
+// @file rulesfuzz.cpp
+// @brief Differential fuzzer: plays seeded random games and checks at every position that the bitboard move
+// generator (GenerateMoves) allows exactly what the game's own click handling (ApplyClick/FindValidMoves) does.
+//
+// For every piece of the side to move it clicks the piece, compares the highlighted squares with the first
+// landing squares the generator lists for it, then clicks through every highlighted square (and every
+// continuation of a capture sequence) until the turn passes. Each full turn found that way - start square,
+// landing squares, captured pieces, promotion and the resulting position - must be one of the generator's
+// moves and the other way round. A mismatching position is minimised by removing pieces and un-kinging them
+// for as long as the mismatch remains, then printed as a PDN FEN with a board diagram and the differences.
+// The exit status is 1 if any mismatch was found.
+//
+// Usage: rulesfuzz [--games N] [--seed S] [--max-plies P] [--max-mismatches M] [--fen FEN]
+
+#include "../rules.h"
+#include "../gamestate.h"
+#include "../pdn.h"
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+struct FuzzOptions {
+    int games;
+    unsigned seed;
+    int maxPlies;           // Plies per random game
+    int maxMismatches;      // Stop after reporting this many mismatching positions
+    const char *fen;        // Check only this position, or nullptr to play random games
+};
+
+// A full turn as both sides describe it, with the position it leads to. Ordered so turns can go in a set.
+struct FuzzTurn {
+    Move move;
+    Bitboards after;
+
+    bool operator<(const FuzzTurn &other) const {
+        if (move.from != other.move.from) return move.from < other.move.from;
+        if (move.length != other.move.length) return move.length < other.move.length;
+        int path = memcmp(move.path, other.move.path, move.length);
+        if (path != 0) return path < 0;
+        if (move.captured != other.move.captured) return move.captured < other.move.captured;
+        if (move.capturedKings != other.move.capturedKings) return move.capturedKings < other.move.capturedKings;
+        if (move.promotes != other.move.promotes) return move.promotes < other.move.promotes;
+        return memcmp(&after, &other.after, sizeof(Bitboards)) < 0;
+    }
+};
+
+
+static bool ParseOptions(int argc, char **argv, FuzzOptions &options) {
+    options.games = 1000;
+    options.seed = 1;
+    options.maxPlies = 200;
+    options.maxMismatches = 1;
+    options.fen = nullptr;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+        if (value == nullptr) { cerr << "Missing value for " << arg << "\n"; return false; }
+        else if (strcmp(arg, "--games") == 0) options.games = atoi(value);
+        else if (strcmp(arg, "--seed") == 0) options.seed = (unsigned)strtoul(value, nullptr, 10);
+        else if (strcmp(arg, "--max-plies") == 0) options.maxPlies = atoi(value);
+        else if (strcmp(arg, "--max-mismatches") == 0) options.maxMismatches = atoi(value);
+        else if (strcmp(arg, "--fen") == 0) options.fen = value;
+        else { cerr << "Unknown option " << arg << "\n"; return false; }
+        i++;
+    }
+    return options.games > 0 && options.maxPlies > 0 && options.maxMismatches > 0;
+}
+
+
+static string SquareName(int square) {
+    return to_string(square + 1);  // PDN numbering, as in the FEN
+}
+
+
+static string DescribeTurn(const FuzzTurn &turn) {
+    ostringstream text;
+    text << FormatPdnMove(turn.move);
+    if (turn.move.captured != 0) {
+        text << " takes";
+        for (uint32_t remaining = turn.move.captured; remaining != 0; remaining &= remaining - 1) {
+            text << " " << SquareName(__builtin_ctz(remaining));
+        }
+    }
+    if (turn.move.promotes) text << " (promotes)";
+    text << " -> " << FormatPdnFen(turn.after);
+    return text.str();
+}
+
+
+static string DescribeSquares(uint32_t mask) {
+    string text;
+    for (uint32_t remaining = mask; remaining != 0; remaining &= remaining - 1) {
+        text += (text.empty() ? "" : " ") + SquareName(__builtin_ctz(remaining));
+    }
+    return text.empty() ? "none" : text;
+}
+
+
+// Clicks every highlighted square of the selected piece; a click that passes the turn completes a turn, one
+// that keeps the piece selected in a capture sequence is followed further. Anything else is reported.
+static void FollowLegacyTurns(const GameState &gameState, set<FuzzTurn> &turns, ostringstream &problems) {
+    Player mover = gameState.currentPlayer;
+    for (int i = 0; i < gameState.validMoveCount; i++) {
+        GameState next = gameState;
+        ApplyClick(next, gameState.validMoves[i].x, gameState.validMoves[i].y);
+
+        if (next.currentPlayer != mover) {
+            FuzzTurn turn;
+            turn.move = next.moveHistory.back();
+            GameStateToBitboards(next, turn.after);
+            turns.insert(turn);
+        } else if (next.isCapturing && next.pieceSelected) {
+            FollowLegacyTurns(next, turns, problems);
+        } else {
+            problems << "  clicking highlighted square " << SquareName(SquareIndex(gameState.validMoves[i].x, gameState.validMoves[i].y))
+                     << " after " << FormatPdnMove(gameState.currentMove) << " neither moved nor passed the turn\n";
+        }
+    }
+}
+
+
+// Every difference between the two rule sets in `pos`, one per line; empty if they agree.
+static string CompareRules(const Bitboards &pos) {
+    ostringstream problems;
+
+    MoveList list;
+    GenerateMoves(pos, list);
+    set<FuzzTurn> generated;
+    uint32_t firstLandings[BOARD_SQUARES] = {};
+    for (int i = 0; i < list.count; i++) {
+        FuzzTurn turn;
+        turn.move = list.moves[i];
+        turn.after = pos;
+        MakeMove(turn.after, turn.move);
+        generated.insert(turn);
+        firstLandings[turn.move.from] |= SquareBit(turn.move.path[0]);
+    }
+
+    GameState start;
+    BitboardsToGameState(pos, start);
+
+    set<FuzzTurn> legacy;
+    for (uint32_t remaining = pos.pieces[pos.sideToMove]; remaining != 0; remaining &= remaining - 1) {
+        int square = __builtin_ctz(remaining);
+        GameState selected = start;
+        ApplyClick(selected, SquareX(square), SquareY(square));
+
+        if (selected.validMoveMask != firstLandings[square]) {
+            problems << "  piece on " << SquareName(square) << " highlights " << DescribeSquares(selected.validMoveMask)
+                     << " but the generator starts moves on " << DescribeSquares(firstLandings[square]) << "\n";
+        }
+        FollowLegacyTurns(selected, legacy, problems);
+    }
+
+    for (const FuzzTurn &turn : legacy) {
+        if (generated.count(turn) == 0) problems << "  only the game allows " << DescribeTurn(turn) << "\n";
+    }
+    for (const FuzzTurn &turn : generated) {
+        if (legacy.count(turn) == 0) problems << "  only the generator allows " << DescribeTurn(turn) << "\n";
+    }
+    return problems.str();
+}
+
+
+// Removes pieces and un-kings kings one at a time for as long as the rules still disagree, so the report
+// shows as few pieces as possible. The side to move always keeps at least one piece.
+static Bitboards MinimisePosition(Bitboards pos) {
+    bool reduced = true;
+    while (reduced) {
+        reduced = false;
+        for (int square = 0; square < BOARD_SQUARES; square++) {
+            uint32_t bit = SquareBit(square);
+            Bitboards smaller = pos;
+            if (smaller.kings & bit) {
+                smaller.kings &= ~bit;
+            } else if ((smaller.pieces[0] | smaller.pieces[1]) & bit) {
+                smaller.pieces[0] &= ~bit;
+                smaller.pieces[1] &= ~bit;
+                if (smaller.pieces[smaller.sideToMove] == 0) continue;
+            } else {
+                continue;
+            }
+
+            if (!CompareRules(smaller).empty()) {
+                pos = smaller;
+                reduced = true;
+            }
+        }
+    }
+    return pos;
+}
+
+
+// The board as the game window shows it, PLAYER1 at the top: b/B are PLAYER1 men/kings, w/W PLAYER2's.
+static void PrintBoard(const Bitboards &pos) {
+    for (int y = 0; y < 8; y++) {
+        cout << "  ";
+        for (int x = 0; x < 8; x++) {
+            char cell = ' ';
+            if ((x + y) % 2 != 0) {
+                uint32_t bit = SquareBit(SquareIndex(x, y));
+                bool king = (pos.kings & bit) != 0;
+                if (pos.pieces[0] & bit) cell = king ? 'B' : 'b';
+                else if (pos.pieces[1] & bit) cell = king ? 'W' : 'w';
+                else cell = '.';
+            }
+            cout << cell << ' ';
+        }
+        cout << "  " << SquareName(SquareIndex(1 - y % 2, y)) << "-" << SquareName(SquareIndex(7 - y % 2, y)) << "\n";
+    }
+    cout << "  " << (pos.sideToMove == 0 ? "Black (PLAYER1)" : "White (PLAYER2)") << " to move\n";
+}
+
+
+static void ReportMismatch(const Bitboards &pos, const string &where) {
+    Bitboards minimal = MinimisePosition(pos);
+    cout << "Mismatch " << where << "\n";
+    cout << "  found in   " << FormatPdnFen(pos) << "\n";
+    cout << "  minimised  " << FormatPdnFen(minimal) << "\n";
+    PrintBoard(minimal);
+    cout << CompareRules(minimal);
+}
+
+
+int main(int argc, char **argv) {
+    FuzzOptions options;
+    if (!ParseOptions(argc, argv, options)) {
+        cerr << "Usage: rulesfuzz [--games N] [--seed S] [--max-plies P] [--max-mismatches M] [--fen FEN]\n";
+        return 2;
+    }
+
+    if (options.fen != nullptr) {
+        Bitboards pos;
+        if (!ParsePdnFen(options.fen, pos)) {
+            cerr << "Error: Could not parse FEN " << options.fen << "\n";
+            return 2;
+        }
+        if (CompareRules(pos).empty()) {
+            cout << "The rules agree on " << FormatPdnFen(pos) << "\n";
+            return 0;
+        }
+        ReportMismatch(pos, "in the given position");
+        return 1;
+    }
+
+    mt19937 random(options.seed);
+    MoveList list;
+    long long positions = 0;
+    int mismatches = 0;
+
+    for (int game = 0; game < options.games && mismatches < options.maxMismatches; game++) {
+        Bitboards pos;
+        InitialBitboards(pos);
+
+        for (int ply = 0; ply < options.maxPlies; ply++) {
+            positions++;
+            if (!CompareRules(pos).empty()) {
+                ReportMismatch(pos, "in game " + to_string(game + 1) + " at ply " + to_string(ply + 1));
+                mismatches++;
+                break;  // The rest of this game would mostly repeat the same difference
+            }
+
+            GenerateMoves(pos, list);
+            if (list.count == 0) break;
+            MakeMove(pos, list.moves[random() % list.count]);
+        }
+    }
+
+    cout << "Checked " << positions << " positions, " << mismatches << " mismatching (seed " << options.seed << ")\n";
+    return (mismatches > 0) ? 1 : 0;
+}
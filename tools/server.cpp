@@ -0,0 +1,869 @@
+// @file server.cpp
+// @brief Multi-game server: pooled game store, spectator feeds, epoll event loop and the protocol commands.
+
+#include "server.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+using namespace std;
+
+static_assert(sizeof(ServerGame) == 32, "ServerGame should stay half a cache line");
+
+const GameFeed EMPTY_FEED = { 0, -1, -1, 0, false };
+
+
+void InitGameStore(GameStore &store) {
+    store.games.clear();
+    store.freeSlots.clear();
+    store.waitingGame = -1;
+    store.gamesStarted = 0;
+}
+
+
+int32_t AllocateGame(GameStore &store) {
+    int32_t slot;
+    if (!store.freeSlots.empty()) {
+        slot = (int32_t)store.freeSlots.back();
+        store.freeSlots.pop_back();
+    } else {
+        slot = (int32_t)store.games.size();
+        store.games.emplace_back();
+    }
+
+    ServerGame &game = store.games[slot];
+    InitialBitboards(game.pos);
+    game.players[0] = -1;
+    game.players[1] = -1;
+    game.number = ++store.gamesStarted;
+    game.plies = 0;
+    game.state = SERVER_GAME_WAITING;
+    game.padding = 0;
+    return slot;
+}
+
+
+void FreeGame(GameStore &store, int32_t slot) {
+    store.games[slot].state = SERVER_GAME_FREE;
+    store.freeSlots.push_back((uint32_t)slot);
+    if (store.waitingGame == slot) {
+        store.waitingGame = -1;
+    }
+}
+
+
+// Only changes the registration when it differs, so the common case of a fully written reply costs no system call.
+static void SetWatchOutput(GameServer &server, int socket, bool watchOutput) {
+    ServerConnection &connection = server.connections[socket];
+    if (connection.watchingOutput == watchOutput) return;
+    connection.watchingOutput = watchOutput;
+
+    epoll_event event;
+    event.events = EPOLLIN | EPOLLRDHUP | (watchOutput ? EPOLLOUT : 0);
+    event.data.fd = socket;
+    epoll_ctl(server.epollHandle, EPOLL_CTL_MOD, socket, &event);
+}
+
+
+static void CloseConnection(GameServer &server, int socket);
+
+
+static uint64_t NowMs() {
+    return (uint64_t)chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+// Has the connection written at the end of the poll.
+static void QueueFlush(GameServer &server, int socket) {
+    ServerConnection &connection = server.connections[socket];
+    if (!connection.flushQueued) {
+        connection.flushQueued = true;
+        server.pendingFlush.push_back(socket);
+    }
+}
+
+
+// Appends a message to the connection's output; it is written at the end of the poll.
+static void QueueMessage(GameServer &server, int socket, ProtocolCommand command, const uint8_t *payload, int payloadLength) {
+    if (socket < 0) return;  // Empty seat
+    ServerConnection &connection = server.connections[socket];
+    if (!connection.open) return;
+
+    int length = WriteProtocolMessage(connection.output + connection.outputLength, SERVER_OUTPUT_BUFFER - connection.outputLength,
+                                      command, payload, payloadLength);
+    if (length == 0) {
+        server.stats.slowDisconnects++;
+        CloseConnection(server, socket);
+        return;
+    }
+    connection.outputLength += (uint16_t)length;
+    QueueFlush(server, socket);
+}
+
+
+static void QueueError(GameServer &server, int socket, ProtocolError error) {
+    uint8_t code = (uint8_t)error;
+    QueueMessage(server, socket, PROTOCOL_ERROR, &code, 1);
+}
+
+
+// A chunk holding one reference: the caller's.
+static int32_t AllocateChunk(GameServer &server, uint64_t start) {
+    int32_t index;
+    if (!server.freeChunks.empty()) {
+        index = (int32_t)server.freeChunks.back();
+        server.freeChunks.pop_back();
+    } else {
+        index = (int32_t)server.chunks.size();
+        server.chunks.emplace_back();
+    }
+    BroadcastChunk &chunk = server.chunks[index];
+    chunk.start = start;
+    chunk.next = -1;
+    chunk.refs = 1;
+    chunk.length = 0;
+    return index;
+}
+
+
+// Drops one reference; a chunk that is no longer referenced also lets go of the one after it.
+static void ReleaseChunk(GameServer &server, int32_t index) {
+    while (index >= 0) {
+        BroadcastChunk &chunk = server.chunks[index];
+        if (--chunk.refs > 0) return;
+        server.freeChunks.push_back((uint32_t)index);
+        index = chunk.next;
+    }
+}
+
+
+// Writes a message into the game's feed once, for all of its watchers. Messages never span two chunks.
+static void AppendToFeed(GameServer &server, GameFeed &feed, const uint8_t *message, int length) {
+    if (server.chunks[feed.chunk].length + length > SPECTATOR_CHUNK_SIZE) {
+        int32_t next = AllocateChunk(server, feed.length);  // The game's reference moves over to the new chunk
+        server.chunks[next].refs++;
+        server.chunks[feed.chunk].next = next;
+        ReleaseChunk(server, feed.chunk);
+        feed.chunk = next;
+    }
+    BroadcastChunk &chunk = server.chunks[feed.chunk];
+    memcpy(chunk.data + chunk.length, message, length);
+    chunk.length += (uint16_t)length;
+    feed.length += (uint64_t)length;
+}
+
+
+// Moves the connection's place in the feed on by `sent` bytes, one message at a time so it always knows
+// whether the last write cut a message short.
+static void AdvanceFeed(GameServer &server, ServerConnection &connection, size_t sent) {
+    while (connection.feedChunk >= 0) {
+        BroadcastChunk &chunk = server.chunks[connection.feedChunk];
+        if (connection.feedOffset == chunk.length) {
+            if (chunk.next < 0) return;  // Caught up
+            int32_t next = chunk.next;
+            server.chunks[next].refs++;
+            ReleaseChunk(server, connection.feedChunk);
+            connection.feedChunk = next;
+            connection.feedOffset = 0;
+            continue;
+        }
+        if (sent == 0) return;
+        size_t left = (connection.feedCut > 0) ? connection.feedCut : PROTOCOL_HEADER_SIZE + chunk.data[connection.feedOffset + 1];
+        size_t taken = min(left, sent);
+        connection.feedOffset += (uint16_t)taken;
+        connection.feedCut = (uint8_t)(left - taken);
+        sent -= taken;
+    }
+}
+
+
+// Lets go of the feed, dropping the unsent messages. The rest of a message the last write cut short goes in
+// front of the replies, so the stream stays whole. Returns false, having closed the connection, if the
+// replies leave no room for it.
+static bool DetachFeed(GameServer &server, int socket) {
+    ServerConnection &connection = server.connections[socket];
+    if (connection.feedChunk < 0) return true;
+    if (connection.feedCut > 0) {
+        if (connection.outputLength + connection.feedCut > SERVER_OUTPUT_BUFFER) {
+            server.stats.slowDisconnects++;
+            CloseConnection(server, socket);
+            return false;
+        }
+        memmove(connection.output + connection.feedCut, connection.output, connection.outputLength);
+        memcpy(connection.output, server.chunks[connection.feedChunk].data + connection.feedOffset, connection.feedCut);
+        connection.outputLength += connection.feedCut;
+        connection.feedCut = 0;
+        QueueFlush(server, socket);
+    }
+    ReleaseChunk(server, connection.feedChunk);
+    connection.feedChunk = -1;
+    return true;
+}
+
+
+static void QueueSnapshot(GameServer &server, int socket, int32_t slot) {
+    const ServerGame &game = server.store.games[slot];
+    uint8_t payload[6 + PROTOCOL_POSITION_SIZE];
+    PutProtocolU32(payload, game.number);
+    PutProtocolU16(payload + 4, game.plies);
+    EncodeProtocolPosition(game.pos, payload + 6);
+    QueueMessage(server, socket, PROTOCOL_SNAPSHOT, payload, sizeof(payload));
+    server.stats.snapshots++;
+}
+
+
+// Sends the watcher the position and has it follow the feed from there. It must not hold the feed already.
+static void JoinFeed(GameServer &server, int socket, int32_t slot) {
+    QueueSnapshot(server, socket, slot);
+    ServerConnection &connection = server.connections[socket];
+    if (!connection.open) return;
+
+    GameFeed &feed = server.feeds[slot];
+    if (feed.chunk < 0) {
+        feed.chunk = AllocateChunk(server, feed.length);
+    }
+    BroadcastChunk &chunk = server.chunks[feed.chunk];
+    chunk.refs++;
+    connection.feedChunk = feed.chunk;
+    connection.feedOffset = chunk.length;
+    connection.feedCut = 0;
+    connection.lagging = false;
+}
+
+
+static void StartWatching(GameServer &server, int socket, int32_t slot) {
+    int sendBuffer = SPECTATOR_SEND_BUFFER;  // Fixed, instead of letting the kernel grow it to megabytes per watcher
+    setsockopt(socket, SOL_SOCKET, SO_SNDBUF, &sendBuffer, sizeof(sendBuffer));
+
+    ServerConnection &connection = server.connections[socket];
+    GameFeed &feed = server.feeds[slot];
+    connection.watching = slot;
+    connection.previousWatcher = -1;
+    connection.nextWatcher = feed.firstWatcher;
+    if (feed.firstWatcher >= 0) {
+        server.connections[feed.firstWatcher].previousWatcher = socket;
+    }
+    feed.firstWatcher = socket;
+    feed.watchers++;
+    server.stats.watchers++;
+    JoinFeed(server, socket, slot);
+}
+
+
+// Takes the connection off its game's watcher list; its place in the feed is left to the caller.
+static void StopWatching(GameServer &server, int socket) {
+    ServerConnection &connection = server.connections[socket];
+    if (connection.watching < 0) return;
+
+    GameFeed &feed = server.feeds[connection.watching];
+    if (connection.previousWatcher >= 0) {
+        server.connections[connection.previousWatcher].nextWatcher = connection.nextWatcher;
+    } else {
+        feed.firstWatcher = connection.nextWatcher;
+    }
+    if (connection.nextWatcher >= 0) {
+        server.connections[connection.nextWatcher].previousWatcher = connection.previousWatcher;
+    }
+    connection.watching = -1;
+    connection.lagging = false;
+    server.stats.watchers--;
+    if (--feed.watchers == 0 && feed.chunk >= 0) {
+        ReleaseChunk(server, feed.chunk);  // Nothing is appended while nobody watches
+        feed.chunk = -1;
+    }
+}
+
+
+// A watcher too far behind stops holding the feed and waits for a snapshot instead.
+static void FallBehind(GameServer &server, int socket) {
+    if (!DetachFeed(server, socket)) return;
+    server.connections[socket].lagging = true;
+    server.laggingWatchers.push_back(socket);
+    server.stats.watchersBehind++;
+}
+
+
+// True if the watcher follows the feed and is no more than SPECTATOR_MAX_LAG bytes behind its end.
+static bool KeepsUp(const GameServer &server, const GameFeed &feed, const ServerConnection &watcher) {
+    if (watcher.lagging) return false;
+    const BroadcastChunk &chunk = server.chunks[watcher.feedChunk];
+    return feed.length - (chunk.start + watcher.feedOffset) <= (uint64_t)SPECTATOR_MAX_LAG;
+}
+
+
+// Sends a message of the game to all of its watchers. It is only written into the feed here, once; the
+// watchers are not touched until the feed is fanned out, so a move costs the same however many watch.
+static void BroadcastToWatchers(GameServer &server, int32_t slot, ProtocolCommand command, const uint8_t *payload, int payloadLength) {
+    GameFeed &feed = server.feeds[slot];
+    if (feed.watchers == 0) return;
+
+    uint8_t message[PROTOCOL_MAX_MESSAGE];
+    int length = WriteProtocolMessage(message, sizeof(message), command, payload, payloadLength);
+    AppendToFeed(server, feed, message, length);
+    server.stats.feedMessages++;
+    if (!feed.pending) {
+        feed.pending = true;
+        server.pendingFeeds.push_back(slot);
+    }
+}
+
+
+// Every SPECTATOR_FAN_OUT_MS: has the watchers of each feed that grew write what it gained, so a watcher
+// costs one write per interval however many moves were made, and switches the ones too far behind to snapshots.
+static void FanOutFeeds(GameServer &server) {
+    for (int32_t slot : server.pendingFeeds) {
+        GameFeed &feed = server.feeds[slot];
+        if (!feed.pending) continue;  // Finished, or listed twice because its slot was reused
+        feed.pending = false;
+        for (int socket = feed.firstWatcher; socket >= 0; ) {
+            ServerConnection &watcher = server.connections[socket];
+            int next = watcher.nextWatcher;  // Falling behind can close the connection
+            if (KeepsUp(server, feed, watcher)) {
+                QueueFlush(server, socket);
+            } else if (!watcher.lagging) {
+                FallBehind(server, socket);
+            }
+            socket = next;
+        }
+    }
+    server.pendingFeeds.clear();
+}
+
+
+// Sends END to the game's watchers and takes them all off the game, without waiting for the next fan-out.
+// Watchers that keep up still hold the feed until END has been written; the others get END on its own.
+static void FinishFeed(GameServer &server, int32_t slot, int winner) {
+    uint8_t payload = (uint8_t)winner;
+    BroadcastToWatchers(server, slot, PROTOCOL_END, &payload, 1);
+
+    GameFeed &feed = server.feeds[slot];
+    for (int socket = feed.firstWatcher; socket >= 0; ) {
+        ServerConnection &watcher = server.connections[socket];
+        int next = watcher.nextWatcher;
+        bool keepsUp = KeepsUp(server, feed, watcher);
+        watcher.watching = -1;
+        watcher.lagging = false;
+        server.stats.watchers--;
+        if (keepsUp) {
+            QueueFlush(server, socket);
+        } else if (DetachFeed(server, socket)) {
+            QueueMessage(server, socket, PROTOCOL_END, &payload, 1);
+        }
+        socket = next;
+    }
+    if (feed.chunk >= 0) {
+        ReleaseChunk(server, feed.chunk);
+    }
+    feed = EMPTY_FEED;  // Also takes it off the pending fan-out
+}
+
+
+// Ends the game in `slot`: tells both players who won (if anyone is still there) and frees the slot.
+static void FinishGame(GameServer &server, int32_t slot, int winner) {
+    ServerGame &game = server.store.games[slot];
+    uint8_t payload = (uint8_t)winner;
+    for (int side = 0; side < 2; side++) {
+        int socket = game.players[side];
+        if (socket < 0) continue;
+        server.connections[socket].game = -1;
+        QueueMessage(server, socket, PROTOCOL_END, &payload, 1);
+    }
+    FinishFeed(server, slot, winner);
+    if (game.state == SERVER_GAME_PLAYING) {
+        server.stats.gamesFinished++;
+    }
+    FreeGame(server.store, slot);
+}
+
+
+// Leaving a game forfeits it; leaving before an opponent arrived just closes it.
+static void LeaveGame(GameServer &server, int socket) {
+    ServerConnection &connection = server.connections[socket];
+    if (connection.game < 0) return;
+
+    int32_t slot = connection.game;
+    ServerGame &game = server.store.games[slot];
+    game.players[connection.side] = -1;
+    connection.game = -1;
+    if (game.state == SERVER_GAME_PLAYING) {
+        FinishGame(server, slot, connection.side ^ 1);
+    } else {
+        FreeGame(server.store, slot);
+    }
+}
+
+
+static void CloseConnection(GameServer &server, int socket) {
+    ServerConnection &connection = server.connections[socket];
+    if (!connection.open) return;
+    connection.open = false;
+    LeaveGame(server, socket);
+    StopWatching(server, socket);
+    if (connection.feedChunk >= 0) {
+        ReleaseChunk(server, connection.feedChunk);
+        connection.feedChunk = -1;
+    }
+    epoll_ctl(server.epollHandle, EPOLL_CTL_DEL, socket, nullptr);
+    close(socket);
+    server.stats.connectionsOpen--;
+}
+
+
+static void HandlePlay(GameServer &server, int socket) {
+    ServerConnection &connection = server.connections[socket];
+    if (connection.game >= 0 || connection.watching >= 0) {
+        QueueError(server, socket, PROTOCOL_ERROR_ALREADY_IN_GAME);
+        return;
+    }
+
+    GameStore &store = server.store;
+    if (store.waitingGame < 0) {
+        int32_t slot = AllocateGame(store);
+        if (server.feeds.size() < store.games.size()) {
+            server.feeds.resize(store.games.size(), EMPTY_FEED);
+        }
+        store.games[slot].players[0] = socket;
+        store.waitingGame = slot;
+        connection.game = slot;
+        connection.side = 0;
+        QueueMessage(server, socket, PROTOCOL_WAIT, nullptr, 0);
+        return;
+    }
+
+    int32_t slot = store.waitingGame;
+    ServerGame &game = store.games[slot];
+    game.players[1] = socket;
+    game.state = SERVER_GAME_PLAYING;
+    store.waitingGame = -1;
+    connection.game = slot;
+    connection.side = 1;
+    server.stats.gamesStarted++;
+
+    uint8_t payload[5 + PROTOCOL_POSITION_SIZE];
+    PutProtocolU32(payload, game.number);
+    EncodeProtocolPosition(game.pos, payload + 5);
+    for (int side = 0; side < 2; side++) {
+        payload[4] = (uint8_t)side;
+        QueueMessage(server, game.players[side], PROTOCOL_START, payload, sizeof(payload));
+    }
+}
+
+
+static void HandleMove(GameServer &server, int socket, const ProtocolMessage &message) {
+    ServerConnection &connection = server.connections[socket];
+    if (connection.game < 0 || server.store.games[connection.game].state != SERVER_GAME_PLAYING) {
+        QueueError(server, socket, PROTOCOL_ERROR_NOT_IN_GAME);
+        server.stats.movesRejected++;
+        return;
+    }
+    int32_t slot = connection.game;
+    ServerGame &game = server.store.games[slot];
+    if ((int)game.pos.sideToMove != connection.side) {
+        QueueError(server, socket, PROTOCOL_ERROR_NOT_YOUR_TURN);
+        server.stats.movesRejected++;
+        return;
+    }
+
+    Move move;
+    if (!DecodeProtocolTurn(game.pos, message.payload, message.payloadLength, move)) {
+        QueueError(server, socket, PROTOCOL_ERROR_ILLEGAL_MOVE);
+        server.stats.movesRejected++;
+        return;
+    }
+
+    MakeMove(game.pos, move);
+    game.plies++;
+    server.stats.movesPlayed++;
+    uint8_t played[PROTOCOL_MAX_TURN];
+    int playedLength = EncodeProtocolTurn(move, played);
+    BroadcastToWatchers(server, slot, PROTOCOL_MOVE, played, playedLength);  // First, in case a player forfeits below
+    for (int side = 0; side < 2 && game.state == SERVER_GAME_PLAYING; side++) {
+        QueueMessage(server, game.players[side], PROTOCOL_MOVE, played, playedLength);
+    }
+    if (game.state != SERVER_GAME_PLAYING) return;  // A player was too slow to take the move and forfeited; the other already has END
+
+    // The player left to move loses when they have no turn
+    MoveList replies;
+    GenerateMoves(game.pos, replies);
+    if (replies.count == 0) {
+        FinishGame(server, slot, connection.side);
+    }
+}
+
+
+// A client that lost track of its game gets the whole position once, and follows the turns from there.
+static void HandleSync(GameServer &server, int socket) {
+    ServerConnection &connection = server.connections[socket];
+    if (connection.game < 0 || server.store.games[connection.game].state != SERVER_GAME_PLAYING) {
+        QueueError(server, socket, PROTOCOL_ERROR_NOT_IN_GAME);
+        return;
+    }
+    const ServerGame &game = server.store.games[connection.game];
+    uint8_t payload[2 + PROTOCOL_POSITION_SIZE];
+    PutProtocolU16(payload, game.plies);
+    EncodeProtocolPosition(game.pos, payload + 2);
+    QueueMessage(server, socket, PROTOCOL_POSITION, payload, sizeof(payload));
+    server.stats.resyncs++;
+}
+
+
+// The running game with this number, or for 0 the one with the most watchers (the newest among equals).
+// A scan of the store, which is fine for a request that comes once per game watched.
+static int32_t FindWatchedGame(const GameServer &server, uint32_t number) {
+    const vector<ServerGame> &games = server.store.games;
+    int32_t found = -1;
+    for (int32_t slot = 0; slot < (int32_t)games.size(); slot++) {
+        if (games[slot].state != SERVER_GAME_PLAYING) continue;
+        if (number != 0) {
+            if (games[slot].number == number) return slot;
+        } else if (found < 0 || server.feeds[slot].watchers > server.feeds[found].watchers ||
+                   (server.feeds[slot].watchers == server.feeds[found].watchers && games[slot].number > games[found].number)) {
+            found = slot;
+        }
+    }
+    return found;
+}
+
+
+static void HandleWatch(GameServer &server, int socket, const ProtocolMessage &message) {
+    if (server.connections[socket].game >= 0) {
+        QueueError(server, socket, PROTOCOL_ERROR_ALREADY_IN_GAME);
+        return;
+    }
+    int32_t slot = FindWatchedGame(server, GetProtocolU32(message.payload));
+    if (slot < 0) {
+        QueueError(server, socket, PROTOCOL_ERROR_NO_SUCH_GAME);
+        return;
+    }
+    StopWatching(server, socket);
+    if (DetachFeed(server, socket)) {
+        StartWatching(server, socket, slot);
+    }
+}
+
+
+static void HandleMessage(GameServer &server, int socket, const uint8_t *data, int length) {
+    ProtocolMessage message;
+    if (!ParseProtocolMessage(data, length, message)) {
+        QueueError(server, socket, PROTOCOL_ERROR_BAD_MESSAGE);
+        return;
+    }
+    switch (message.command) {
+    case PROTOCOL_PLAY:
+        HandlePlay(server, socket);
+        break;
+    case PROTOCOL_MOVE:
+        HandleMove(server, socket, message);
+        break;
+    case PROTOCOL_PING:
+        QueueMessage(server, socket, PROTOCOL_PONG, message.payload, message.payloadLength);
+        break;
+    case PROTOCOL_QUIT:
+        LeaveGame(server, socket);
+        StopWatching(server, socket);
+        DetachFeed(server, socket);
+        break;
+    case PROTOCOL_SYNC:
+        HandleSync(server, socket);
+        break;
+    case PROTOCOL_WATCH:
+        HandleWatch(server, socket, message);
+        break;
+    default:
+        QueueError(server, socket, PROTOCOL_ERROR_BAD_MESSAGE);
+        break;
+    }
+}
+
+
+// Reads everything available and handles each complete message. Returns false if the connection was closed.
+static bool ReadConnection(GameServer &server, int socket) {
+    uint8_t buffer[4096];
+    while (true) {
+        ssize_t received = recv(socket, buffer, sizeof(buffer), 0);
+        if (received == 0 || (received < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            CloseConnection(server, socket);
+            return false;
+        }
+        if (received < 0) {
+            if (errno == EINTR) continue;
+            return true;  // Everything available has been read
+        }
+        server.stats.bytesIn += (uint64_t)received;
+
+        // Messages are handled straight from the receive buffer; only one cut off at the end is copied
+        int offset = 0;
+        while (offset < received) {
+            ServerConnection &connection = server.connections[socket];
+            if (!connection.open) return false;
+
+            if (connection.inputLength == 0) {
+                int length = FindProtocolMessage(buffer + offset, (int)received - offset);
+                if (length > 0) {
+                    HandleMessage(server, socket, buffer + offset, length);
+                    offset += length;
+                    continue;
+                }
+                if (length < 0) {
+                    CloseConnection(server, socket);  // Not a message header, so the stream cannot be followed any further
+                    return false;
+                }
+            }
+
+            // Complete the partial message a byte at a time; it is at most PROTOCOL_MAX_MESSAGE long
+            connection.input[connection.inputLength++] = buffer[offset++];
+            int length = FindProtocolMessage(connection.input, connection.inputLength);
+            if (length < 0) {
+                CloseConnection(server, socket);
+                return false;
+            }
+            if (length > 0) {
+                connection.inputLength = 0;
+                HandleMessage(server, socket, connection.input, length);
+            }
+        }
+    }
+}
+
+
+// Writes as much queued output and unsent feed as the socket takes, in one vectored write; the rest waits
+// for EPOLLOUT. The replies go first, unless the last write cut a feed message short.
+static void FlushConnection(GameServer &server, int socket) {
+    ServerConnection &connection = server.connections[socket];
+    if (!connection.open) return;
+
+    iovec parts[SPECTATOR_WRITE_PARTS];
+    int partCount = 0;
+    size_t feedBytes = 0;
+    bool feedFirst = connection.feedCut > 0;
+    if (!feedFirst && connection.outputLength > 0) {
+        parts[partCount].iov_base = connection.output;
+        parts[partCount++].iov_len = connection.outputLength;
+    }
+    for (int32_t index = connection.feedChunk, offset = connection.feedOffset; index >= 0 && partCount < SPECTATOR_WRITE_PARTS - 1; ) {
+        BroadcastChunk &chunk = server.chunks[index];
+        if (chunk.length > offset) {
+            parts[partCount].iov_base = chunk.data + offset;
+            parts[partCount++].iov_len = chunk.length - offset;
+            feedBytes += chunk.length - offset;
+        }
+        index = chunk.next;
+        offset = 0;
+    }
+    if (feedFirst && connection.outputLength > 0) {
+        parts[partCount].iov_base = connection.output;
+        parts[partCount++].iov_len = connection.outputLength;
+    }
+
+    ssize_t sent = 0;
+    if (partCount > 0) {
+        msghdr message;
+        memset(&message, 0, sizeof(message));
+        message.msg_iov = parts;
+        message.msg_iovlen = partCount;
+        sent = sendmsg(socket, &message, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) CloseConnection(server, socket);
+            sent = 0;
+        }
+        if (!connection.open) return;
+        server.stats.bytesOut += (uint64_t)sent;
+    }
+
+    size_t feedSent = feedFirst ? min((size_t)sent, feedBytes) : (size_t)sent - min((size_t)sent, (size_t)connection.outputLength);
+    size_t outputSent = (size_t)sent - feedSent;
+    memmove(connection.output, connection.output + outputSent, connection.outputLength - outputSent);
+    connection.outputLength -= (uint16_t)outputSent;
+    AdvanceFeed(server, connection, feedSent);
+
+    // A watcher whose game ended lets go of the feed once END is out
+    bool feedPending = false;
+    if (connection.feedChunk >= 0) {
+        const BroadcastChunk &chunk = server.chunks[connection.feedChunk];
+        feedPending = connection.feedOffset < chunk.length || chunk.next >= 0;
+        if (!feedPending && connection.watching < 0) {
+            ReleaseChunk(server, connection.feedChunk);
+            connection.feedChunk = -1;
+        }
+    }
+    SetWatchOutput(server, socket, connection.outputLength > 0 || feedPending);
+}
+
+
+// Every SPECTATOR_SNAPSHOT_MS: watchers that fell behind and have written everything queued for them get the
+// position and follow the feed again from there. The others keep waiting.
+static void SendSnapshots(GameServer &server) {
+    size_t kept = 0;
+    for (int socket : server.laggingWatchers) {
+        ServerConnection &connection = server.connections[socket];
+        if (!connection.open || !connection.lagging) continue;
+        if (connection.outputLength > 0) {
+            server.laggingWatchers[kept++] = socket;
+            continue;
+        }
+        JoinFeed(server, socket, connection.watching);
+    }
+    server.laggingWatchers.resize(kept);
+}
+
+
+static void AcceptConnections(GameServer &server) {
+    while (true) {
+        int socket = accept4(server.listenSocket, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (socket < 0) return;  // EAGAIN once the backlog is empty, or out of sockets
+        if (socket >= SERVER_MAX_CONNECTIONS) {
+            close(socket);
+            continue;
+        }
+
+        int noDelay = 1;  // Messages are tiny and each one is waited for
+        setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+        if ((int)server.connections.size() <= socket) {
+            server.connections.resize(socket + 1);
+        }
+        ServerConnection &connection = server.connections[socket];
+        connection.open = true;
+        connection.openedInPoll = server.polls;
+        connection.flushQueued = false;
+        connection.watchingOutput = false;
+        connection.side = 0;
+        connection.game = -1;
+        connection.watching = -1;
+        connection.previousWatcher = -1;
+        connection.nextWatcher = -1;
+        connection.lagging = false;
+        connection.feedChunk = -1;
+        connection.feedOffset = 0;
+        connection.feedCut = 0;
+        connection.inputLength = 0;
+        connection.outputLength = 0;
+
+        epoll_event event;
+        event.events = EPOLLIN | EPOLLRDHUP;
+        event.data.fd = socket;
+        epoll_ctl(server.epollHandle, EPOLL_CTL_ADD, socket, &event);
+        server.stats.connectionsAccepted++;
+        server.stats.connectionsOpen++;
+    }
+}
+
+
+bool StartServer(GameServer &server, const string &address, int port, string &error) {
+    sockaddr_in bindAddress;
+    memset(&bindAddress, 0, sizeof(bindAddress));
+    bindAddress.sin_family = AF_INET;
+    bindAddress.sin_port = htons((uint16_t)port);
+    if (inet_pton(AF_INET, address.c_str(), &bindAddress.sin_addr) != 1) {
+        error = "not an IPv4 address: " + address;
+        return false;
+    }
+
+    memset(&server.stats, 0, sizeof(server.stats));
+    server.polls = 0;
+    InitGameStore(server.store);
+    server.connections.clear();
+    server.pendingFlush.clear();
+    server.feeds.clear();
+    server.chunks.clear();
+    server.freeChunks.clear();
+    server.laggingWatchers.clear();
+    server.pendingFeeds.clear();
+    server.nextSnapshotAt = 0;
+    server.nextFanOutAt = 0;
+
+    server.listenSocket = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (server.listenSocket < 0) {
+        error = strerror(errno);
+        return false;
+    }
+    int reuse = 1;
+    setsockopt(server.listenSocket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    socklen_t addressLength = sizeof(bindAddress);
+    if (bind(server.listenSocket, (sockaddr *)&bindAddress, sizeof(bindAddress)) != 0 ||
+        listen(server.listenSocket, SOMAXCONN) != 0 ||
+        getsockname(server.listenSocket, (sockaddr *)&bindAddress, &addressLength) != 0) {
+        error = strerror(errno);
+        close(server.listenSocket);
+        return false;
+    }
+    server.port = ntohs(bindAddress.sin_port);
+
+    server.epollHandle = epoll_create1(EPOLL_CLOEXEC);
+    epoll_event event;
+    event.events = EPOLLIN;
+    event.data.fd = server.listenSocket;
+    epoll_ctl(server.epollHandle, EPOLL_CTL_ADD, server.listenSocket, &event);
+    return true;
+}
+
+
+void PollServer(GameServer &server, int timeoutMs) {
+    if (!server.pendingFeeds.empty()) {  // Wake up in time for the fan-out
+        uint64_t now = NowMs();
+        timeoutMs = (now >= server.nextFanOutAt) ? 0 : min(timeoutMs, (int)(server.nextFanOutAt - now));
+    }
+    epoll_event events[SERVER_EVENTS_PER_POLL];
+    int count = epoll_wait(server.epollHandle, events, SERVER_EVENTS_PER_POLL, timeoutMs);
+    server.polls++;
+
+    for (int i = 0; i < count; i++) {
+        int socket = events[i].data.fd;
+        if (socket == server.listenSocket) {
+            AcceptConnections(server);
+            continue;
+        }
+        // Closed earlier in this poll; or closed and the number reused by a connection accepted since, which
+        // the events in this batch cannot be for
+        const ServerConnection &connection = server.connections[socket];
+        if (!connection.open || connection.openedInPoll == server.polls) continue;
+
+        if (events[i].events & EPOLLIN) {
+            if (!ReadConnection(server, socket)) continue;
+        }
+        if (events[i].events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+            CloseConnection(server, socket);
+        } else if (events[i].events & EPOLLOUT) {
+            FlushConnection(server, socket);
+        }
+    }
+
+    uint64_t now = NowMs();
+    if (now >= server.nextFanOutAt) {
+        FanOutFeeds(server);
+        server.nextFanOutAt = now + SPECTATOR_FAN_OUT_MS;
+    }
+    if (now >= server.nextSnapshotAt) {
+        SendSnapshots(server);
+        server.nextSnapshotAt = now + SPECTATOR_SNAPSHOT_MS;
+    }
+
+    // One write per connection for everything queued in this poll
+    for (int socket : server.pendingFlush) {
+        server.connections[socket].flushQueued = false;
+        FlushConnection(server, socket);
+    }
+    server.pendingFlush.clear();
+}
+
+
+void StopServer(GameServer &server) {
+    for (int socket = 0; socket < (int)server.connections.size(); socket++) {
+        if (server.connections[socket].open) {
+            FlushConnection(server, socket);
+            CloseConnection(server, socket);
+        }
+    }
+    close(server.epollHandle);
+    close(server.listenSocket);
+}
@@ -0,0 +1,141 @@
+// @file server.h
+// @brief Multi-game server: many independent games in a pooled store, served over TCP with an epoll loop.
+//
+// Linux only. One thread does everything: PollServer waits for socket events, handles each binary message
+// (protocol.h) where it lies in the receive buffer, checks every move with the shared rules, and queues the
+// replies. Replies are collected in each connection's output buffer during a poll and sent with one write
+// per connection at the end of it. A connection whose output buffer fills up is too slow and is dropped.
+//
+// Games live in one array of 32-byte slots reused through a free list, so a game is a single cache line
+// access; connections are found by socket number in a second array.
+//
+// Spectators: each move of a watched game is written once into the game's feed, a chain of shared,
+// reference-counted chunks, and nothing else happens on the move. A watcher only holds a position in that
+// feed. Every SPECTATOR_FAN_OUT_MS the watchers of the feeds that grew are flushed, each with one vectored
+// write of its own replies and all the feed bytes it has not sent, so a move costs the same for one watcher
+// as for thousands and a watcher costs one write per interval, not one per move. A watcher that falls more
+// than SPECTATOR_MAX_LAG bytes behind lets go of the feed; once it has written everything queued for it, it
+// gets a SNAPSHOT of the position at the next SPECTATOR_SNAPSHOT_MS tick and follows the feed from there.
+
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "../protocol.h"
+#include "../rules.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+const int SERVER_MAX_CONNECTIONS = 65536;   // Sockets numbered at or above this are refused
+const int SERVER_OUTPUT_BUFFER = 1024;      // Queued bytes per connection before it counts as too slow
+const int SERVER_EVENTS_PER_POLL = 512;     // Most socket events handled per epoll_wait
+const int SPECTATOR_CHUNK_SIZE = 1024;      // Bytes per shared feed chunk
+const int SPECTATOR_MAX_LAG = 256;          // Unsent feed bytes (about 60 moves) before a watcher is switched to snapshots
+const int SPECTATOR_SEND_BUFFER = 8192;     // Kernel send buffer of a watching socket, so a reader that stopped is noticed after a few KB
+const int SPECTATOR_FAN_OUT_MS = 50;        // Time between writes of the feeds to their watchers
+const int SPECTATOR_SNAPSHOT_MS = 250;      // Time between snapshots to watchers that fell behind
+const int SPECTATOR_WRITE_PARTS = 8;        // Most buffers in one vectored write: the replies and feed chunks
+
+enum ServerGameState { SERVER_GAME_FREE, SERVER_GAME_WAITING, SERVER_GAME_PLAYING };
+
+// One game in the store.
+struct ServerGame {
+    Bitboards pos;          // Current position
+    int32_t players[2];     // Socket of each side, -1 for an empty seat
+    uint32_t number;        // Serial number of the game since the server started, as sent in START
+    uint16_t plies;         // Turns played
+    uint8_t state;          // ServerGameState
+    uint8_t padding;
+};
+
+struct GameStore {
+    std::vector<ServerGame> games;
+    std::vector<uint32_t> freeSlots;    // Slots of finished games, reused before the array grows
+    int32_t waitingGame;                // Slot of the game with a free seat, or -1
+    uint32_t gamesStarted;
+};
+
+// Part of a game's feed. A chunk is referenced by the watchers reading it, by its game while moves are
+// still appended to it, and by the chunk before it, so a watcher can always follow `next`.
+struct BroadcastChunk {
+    uint64_t start;         // Offset of data[0] in the game's feed
+    int32_t next;           // The chunk written after this one, or -1
+    uint32_t refs;
+    uint16_t length;
+    uint8_t data[SPECTATOR_CHUNK_SIZE];
+};
+
+// The spectators of one game, kept next to the store (by game slot) so ServerGame stays small.
+struct GameFeed {
+    uint64_t length;        // Bytes appended since the first watcher came
+    int32_t chunk;          // Chunk moves are appended to, or -1 while nobody watches
+    int32_t firstWatcher;   // Socket at the head of the watcher list, or -1
+    uint32_t watchers;
+    bool pending;           // Grew since the last fan-out, and is in GameServer::pendingFeeds
+};
+
+struct ServerConnection {
+    bool open;
+    uint32_t openedInPoll;  // GameServer::polls when accepted; the socket number may have belonged to a connection closed in the same poll
+    bool flushQueued;       // Already in GameServer::pendingFlush
+    bool watchingOutput;    // Registered for EPOLLOUT because output is waiting
+    uint8_t side;           // Seat in the game, valid while game >= 0
+    int32_t game;           // Slot of the game this connection plays in, or -1
+    int32_t watching;       // Slot of the game this connection watches, or -1
+    int32_t previousWatcher;    // Neighbours in the watched game's list of watchers, -1 at the ends
+    int32_t nextWatcher;
+    bool lagging;           // Fell behind: gets snapshots instead of the feed
+    uint8_t feedCut;        // Bytes left of a feed message the last write cut short; they go out before the output
+    int32_t feedChunk;      // Chunk holding the next feed byte to send, or -1
+    uint16_t feedOffset;
+    uint16_t inputLength;
+    uint16_t outputLength;
+    uint8_t input[PROTOCOL_MAX_MESSAGE];    // Start of a message that has not fully arrived yet
+    uint8_t output[SERVER_OUTPUT_BUFFER];   // Replies not yet written to the socket
+};
+
+struct ServerStats {
+    uint64_t connectionsAccepted;
+    uint64_t connectionsOpen;
+    uint64_t slowDisconnects;   // Dropped because their output buffer filled up
+    uint64_t gamesStarted;
+    uint64_t gamesFinished;
+    uint64_t movesPlayed;
+    uint64_t movesRejected;
+    uint64_t resyncs;           // Positions sent in answer to SYNC
+    uint64_t watchers;          // Connections watching a game now
+    uint64_t feedMessages;      // Messages written into feeds, once each however many watch
+    uint64_t snapshots;         // SNAPSHOT messages sent
+    uint64_t watchersBehind;    // Times a watcher fell behind and was switched to snapshots
+    uint64_t bytesIn;
+    uint64_t bytesOut;
+};
+
+struct GameServer {
+    int listenSocket;
+    int epollHandle;
+    int port;                               // Port actually bound (useful when started with port 0)
+    uint32_t polls;                         // Calls to PollServer so far
+    GameStore store;
+    std::vector<ServerConnection> connections;  // Indexed by socket
+    std::vector<int> pendingFlush;          // Sockets with queued output
+    std::vector<GameFeed> feeds;            // Indexed by game slot
+    std::vector<BroadcastChunk> chunks;     // Feed chunks, reused through a free list
+    std::vector<uint32_t> freeChunks;
+    std::vector<int32_t> pendingFeeds;      // Slots of the feeds to fan out next
+    std::vector<int> laggingWatchers;       // Sockets waiting for their next snapshot
+    uint64_t nextFanOutAt;                  // Milliseconds on the steady clock
+    uint64_t nextSnapshotAt;
+    ServerStats stats;
+};
+
+bool StartServer(GameServer &server, const std::string &address, int port, std::string &error); // Listens on one IPv4 address (0.0.0.0 for every interface); port 0 picks a free one.
+void PollServer(GameServer &server, int timeoutMs); // Waits up to timeoutMs for socket events and handles them.
+void StopServer(GameServer &server); // Closes every connection and the listening socket.
+
+// The store on its own, without sockets.
+void InitGameStore(GameStore &store);
+int32_t AllocateGame(GameStore &store); // A new game in the initial position, in a reused slot if there is one.
+void FreeGame(GameStore &store, int32_t slot);
+
+#endif
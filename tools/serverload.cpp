@@ -0,0 +1,438 @@
+// @file serverload.cpp
+// @brief Load test for gameserver over TCP: keeps --games games running at once, both players of every game
+// played by this process with random legal moves, and reports moves per second and move round-trip latency.
+//
+// Every client checks each MOVE the server sends against its own copy of the position, so the run also
+// verifies that the server relays exactly the legal moves it was sent. A game longer than --max-plies is
+// resigned with QUIT, and so is every game still running when --seconds is up. The exit status is 1 if the server rejected a move or sent anything unexpected.
+//
+// --watchers adds spectators that WATCH the most watched game, check every move they are sent the same way,
+// and watch the next one when it ends. --slow-watchers adds spectators that only read SLOW_READ_BYTES every
+// SLOW_READ_MS and switch to the most watched game every SLOW_WATCH_MS whether or not they have read to the
+// end of the last one. A single game is too short to fill the socket buffers, but their unread data piles up
+// across games until the server has to switch them to snapshots; they check every move they get all the same.
+//
+// Usage: serverload [--host ADDRESS] [--port P] [--games N] [--seconds S] [--max-plies P] [--seed S]
+//                   [--watchers W] [--slow-watchers W]
+
+#include "../protocol.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <random>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+const int SLOW_READ_BYTES = 8;
+const uint64_t SLOW_READ_MS = 100;
+const uint64_t SLOW_WATCH_MS = 1000;
+
+struct LoadOptions {
+    const char *host;
+    int port;
+    int games;
+    double seconds;
+    int maxPlies;
+    unsigned seed;
+    int watchers;
+    int slowWatchers;
+};
+
+// One simulated player or spectator.
+struct LoadClient {
+    bool watcher;
+    bool inGame;                // For a watcher: following a game
+    int side;
+    Bitboards pos;              // Position as this player has seen it
+    int plies;
+    uint64_t moveSentAt;        // When this player's move was sent, 0 if none is waiting for confirmation
+    int inputLength;
+    uint8_t input[PROTOCOL_MAX_MESSAGE];    // Start of a message cut off at the end of a read
+};
+
+struct LoadTotals {
+    uint64_t moves;             // Moves confirmed to the player who made them
+    uint64_t gamesFinished;
+    uint64_t resignations;
+    uint64_t errors;
+    uint64_t watchedMoves;      // Moves received by watchers
+    uint64_t snapshots;         // SNAPSHOT messages received by watchers
+    vector<uint32_t> latencies; // Microseconds from sending a move to its confirmation
+    vector<int> unseated;       // Watchers to send WATCH again, after a game ended or none was running yet
+};
+
+
+static bool ParseOptions(int argc, char **argv, LoadOptions &options) {
+    options.host = "127.0.0.1";
+    options.port = PROTOCOL_PORT;
+    options.games = 1000;
+    options.seconds = 10.0;
+    options.maxPlies = 200;
+    options.seed = 1;
+    options.watchers = 0;
+    options.slowWatchers = 0;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+        if (value == nullptr) { cerr << "Missing value for " << arg << "\n"; return false; }
+        else if (strcmp(arg, "--host") == 0) options.host = value;
+        else if (strcmp(arg, "--port") == 0) options.port = atoi(value);
+        else if (strcmp(arg, "--games") == 0) options.games = atoi(value);
+        else if (strcmp(arg, "--seconds") == 0) options.seconds = atof(value);
+        else if (strcmp(arg, "--max-plies") == 0) options.maxPlies = atoi(value);
+        else if (strcmp(arg, "--seed") == 0) options.seed = (unsigned)strtoul(value, nullptr, 10);
+        else if (strcmp(arg, "--watchers") == 0) options.watchers = atoi(value);
+        else if (strcmp(arg, "--slow-watchers") == 0) options.slowWatchers = atoi(value);
+        else { cerr << "Unknown option " << arg << "\n"; return false; }
+        i++;
+    }
+    return options.games > 0 && options.seconds > 0.0 && options.maxPlies > 0 && options.watchers >= 0 && options.slowWatchers >= 0;
+}
+
+
+static uint64_t NowNs() {
+    return (uint64_t)chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+static void SendBytes(int socket, const uint8_t *data, int length, LoadTotals &totals) {
+    if (send(socket, data, length, MSG_NOSIGNAL) != (ssize_t)length) {
+        totals.errors++;  // The messages are tiny, so a full socket buffer means the server stopped reading
+    }
+}
+
+
+// Sends one message, or two in one write when `second` is not PROTOCOL_UNKNOWN (both without payload).
+static void SendCommand(int socket, ProtocolCommand command, LoadTotals &totals, ProtocolCommand second = PROTOCOL_UNKNOWN) {
+    uint8_t buffer[2 * PROTOCOL_HEADER_SIZE];
+    int length = WriteProtocolMessage(buffer, sizeof(buffer), command, nullptr, 0);
+    if (second != PROTOCOL_UNKNOWN) length += WriteProtocolMessage(buffer + length, sizeof(buffer) - length, second, nullptr, 0);
+    SendBytes(socket, buffer, length, totals);
+}
+
+
+static void SendRandomMove(int socket, LoadClient &client, const MoveList &list, mt19937 &random, LoadTotals &totals) {
+    uint8_t turn[PROTOCOL_MAX_TURN];
+    uint8_t buffer[PROTOCOL_MAX_MESSAGE];
+    int turnLength = EncodeProtocolTurn(list.moves[random() % list.count], turn);
+    int length = WriteProtocolMessage(buffer, sizeof(buffer), PROTOCOL_MOVE, turn, turnLength);
+    client.moveSentAt = NowNs();
+    SendBytes(socket, buffer, length, totals);
+}
+
+
+// Asks for the most watched game.
+static void SendWatch(int socket, LoadTotals &totals) {
+    uint8_t game[4];
+    uint8_t buffer[PROTOCOL_MAX_MESSAGE];
+    PutProtocolU32(game, 0);
+    SendBytes(socket, buffer, WriteProtocolMessage(buffer, sizeof(buffer), PROTOCOL_WATCH, game, sizeof(game)), totals);
+}
+
+
+// A spectator follows the game from each SNAPSHOT and checks every MOVE against it.
+static void HandleWatcherMessage(int socket, LoadClient &client, const ProtocolMessage &message, bool running, LoadTotals &totals) {
+    switch (message.command) {
+    case PROTOCOL_SNAPSHOT:
+        if (!DecodeProtocolPosition(message.payload + 6, client.pos)) {
+            totals.errors++;
+            break;
+        }
+        client.inGame = true;
+        client.plies = GetProtocolU16(message.payload + 4);
+        totals.snapshots++;
+        break;
+    case PROTOCOL_MOVE: {
+        Move move;
+        if (!client.inGame || !DecodeProtocolTurn(client.pos, message.payload, message.payloadLength, move)) {
+            cerr << "Unexpected MOVE to a watcher\n";
+            totals.errors++;
+            break;
+        }
+        MakeMove(client.pos, move);
+        client.plies++;
+        totals.watchedMoves++;
+        break;
+    }
+    case PROTOCOL_END:
+        client.inGame = false;
+        if (running) totals.unseated.push_back(socket);
+        break;
+    case PROTOCOL_ERROR:
+        if (message.payload[0] == PROTOCOL_ERROR_NO_SUCH_GAME) {
+            if (running) totals.unseated.push_back(socket);  // No game has started yet
+            break;
+        }
+        cerr << "Server error to a watcher: " << ProtocolErrorName(message.payload[0]) << "\n";
+        totals.errors++;
+        break;
+    default:
+        totals.errors++;
+        break;
+    }
+}
+
+
+static void HandleMessage(int socket, LoadClient &client, const uint8_t *data, int length, bool running,
+                          const LoadOptions &options, mt19937 &random, LoadTotals &totals) {
+    ProtocolMessage message;
+    if (!ParseProtocolMessage(data, length, message)) {
+        cerr << "Malformed " << ProtocolCommandName((ProtocolCommand)data[0]) << " from the server\n";
+        totals.errors++;
+        return;
+    }
+    if (client.watcher) {
+        HandleWatcherMessage(socket, client, message, running, totals);
+        return;
+    }
+
+    switch (message.command) {
+    case PROTOCOL_WAIT:
+        break;
+    case PROTOCOL_START: {
+        client.side = message.payload[4];
+        if (!DecodeProtocolPosition(message.payload + 5, client.pos)) {
+            totals.errors++;
+            break;
+        }
+        client.inGame = true;
+        client.plies = 0;
+        if ((int)client.pos.sideToMove == client.side) {
+            MoveList list;
+            GenerateMoves(client.pos, list);
+            SendRandomMove(socket, client, list, random, totals);
+        }
+        break;
+    }
+    case PROTOCOL_MOVE: {
+        Move move;
+        if (!client.inGame || !DecodeProtocolTurn(client.pos, message.payload, message.payloadLength, move)) {
+            cerr << "Unexpected MOVE from the server\n";
+            totals.errors++;
+            break;
+        }
+        MakeMove(client.pos, move);
+        client.plies++;
+        if (client.moveSentAt != 0 && running) {
+            totals.moves++;
+            totals.latencies.push_back((uint32_t)((NowNs() - client.moveSentAt) / 1000));
+            client.moveSentAt = 0;
+        }
+        if ((int)client.pos.sideToMove == client.side) {
+            MoveList list;
+            GenerateMoves(client.pos, list);
+            if (list.count == 0) {
+                break;  // Lost; END follows
+            } else if (!running) {
+                SendCommand(socket, PROTOCOL_QUIT, totals);  // Time is up: resign instead of moving
+                client.inGame = false;
+            } else if (client.plies >= options.maxPlies) {
+                SendCommand(socket, PROTOCOL_QUIT, totals, PROTOCOL_PLAY);  // The resigning side gets no END
+                client.inGame = false;
+                totals.resignations++;
+            } else {
+                SendRandomMove(socket, client, list, random, totals);
+            }
+        }
+        break;
+    }
+    case PROTOCOL_END:
+        if (client.side == 0 && client.plies < options.maxPlies) totals.gamesFinished++;  // Both players get END; resignations are counted apart
+        client.inGame = false;
+        if (running) SendCommand(socket, PROTOCOL_PLAY, totals);
+        break;
+    case PROTOCOL_ERROR:
+        cerr << "Server error: " << ProtocolErrorName(message.payload[0]) << "\n";
+        totals.errors++;
+        break;
+    default:
+        totals.errors++;
+        break;
+    }
+}
+
+
+// Reads up to maxBytes that have arrived and handles every complete message. False if the connection broke.
+static bool ReceiveMessages(int fd, LoadClient &client, int maxBytes, bool running, const LoadOptions &options,
+                            mt19937 &random, LoadTotals &totals) {
+    uint8_t buffer[4096];
+    ssize_t received = recv(fd, buffer, min(maxBytes, (int)sizeof(buffer)), MSG_DONTWAIT);
+    if (received <= 0) {
+        if (received == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+            cerr << "Error: The server closed a connection\n";
+            return false;
+        }
+        return true;
+    }
+
+    // Like the server: messages are handled where they arrived, a partial one is completed in client.input
+    int offset = 0;
+    while (offset < received) {
+        const uint8_t *data = buffer + offset;
+        int available = (int)received - offset;
+        if (client.inputLength > 0) {
+            client.input[client.inputLength++] = buffer[offset++];
+            data = client.input;
+            available = client.inputLength;
+        }
+        int length = FindProtocolMessage(data, available);
+        if (length < 0) {
+            cerr << "Error: The server sent something that is not a message\n";
+            return false;
+        }
+        if (length == 0) {
+            if (client.inputLength == 0) {
+                memcpy(client.input, data, available);
+                client.inputLength = available;
+                offset += available;
+            }
+            continue;
+        }
+        HandleMessage(fd, client, data, length, running, options, random, totals);
+        if (client.inputLength > 0) {
+            client.inputLength = 0;
+        } else {
+            offset += length;
+        }
+    }
+    return true;
+}
+
+
+int main(int argc, char **argv) {
+    LoadOptions options;
+    if (!ParseOptions(argc, argv, options)) {
+        cerr << "Usage: serverload [--host ADDRESS] [--port P] [--games N] [--seconds S] [--max-plies P] [--seed S]\n"
+                "                  [--watchers W] [--slow-watchers W]\n";
+        return 2;
+    }
+
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons((uint16_t)options.port);
+    if (inet_pton(AF_INET, options.host, &address.sin_addr) != 1) {
+        cerr << "Error: Bad address " << options.host << "\n";
+        return 2;
+    }
+
+    // Two players per game; consecutive PLAYs are paired, so every game is between two of our clients.
+    // Watchers come after them; slow watchers are read on a timer instead of when data arrives.
+    int epollHandle = epoll_create1(0);
+    vector<LoadClient> clients;
+    vector<int> sockets;
+    vector<int> watchers;
+    vector<int> slowWatchers;
+    LoadTotals totals = {};
+    int playerCount = 2 * options.games;
+    for (int i = 0; i < playerCount + options.watchers + options.slowWatchers; i++) {
+        bool slow = i >= playerCount + options.watchers;
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (slow) {
+            int receiveBuffer = 4096;  // Set before connecting, so the server sees a small window
+            setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &receiveBuffer, sizeof(receiveBuffer));
+        }
+        if (fd < 0 || connect(fd, (sockaddr *)&address, sizeof(address)) != 0) {
+            cerr << "Error: Connection " << i + 1 << " failed: " << strerror(errno) << "\n";
+            return 1;
+        }
+        int noDelay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+        if ((int)clients.size() <= fd) clients.resize(fd + 1);
+        LoadClient &client = clients[fd];
+        client.watcher = i >= playerCount;
+        client.inGame = false;
+        client.side = 0;
+        client.plies = 0;
+        client.moveSentAt = 0;
+        client.inputLength = 0;
+
+        if (client.watcher) {
+            watchers.push_back(fd);
+            if (slow) {
+                slowWatchers.push_back(fd);
+                continue;
+            }
+        } else {
+            sockets.push_back(fd);
+        }
+        epoll_event event;
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        epoll_ctl(epollHandle, EPOLL_CTL_ADD, fd, &event);
+    }
+    for (int fd : sockets) SendCommand(fd, PROTOCOL_PLAY, totals);
+    for (int fd : watchers) SendWatch(fd, totals);
+    cout << "Connected " << sockets.size() << " players and " << watchers.size() << " watchers\n" << flush;
+
+    mt19937 random(options.seed);
+    uint64_t start = NowNs();
+    uint64_t deadline = start + (uint64_t)(options.seconds * 1e9);
+    epoll_event events[512];
+
+    // After the deadline the player to move resigns every game, and the loop ends once all have finished
+    uint64_t stopped = 0;
+    uint64_t nextSlowRead = start + SLOW_READ_MS * 1000000;
+    uint64_t nextSlowWatch = start + SLOW_WATCH_MS * 1000000;
+    while (true) {
+        bool running = NowNs() < deadline;
+        if (!running) {
+            if (stopped == 0) stopped = NowNs();
+            bool anyInGame = false;
+            for (int fd : sockets) anyInGame = anyInGame || clients[fd].inGame;
+            if (!anyInGame || NowNs() > deadline + 5000000000ull) break;
+        }
+
+        // Watchers without a game ask again, at most once per poll so an empty server is not flooded
+        if (running && !totals.unseated.empty()) {
+            for (int fd : totals.unseated) SendWatch(fd, totals);
+            totals.unseated.clear();
+        }
+        if (NowNs() >= nextSlowRead) {
+            for (int fd : slowWatchers) {
+                if (!ReceiveMessages(fd, clients[fd], SLOW_READ_BYTES, running, options, random, totals)) return 1;
+            }
+            nextSlowRead += SLOW_READ_MS * 1000000;
+        }
+        if (running && NowNs() >= nextSlowWatch) {
+            for (int fd : slowWatchers) SendWatch(fd, totals);
+            nextSlowWatch += SLOW_WATCH_MS * 1000000;
+        }
+
+        int count = epoll_wait(epollHandle, events, 512, (int)SLOW_READ_MS);
+        for (int i = 0; i < count; i++) {
+            int fd = events[i].data.fd;
+            if (!ReceiveMessages(fd, clients[fd], 4096, running, options, random, totals)) return 1;
+        }
+    }
+    double seconds = (stopped - start) / 1e9;
+
+    for (int fd : sockets) close(fd);
+    for (int fd : watchers) close(fd);
+    close(epollHandle);
+
+    sort(totals.latencies.begin(), totals.latencies.end());
+    size_t samples = totals.latencies.size();
+    cout << options.games << " concurrent games for " << seconds << " s: " << totals.moves << " moves ("
+         << (long long)(totals.moves / seconds) << "/s), " << totals.gamesFinished << " games finished, "
+         << totals.resignations << " resigned at " << options.maxPlies << " plies, " << totals.errors << " errors\n";
+    if (!watchers.empty()) {
+        cout << watchers.size() << " watchers saw " << totals.watchedMoves << " moves and " << totals.snapshots << " snapshots\n";
+    }
+    if (samples > 0) {
+        cout << "Move round trip: median " << totals.latencies[samples / 2] << " us, 99% " << totals.latencies[samples * 99 / 100]
+             << " us, max " << totals.latencies[samples - 1] << " us\n";
+    }
+    return (totals.errors > 0 || totals.moves == 0) ? 1 : 0;
+}
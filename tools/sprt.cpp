@@ -0,0 +1,139 @@
+// @file sprt.cpp
+// @brief Elo estimation and Sequential Probability Ratio Test for self-play matches.
+
+#include "sprt.h"
+#include <cmath>
+
+const double CONFIDENCE_95 = 1.959963984540054; // Two-sided 95% quantile of the normal distribution
+const double SCORE_EPSILON = 1e-6;              // Keeps scores away from 0 and 1 where Elo is infinite
+const double SPRT_PRIOR_COUNT = 0.5;            // Added to every pentanomial bin so one-sided early results neither stall nor decide instantly
+
+double EloToScore(double elo) {
+    return 1.0 / (1.0 + pow(10.0, -elo / 400.0));
+}
+
+
+double ScoreToElo(double score) {
+    if (score < SCORE_EPSILON) score = SCORE_EPSILON;
+    if (score > 1.0 - SCORE_EPSILON) score = 1.0 - SCORE_EPSILON;
+    return -400.0 * log10(1.0 / score - 1.0);
+}
+
+
+void ResetMatchStats(MatchStats &stats) {
+    stats.wins = 0;
+    stats.draws = 0;
+    stats.losses = 0;
+    for (int i = 0; i < 5; i++) {
+        stats.pentanomial[i] = 0;
+    }
+}
+
+
+void AddGamePair(MatchStats &stats, int firstGame, int secondGame) {
+    int games[2] = { firstGame, secondGame };
+    for (int i = 0; i < 2; i++) {
+        if (games[i] == 2) stats.wins++;
+        else if (games[i] == 1) stats.draws++;
+        else stats.losses++;
+    }
+    stats.pentanomial[firstGame + secondGame]++;
+}
+
+
+// Mean and variance of a discrete score distribution given as outcome scores and their counts.
+static void Moments(const double scores[], const double counts[], int outcomes, double &total, double &mean, double &variance) {
+    total = 0.0;
+    double sum = 0.0;
+    for (int i = 0; i < outcomes; i++) {
+        total += counts[i];
+        sum += scores[i] * counts[i];
+    }
+
+    mean = (total > 0) ? sum / total : 0.5;
+    variance = 0.0;
+    for (int i = 0; i < outcomes && total > 0; i++) {
+        variance += counts[i] * (scores[i] - mean) * (scores[i] - mean);
+    }
+    if (total > 0) {
+        variance /= total;
+    }
+}
+
+
+static EloEstimate EstimateFromMoments(double total, double mean, double variance) {
+    EloEstimate estimate;
+    estimate.score = mean;
+    estimate.elo = ScoreToElo(mean);
+
+    double deviation = (total > 0) ? sqrt(variance / total) : 0.0;
+    estimate.margin = (ScoreToElo(mean + CONFIDENCE_95 * deviation) - ScoreToElo(mean - CONFIDENCE_95 * deviation)) / 2.0;
+    if (deviation > 0.0) {
+        estimate.los = 0.5 * erfc(-(mean - 0.5) / (deviation * sqrt(2.0)));
+    } else {
+        estimate.los = (mean > 0.5) ? 1.0 : (mean < 0.5) ? 0.0 : 0.5;
+    }
+    return estimate;
+}
+
+
+EloEstimate EstimateEloTrinomial(const MatchStats &stats) {
+    const double scores[3] = { 0.0, 0.5, 1.0 };
+    const double counts[3] = { (double)stats.losses, (double)stats.draws, (double)stats.wins };
+    double total;
+    double mean, variance;
+    Moments(scores, counts, 3, total, mean, variance);
+    return EstimateFromMoments(total, mean, variance);
+}
+
+
+// Pair scores are halved so the mean stays a per-game score.
+static void PentanomialMoments(const MatchStats &stats, double pseudoCount, double &pairs, double &mean, double &variance) {
+    const double scores[5] = { 0.0, 0.25, 0.5, 0.75, 1.0 };
+    double counts[5];
+    for (int i = 0; i < 5; i++) {
+        counts[i] = stats.pentanomial[i] + pseudoCount;
+    }
+    Moments(scores, counts, 5, pairs, mean, variance);
+}
+
+
+EloEstimate EstimateEloPentanomial(const MatchStats &stats) {
+    double pairs, mean, variance;
+    PentanomialMoments(stats, 0.0, pairs, mean, variance);
+    return EstimateFromMoments(pairs, mean, variance);
+}
+
+
+double SprtLogLikelihoodRatio(const MatchStats &stats, const SprtConfig &config) {
+    if (stats.pentanomial[0] + stats.pentanomial[1] + stats.pentanomial[2] + stats.pentanomial[3] + stats.pentanomial[4] == 0) {
+        return 0.0;  // No pairs played yet
+    }
+
+    double pairs, mean, variance;
+    PentanomialMoments(stats, SPRT_PRIOR_COUNT, pairs, mean, variance);
+    if (variance <= 0.0) {
+        return 0.0;  // Not enough information yet
+    }
+
+    double score0 = EloToScore(config.elo0);
+    double score1 = EloToScore(config.elo1);
+    return pairs * (score1 - score0) * (2.0 * mean - score0 - score1) / (2.0 * variance);
+}
+
+
+void SprtBounds(const SprtConfig &config, double &lower, double &upper) {
+    lower = log(config.beta / (1.0 - config.alpha));
+    upper = log((1.0 - config.beta) / config.alpha);
+}
+
+
+SprtResult SprtDecide(const MatchStats &stats, const SprtConfig &config, double &llr) {
+    double lower, upper;
+    SprtBounds(config, lower, upper);
+    llr = SprtLogLikelihoodRatio(stats, config);
+
+    if (llr >= upper) return SPRT_ACCEPT_H1;
+    if (llr <= lower) return SPRT_ACCEPT_H0;
+    return SPRT_CONTINUE;
+}
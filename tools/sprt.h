@@ -0,0 +1,46 @@
+// @file sprt.h
+// @brief Elo estimation and Sequential Probability Ratio Test for self-play matches.
+
+#ifndef SPRT_H
+#define SPRT_H
+
+// Hypotheses and error rates of one SPRT run. H0: Elo <= elo0, H1: Elo >= elo1 (logistic Elo).
+struct SprtConfig {
+    double elo0;    // Elo difference under H0
+    double elo1;    // Elo difference under H1
+    double alpha;   // Probability of accepting H1 when H0 holds
+    double beta;    // Probability of accepting H0 when H1 holds
+};
+
+enum SprtResult { SPRT_CONTINUE, SPRT_ACCEPT_H0, SPRT_ACCEPT_H1 };
+
+// Results seen so far, from the point of view of the engine being tested.
+struct MatchStats {
+    long long wins;
+    long long draws;
+    long long losses;
+    long long pentanomial[5]; // Game pairs (same opening, colours swapped) scoring 0, 0.5, 1, 1.5 and 2 points
+};
+
+// Elo difference with a 95% confidence margin and the likelihood of superiority.
+struct EloEstimate {
+    double score;   // Mean score per game, 0..1
+    double elo;
+    double margin;  // Half-width of the 95% confidence interval, in Elo
+    double los;     // Probability that the tested engine is the stronger one
+};
+
+double EloToScore(double elo); // Expected score for a logistic Elo difference.
+double ScoreToElo(double score); // Logistic Elo difference for an expected score.
+
+void ResetMatchStats(MatchStats &stats);
+void AddGamePair(MatchStats &stats, int firstGame, int secondGame); // Game results in half points: 0 loss, 1 draw, 2 win.
+
+EloEstimate EstimateEloTrinomial(const MatchStats &stats); // Treats every game as independent.
+EloEstimate EstimateEloPentanomial(const MatchStats &stats); // Uses game pairs, which removes the opening's bias from the variance.
+
+double SprtLogLikelihoodRatio(const MatchStats &stats, const SprtConfig &config); // Pentanomial GSPRT approximation.
+void SprtBounds(const SprtConfig &config, double &lower, double &upper);
+SprtResult SprtDecide(const MatchStats &stats, const SprtConfig &config, double &llr);
+
+#endif
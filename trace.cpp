@@ -0,0 +1,116 @@
+// @file trace.cpp
+// @brief Per-thread event ring buffers and the Chrome trace writer. Empty unless CHECKERS_TRACE is defined.
+
+#include "trace.h"
+
+#ifdef CHECKERS_TRACE
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+using namespace std;
+
+struct TraceRecord {
+    const char *name;
+    uint64_t startTime;
+    uint64_t endTime;
+};
+
+// Written by its own thread only; `written` counts every event ever recorded, so the newest is at written - 1.
+struct TraceBuffer {
+    TraceRecord records[TRACE_BUFFER_EVENTS];
+    atomic<uint64_t> written;
+    atomic<const char *> threadName;
+};
+
+static TraceBuffer buffers[MAX_TRACE_THREADS];
+static atomic<int> buffersClaimed(0);
+static thread_local TraceBuffer *threadBuffer = nullptr;
+static thread_local bool threadDropsEvents = false;  // Set when every buffer was already taken
+
+
+uint64_t TraceNow() {
+    return (uint64_t)chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+// The calling thread's buffer, claimed the first time the thread records anything.
+static TraceBuffer *ThreadBuffer() {
+    if (threadBuffer == nullptr && !threadDropsEvents) {
+        int index = buffersClaimed.fetch_add(1, memory_order_relaxed);
+        if (index < MAX_TRACE_THREADS) {
+            threadBuffer = &buffers[index];
+        } else {
+            threadDropsEvents = true;
+        }
+    }
+    return threadBuffer;
+}
+
+
+void TraceEvent(const char *name, uint64_t startTime, uint64_t endTime) {
+    TraceBuffer *buffer = ThreadBuffer();
+    if (buffer == nullptr) return;
+
+    uint64_t index = buffer->written.load(memory_order_relaxed);
+    TraceRecord &record = buffer->records[index % TRACE_BUFFER_EVENTS];
+    record.name = name;
+    record.startTime = startTime;
+    record.endTime = endTime;
+    buffer->written.store(index + 1, memory_order_release);
+}
+
+
+void TraceThreadName(const char *name) {
+    TraceBuffer *buffer = ThreadBuffer();
+    if (buffer != nullptr) {
+        buffer->threadName.store(name, memory_order_release);
+    }
+}
+
+
+bool WriteChromeTrace(const char *path) {
+    FILE *file = fopen(path, "w");
+    if (file == nullptr) return false;
+
+    fprintf(file, "{\"traceEvents\":[\n");
+    bool first = true;
+    vector<TraceRecord> copied;
+    int threads = min(buffersClaimed.load(memory_order_acquire), MAX_TRACE_THREADS);
+
+    for (int thread = 0; thread < threads; thread++) {
+        TraceBuffer &buffer = buffers[thread];
+        const char *threadName = buffer.threadName.load(memory_order_acquire);
+        if (threadName != nullptr) {
+            fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                    first ? "" : ",\n", thread + 1, threadName);
+            first = false;
+        }
+
+        // Copy first, then drop whatever the owning thread may have overwritten while we were copying
+        uint64_t end = buffer.written.load(memory_order_acquire);
+        uint64_t begin = (end > (uint64_t)TRACE_BUFFER_EVENTS) ? end - TRACE_BUFFER_EVENTS : 0;
+        copied.clear();
+        for (uint64_t index = begin; index < end; index++) {
+            copied.push_back(buffer.records[index % TRACE_BUFFER_EVENTS]);
+        }
+        uint64_t writtenAfter = buffer.written.load(memory_order_acquire);
+        uint64_t firstIntact = (writtenAfter + 1 > (uint64_t)TRACE_BUFFER_EVENTS) ? writtenAfter + 1 - TRACE_BUFFER_EVENTS : 0;
+
+        for (uint64_t index = max(begin, firstIntact); index < end; index++) {
+            const TraceRecord &record = copied[index - begin];
+            fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                    first ? "" : ",\n", record.name, thread + 1,
+                    record.startTime / 1000.0, (record.endTime - record.startTime) / 1000.0);
+            first = false;
+        }
+    }
+
+    fprintf(file, "\n]}\n");
+    return fclose(file) == 0;
+}
+
+#endif
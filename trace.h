@@ -0,0 +1,49 @@
+// @file trace.h
+// @brief Optional event tracing: timed scopes recorded into per-thread ring buffers and written out as Chrome
+// trace JSON (open the file in chrome://tracing or https://ui.perfetto.dev).
+//
+// Tracing is compiled in only when CHECKERS_TRACE is defined (make TRACE=TRUE). Without it TRACE_SCOPE and the
+// other macros expand to nothing, so the instrumented code is exactly what it was before.
+//
+// Every thread that records gets its own ring buffer of the last TRACE_BUFFER_EVENTS events. Only that thread
+// writes to it, and the writer publishes each event with one atomic store, so recording never locks. When a
+// buffer wraps, the oldest events are overwritten.
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cstdint>
+
+#ifdef CHECKERS_TRACE
+
+const int MAX_TRACE_THREADS = 16;       // Threads that can record; events from any more are dropped
+const int TRACE_BUFFER_EVENTS = 16384;  // Events kept per thread (about 4 minutes of frame phases at 60 FPS)
+
+uint64_t TraceNow(); // Nanoseconds on std::chrono::steady_clock, the same clock as ProfilerNow.
+void TraceEvent(const char *name, uint64_t startTime, uint64_t endTime); // `name` must be a string literal or otherwise outlive the trace.
+void TraceThreadName(const char *name); // Names the calling thread in the trace.
+bool WriteChromeTrace(const char *path); // Writes every buffered event; safe while other threads keep recording.
+
+// Records the time from its construction to the end of the enclosing block.
+struct TraceScope {
+    const char *name;
+    uint64_t startTime;
+    explicit TraceScope(const char *scopeName) : name(scopeName), startTime(TraceNow()) {}
+    ~TraceScope() { TraceEvent(name, startTime, TraceNow()); }
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+#define TRACE_EVENT(name, startTime, endTime) TraceEvent((name), (startTime), (endTime))
+#define TRACE_THREAD_NAME(name) TraceThreadName(name)
+
+#else
+
+#define TRACE_SCOPE(name) ((void)0)
+#define TRACE_EVENT(name, startTime, endTime) ((void)0)
+#define TRACE_THREAD_NAME(name) ((void)0)
+
+#endif
+
+#endif